@@ -1068,7 +1068,7 @@ static unsigned int build_torrent_trackers_hash(tr_torrent* tor)
     return hash;
 }
 
-static gboolean is_torrent_active(tr_stat const* st)
+static gboolean is_torrent_active(tr_brief_stat const* st)
 {
     return st->peersSendingToUs > 0 || st->peersGettingFromUs > 0 || st->activity == TR_STATUS_CHECK;
 }
@@ -1078,15 +1078,19 @@ void gtr_core_add_torrent(TrCore* core, tr_torrent* tor, gboolean do_notify)
     if (tor != NULL)
     {
         GtkTreeIter unused;
-        tr_stat const* st = tr_torrentStat(tor);
+        int const id = tr_torrentId(tor);
+        tr_brief_stat brief;
+        tr_brief_stat const* st = &brief;
         char const* collated = get_collated_name(core, tor);
         unsigned int const trackers_hash = build_torrent_trackers_hash(tor);
         GtkListStore* store = GTK_LIST_STORE(core_raw_model(core));
 
+        tr_torrentsStat(gtr_core_session(core), &id, 1, &brief);
+
         gtk_list_store_insert_with_values(store, &unused, 0,
             MC_NAME_COLLATED, collated,
             MC_TORRENT, tor,
-            MC_TORRENT_ID, tr_torrentId(tor),
+            MC_TORRENT_ID, id,
             MC_SPEED_UP, st->pieceUploadSpeed_KBps,
             MC_SPEED_DOWN, st->pieceDownloadSpeed_KBps,
             MC_ACTIVE_PEERS_UP, st->peersGettingFromUs,
@@ -1458,7 +1462,7 @@ static int gtr_compare_double(double const a, double const b, int decimal_places
     return ret;
 }
 
-static void update_foreach(GtkTreeModel* model, GtkTreeIter* iter)
+static void update_foreach(GtkTreeModel* model, GtkTreeIter* iter, tr_brief_stat const* st)
 {
     int oldActivity;
     int newActivity;
@@ -1486,7 +1490,6 @@ static void update_foreach(GtkTreeModel* model, GtkTreeIter* iter)
     double newRecheckProgress;
     gboolean oldActive;
     gboolean newActive;
-    tr_stat const* st;
     tr_torrent* tor;
 
     /* get the old states */
@@ -1508,7 +1511,6 @@ static void update_foreach(GtkTreeModel* model, GtkTreeIter* iter)
         -1);
 
     /* get the new states */
-    st = tr_torrentStat(tor);
     newActive = is_torrent_active(st);
     newActivity = st->activity;
     newFinished = st->finished;
@@ -1554,17 +1556,39 @@ void gtr_core_update(TrCore* core)
 {
     GtkTreeIter iter;
     GtkTreeModel* model;
+    int n;
 
     /* update the model */
     model = core_raw_model(core);
+    n = gtk_tree_model_iter_n_children(model, NULL);
 
-    if (gtk_tree_model_iter_nth_child(model, &iter, NULL, 0))
+    if (n > 0)
     {
-        do
+        int* ids = g_new(int, n);
+        tr_brief_stat* stats = g_new(tr_brief_stat, n);
+
+        /* get all of the rows' stats in one pass */
+        gtk_tree_model_iter_nth_child(model, &iter, NULL, 0);
+
+        for (int i = 0; i < n; ++i, gtk_tree_model_iter_next(model, &iter))
         {
-            update_foreach(model, &iter);
+            gtk_tree_model_get(model, &iter, MC_TORRENT_ID, &ids[i], -1);
         }
-        while (gtk_tree_model_iter_next(model, &iter));
+
+        tr_torrentsStat(gtr_core_session(core), ids, n, stats);
+
+        gtk_tree_model_iter_nth_child(model, &iter, NULL, 0);
+
+        for (int i = 0; i < n; ++i, gtk_tree_model_iter_next(model, &iter))
+        {
+            if (stats[i].id != 0)
+            {
+                update_foreach(model, &iter, &stats[i]);
+            }
+        }
+
+        g_free(stats);
+        g_free(ids);
     }
 
     /* update hibernation */
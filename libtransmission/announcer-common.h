@@ -30,7 +30,10 @@ enum
      * This is only an upper bound: if the tracker complains about
      * length, announcer will incrementally lower the batch size.
      */
-    TR_MULTISCRAPE_MAX = 100
+    TR_MULTISCRAPE_MAX = 100,
+
+    /* a udp scrape that fills a single datagram */
+    TR_MULTISCRAPE_MAX_UDP = 74
 };
 
 typedef struct
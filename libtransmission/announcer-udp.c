@@ -26,6 +26,7 @@
 #include "tr-assert.h"
 #include "tr-udp.h"
 #include "utils.h"
+#include "variant.h"
 
 #define dbgmsg(name, ...) tr_logAddDeepNamed(name, __VA_ARGS__)
 
@@ -45,31 +46,34 @@ static void tau_sockaddr_setport(struct sockaddr* sa, tr_port port)
     }
 }
 
-static int tau_sendto(tr_session* session, struct evutil_addrinfo* ai, tr_port port, void const* buf, size_t buflen)
+static tr_socket_t tau_get_socket(tr_session const* session, int family)
 {
-    tr_socket_t sockfd;
-
-    if (ai->ai_addr->sa_family == AF_INET)
-    {
-        sockfd = session->udp_socket;
-    }
-    else if (ai->ai_addr->sa_family == AF_INET6)
+    if (family == AF_INET)
     {
-        sockfd = session->udp6_socket;
+        return session->udp_socket;
     }
-    else
+
+    if (family == AF_INET6)
     {
-        sockfd = TR_BAD_SOCKET;
+        return session->udp6_socket;
     }
 
+    return TR_BAD_SOCKET;
+}
+
+static int tau_sendto(tr_session* session, struct sockaddr* addr, socklen_t addrlen, tr_port port, void const* buf,
+    size_t buflen)
+{
+    tr_socket_t const sockfd = tau_get_socket(session, addr->sa_family);
+
     if (sockfd == TR_BAD_SOCKET)
     {
         errno = EAFNOSUPPORT;
         return -1;
     }
 
-    tau_sockaddr_setport(ai->ai_addr, port);
-    return sendto(sockfd, buf, buflen, 0, ai->ai_addr, ai->ai_addrlen);
+    tau_sockaddr_setport(addr, port);
+    return sendto(sockfd, buf, buflen, 0, addr, addrlen);
 }
 
 /****
@@ -98,7 +102,10 @@ typedef uint64_t tau_connection_t;
 
 enum
 {
-    TAU_CONNECTION_TTL_SECS = 60
+    TAU_CONNECTION_TTL_SECS = 60,
+
+    /* how long to trust a tracker's DNS lookup, including across restarts */
+    TAU_ADDR_TTL_SECS = 60 * 60
 };
 
 typedef uint32_t tau_transaction_t;
@@ -110,6 +117,21 @@ static tau_transaction_t tau_transaction_new(void)
     return tmp;
 }
 
+static int compare_transaction_ids(tau_transaction_t a, tau_transaction_t b)
+{
+    if (a < b)
+    {
+        return -1;
+    }
+
+    if (a > b)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
 /* used in the "action" field of a request */
 typedef enum
 {
@@ -170,12 +192,19 @@ struct tau_scrape_request
     void* user_data;
 };
 
-static struct tau_scrape_request* tau_scrape_request_new(tr_scrape_request const* in, tr_scrape_response_func callback,
-    void* user_data)
+static int compare_scrape_requests(void const* va, void const* vb)
+{
+    struct tau_scrape_request const* a = va;
+    struct tau_scrape_request const* b = vb;
+
+    return compare_transaction_ids(a->transaction_id, b->transaction_id);
+}
+
+static struct tau_scrape_request* tau_scrape_request_new(tr_scrape_request const* in, tau_transaction_t transaction_id,
+    tr_scrape_response_func callback, void* user_data)
 {
     struct evbuffer* buf;
     struct tau_scrape_request* req;
-    tau_transaction_t const transaction_id = tau_transaction_new();
 
     /* build the payload */
     buf = evbuffer_new();
@@ -326,12 +355,19 @@ static tau_announce_event get_tau_announce_event(tr_announce_event e)
     }
 }
 
-static struct tau_announce_request* tau_announce_request_new(tr_announce_request const* in, tr_announce_response_func callback,
-    void* user_data)
+static int compare_announce_requests(void const* va, void const* vb)
+{
+    struct tau_announce_request const* a = va;
+    struct tau_announce_request const* b = vb;
+
+    return compare_transaction_ids(a->transaction_id, b->transaction_id);
+}
+
+static struct tau_announce_request* tau_announce_request_new(tr_announce_request const* in, tau_transaction_t transaction_id,
+    tr_announce_response_func callback, void* user_data)
 {
     struct evbuffer* buf;
     struct tau_announce_request* req;
-    tau_transaction_t const transaction_id = tau_transaction_new();
 
     /* build the payload */
     buf = evbuffer_new();
@@ -442,8 +478,10 @@ struct tau_tracker
     char* host;
     int port;
 
+    /* the tracker's resolved address. addr_len is 0 if we don't have one */
     struct evdns_getaddrinfo_request* dns_request;
-    struct evutil_addrinfo* addr;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
     time_t addr_expiration_time;
 
     time_t connecting_at;
@@ -453,20 +491,50 @@ struct tau_tracker
 
     time_t close_at;
 
-    tr_ptrArray announces;
-    tr_ptrArray scrapes;
+    /* these are sorted by transaction_id so that responses
+       can be matched to their requests with a binary search */
+    tr_ptrArray announces; /* tau_announce_request */
+    tr_ptrArray scrapes; /* tau_scrape_request */
 };
 
-static void tau_tracker_upkeep(struct tau_tracker*);
+static inline bool tau_tracker_has_addr(struct tau_tracker const* tracker)
+{
+    return tracker->addr_len != 0;
+}
 
-static void tau_tracker_free(struct tau_tracker* t)
+static void tau_tracker_set_addr(struct tau_tracker* tracker, struct sockaddr const* addr, socklen_t addr_len,
+    time_t expiration_time)
 {
-    TR_ASSERT(t->dns_request == NULL);
+    TR_ASSERT(addr_len <= sizeof(tracker->addr));
 
-    if (t->addr != NULL)
+    memcpy(&tracker->addr, addr, addr_len);
+    tracker->addr_len = addr_len;
+    tracker->addr_expiration_time = expiration_time;
+}
+
+/* pick a transaction id that isn't already used by one of this tracker's requests */
+static tau_transaction_t tau_tracker_new_transaction_id(struct tau_tracker* tracker)
+{
+    for (;;)
     {
-        evutil_freeaddrinfo(t->addr);
+        tau_transaction_t const id = tau_transaction_new();
+        struct tau_announce_request const announce_key = { .transaction_id = id };
+        struct tau_scrape_request const scrape_key = { .transaction_id = id };
+
+        if (id != tracker->connection_transaction_id &&
+            tr_ptrArrayFindSorted(&tracker->announces, &announce_key, compare_announce_requests) == NULL &&
+            tr_ptrArrayFindSorted(&tracker->scrapes, &scrape_key, compare_scrape_requests) == NULL)
+        {
+            return id;
+        }
     }
+}
+
+static void tau_tracker_upkeep(struct tau_tracker*);
+
+static void tau_tracker_free(struct tau_tracker* t)
+{
+    TR_ASSERT(t->dns_request == NULL);
 
     tr_ptrArrayDestruct(&t->announces, (PtrArrayForeachFunc)tau_announce_request_free);
     tr_ptrArrayDestruct(&t->scrapes, (PtrArrayForeachFunc)tau_scrape_request_free);
@@ -517,9 +585,22 @@ static void tau_tracker_on_dns(int errcode, struct evutil_addrinfo* addr, void*
     }
     else
     {
+        struct evutil_addrinfo const* ai = addr;
+
+        /* prefer the first address that we have a socket for */
+        while (ai != NULL && tau_get_socket(tracker->session, ai->ai_addr->sa_family) == TR_BAD_SOCKET)
+        {
+            ai = ai->ai_next;
+        }
+
+        if (ai == NULL)
+        {
+            ai = addr;
+        }
+
         dbgmsg(tracker->key, "DNS lookup succeeded");
-        tracker->addr = addr;
-        tracker->addr_expiration_time = tr_time() + 60 * 60; /* one hour */
+        tau_tracker_set_addr(tracker, ai->ai_addr, ai->ai_addrlen, tr_time() + TAU_ADDR_TTL_SECS);
+        evutil_freeaddrinfo(addr);
         tau_tracker_upkeep(tracker);
     }
 }
@@ -530,7 +611,8 @@ static void tau_tracker_send_request(struct tau_tracker* tracker, void const* pa
     dbgmsg(tracker->key, "sending request w/connection id %" PRIu64 "\n", tracker->connection_id);
     evbuffer_add_hton_64(buf, tracker->connection_id);
     evbuffer_add_reference(buf, payload, payload_len, NULL, NULL);
-    tau_sendto(tracker->session, tracker->addr, tracker->port, evbuffer_pullup(buf, -1), evbuffer_get_length(buf));
+    tau_sendto(tracker->session, (struct sockaddr*)&tracker->addr, tracker->addr_len, tracker->port,
+        evbuffer_pullup(buf, -1), evbuffer_get_length(buf));
     evbuffer_free(buf);
 }
 
@@ -538,7 +620,7 @@ static void tau_tracker_send_reqs(struct tau_tracker* tracker)
 {
     TR_ASSERT(tracker->dns_request == NULL);
     TR_ASSERT(tracker->connecting_at == 0);
-    TR_ASSERT(tracker->addr != NULL);
+    TR_ASSERT(tau_tracker_has_addr(tracker));
 
     time_t const now = tr_time();
 
@@ -681,11 +763,10 @@ static void tau_tracker_upkeep_ex(struct tau_tracker* tracker, bool timeout_reqs
     bool const closing = tracker->close_at != 0;
 
     /* if the address info is too old, expire it */
-    if (tracker->addr != NULL && (closing || tracker->addr_expiration_time <= now))
+    if (tau_tracker_has_addr(tracker) && (closing || tracker->addr_expiration_time <= now))
     {
         dbgmsg(tracker->host, "Expiring old DNS result");
-        evutil_freeaddrinfo(tracker->addr);
-        tracker->addr = NULL;
+        tracker->addr_len = 0;
     }
 
     /* are there any requests pending? */
@@ -695,7 +776,7 @@ static void tau_tracker_upkeep_ex(struct tau_tracker* tracker, bool timeout_reqs
     }
 
     /* if we don't have an address yet, try & get one now. */
-    if (!closing && tracker->addr == NULL && tracker->dns_request == NULL)
+    if (!closing && !tau_tracker_has_addr(tracker) && tracker->dns_request == NULL)
     {
         struct evutil_addrinfo hints;
         memset(&hints, 0, sizeof(hints));
@@ -708,21 +789,22 @@ static void tau_tracker_upkeep_ex(struct tau_tracker* tracker, bool timeout_reqs
         return;
     }
 
-    dbgmsg(tracker->key, "addr %p -- connected %d (%zu %zu) -- connecting_at %zu", (void*)tracker->addr,
+    dbgmsg(tracker->key, "addr %d -- connected %d (%zu %zu) -- connecting_at %zu", (int)tau_tracker_has_addr(tracker),
         (int)(tracker->connection_expiration_time > now), (size_t)tracker->connection_expiration_time, (size_t)now,
         (size_t)tracker->connecting_at);
 
     /* also need a valid connection ID... */
-    if (tracker->addr != NULL && tracker->connection_expiration_time <= now && tracker->connecting_at == 0)
+    if (tau_tracker_has_addr(tracker) && tracker->connection_expiration_time <= now && tracker->connecting_at == 0)
     {
         struct evbuffer* buf = evbuffer_new();
         tracker->connecting_at = now;
-        tracker->connection_transaction_id = tau_transaction_new();
+        tracker->connection_transaction_id = tau_tracker_new_transaction_id(tracker);
         dbgmsg(tracker->key, "Trying to connect. Transaction ID is %u", tracker->connection_transaction_id);
         evbuffer_add_hton_64(buf, 0x41727101980LL);
         evbuffer_add_hton_32(buf, TAU_ACTION_CONNECT);
         evbuffer_add_hton_32(buf, tracker->connection_transaction_id);
-        tau_sendto(tracker->session, tracker->addr, tracker->port, evbuffer_pullup(buf, -1), evbuffer_get_length(buf));
+        tau_sendto(tracker->session, (struct sockaddr*)&tracker->addr, tracker->addr_len, tracker->port,
+            evbuffer_pullup(buf, -1), evbuffer_get_length(buf));
         evbuffer_free(buf);
         return;
     }
@@ -732,7 +814,7 @@ static void tau_tracker_upkeep_ex(struct tau_tracker* tracker, bool timeout_reqs
         tau_tracker_timeout_reqs(tracker);
     }
 
-    if (tracker->addr != NULL && tracker->connection_expiration_time > now)
+    if (tau_tracker_has_addr(tracker) && tracker->connection_expiration_time > now)
     {
         tau_tracker_send_reqs(tracker);
     }
@@ -754,9 +836,136 @@ struct tr_announcer_udp
     /* tau_tracker */
     tr_ptrArray trackers;
 
+    /* tracker addresses saved by the previous session */
+    tr_variant dns_cache;
+
     tr_session* session;
 };
 
+/***
+****  The trackers' resolved addresses are saved at shutdown and reused
+****  on the next startup until they expire, so that restarting doesn't
+****  kick off a fresh round of DNS lookups for every tracker.
+***/
+
+static char* tau_dns_cache_filename(tr_session const* session)
+{
+    return tr_buildPath(session->configDir, "udp-trackers.dat", NULL);
+}
+
+static void tau_dns_cache_load(struct tr_announcer_udp* tau)
+{
+    char* filename = tau_dns_cache_filename(tau->session);
+
+    if (!tr_variantFromFile(&tau->dns_cache, TR_VARIANT_FMT_BENC, filename, NULL) || !tr_variantIsList(&tau->dns_cache))
+    {
+        tr_variantInitList(&tau->dns_cache, 0);
+    }
+
+    tr_free(filename);
+}
+
+static void tau_dns_cache_save(struct tr_announcer_udp const* tau)
+{
+    tr_variant top;
+    time_t const now = tr_time();
+    int const n = tr_ptrArraySize(&tau->trackers);
+
+    tr_variantInitList(&top, n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        struct tau_tracker const* tracker = tr_ptrArrayNth((tr_ptrArray*)&tau->trackers, i);
+
+        if (tau_tracker_has_addr(tracker) && tracker->addr_expiration_time > now)
+        {
+            tr_variant* entry = tr_variantListAddDict(&top, 4);
+            tr_variantDictAddStr(entry, TR_KEY_host, tracker->host);
+            tr_variantDictAddInt(entry, TR_KEY_port, tracker->port);
+            tr_variantDictAddInt(entry, TR_KEY_date, tracker->addr_expiration_time);
+
+            /* the address is saved in network byte order under a key naming its family,
+             * rather than as a raw sockaddr whose layout varies between platforms */
+            if (tracker->addr.ss_family == AF_INET)
+            {
+                struct sockaddr_in const* sin = (struct sockaddr_in const*)&tracker->addr;
+                tr_variantDictAddRaw(entry, TR_KEY_ipv4, &sin->sin_addr, sizeof(sin->sin_addr));
+            }
+            else
+            {
+                struct sockaddr_in6 const* sin6 = (struct sockaddr_in6 const*)&tracker->addr;
+                tr_variantDictAddRaw(entry, TR_KEY_ipv6, &sin6->sin6_addr, sizeof(sin6->sin6_addr));
+            }
+        }
+    }
+
+    if (tr_variantListSize(&top) > 0)
+    {
+        char* filename = tau_dns_cache_filename(tau->session);
+        tr_variantToFile(&top, TR_VARIANT_FMT_BENC, filename);
+        tr_free(filename);
+    }
+
+    tr_variantFree(&top);
+}
+
+static void tau_dns_cache_lookup(struct tr_announcer_udp* tau, struct tau_tracker* tracker)
+{
+    time_t const now = tr_time();
+
+    for (size_t i = 0, n = tr_variantListSize(&tau->dns_cache); i < n; ++i)
+    {
+        size_t len;
+        int64_t port;
+        int64_t expiration_time;
+        char const* host;
+        uint8_t const* raw;
+        tr_variant* entry = tr_variantListChild(&tau->dns_cache, i);
+
+        if (!tr_variantDictFindStr(entry, TR_KEY_host, &host, NULL) || tr_strcmp0(host, tracker->host) != 0 ||
+            !tr_variantDictFindInt(entry, TR_KEY_port, &port) || port != tracker->port)
+        {
+            continue;
+        }
+
+        if (tr_variantDictFindInt(entry, TR_KEY_date, &expiration_time) && expiration_time > now)
+        {
+            struct sockaddr_storage ss;
+
+            memset(&ss, 0, sizeof(ss));
+
+            if (tr_variantDictFindRaw(entry, TR_KEY_ipv4, &raw, &len) && len == sizeof(struct in_addr))
+            {
+                struct sockaddr_in* sin = (struct sockaddr_in*)&ss;
+                sin->sin_family = AF_INET;
+                sin->sin_port = htons(tracker->port);
+                memcpy(&sin->sin_addr, raw, len);
+                len = sizeof(struct sockaddr_in);
+            }
+            else if (tr_variantDictFindRaw(entry, TR_KEY_ipv6, &raw, &len) && len == sizeof(struct in6_addr))
+            {
+                struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&ss;
+                sin6->sin6_family = AF_INET6;
+                sin6->sin6_port = htons(tracker->port);
+                memcpy(&sin6->sin6_addr, raw, len);
+                len = sizeof(struct sockaddr_in6);
+            }
+            else
+            {
+                len = 0;
+            }
+
+            if (len != 0)
+            {
+                dbgmsg(tracker->key, "Using cached DNS result");
+                tau_tracker_set_addr(tracker, (struct sockaddr const*)&ss, len, expiration_time);
+            }
+        }
+
+        break;
+    }
+}
+
 static struct tr_announcer_udp* announcer_udp_get(tr_session* session)
 {
     struct tr_announcer_udp* tau;
@@ -769,6 +978,7 @@ static struct tr_announcer_udp* announcer_udp_get(tr_session* session)
     tau = tr_new0(struct tr_announcer_udp, 1);
     tau->trackers = TR_PTR_ARRAY_INIT;
     tau->session = session;
+    tau_dns_cache_load(tau);
     session->announcer_udp = tau;
     return tau;
 }
@@ -806,6 +1016,7 @@ static struct tau_tracker* tau_session_get_tracker(struct tr_announcer_udp* tau,
         tracker->port = port;
         tracker->scrapes = TR_PTR_ARRAY_INIT;
         tracker->announces = TR_PTR_ARRAY_INIT;
+        tau_dns_cache_lookup(tau, tracker);
         tr_ptrArrayAppend(&tau->trackers, tracker);
         dbgmsg(tracker->key, "New tau_tracker created");
     }
@@ -861,6 +1072,7 @@ void tr_tracker_udp_close(tr_session* session)
     {
         session->announcer_udp = NULL;
         tr_ptrArrayDestruct(&tau->trackers, (PtrArrayForeachFunc)tau_tracker_free);
+        tr_variantFree(&tau->dns_cache);
         tr_free(tau);
     }
 }
@@ -875,6 +1087,9 @@ void tr_tracker_udp_start_shutdown(tr_session* session)
 
     if (tau != NULL)
     {
+        /* save the addresses before upkeep expires them */
+        tau_dns_cache_save(tau);
+
         for (int i = 0, n = tr_ptrArraySize(&tau->trackers); i < n; ++i)
         {
             struct tau_tracker* tracker = tr_ptrArrayNth(&tau->trackers, i);
@@ -944,14 +1159,17 @@ bool tau_handle_message(tr_session* session, uint8_t const* msg, size_t msglen)
         /* is it a response to one of this tracker's announces? */
         reqs = &tracker->announces;
 
-        for (int j = 0, jn = tr_ptrArraySize(reqs); j < jn; ++j)
+        if (!tr_ptrArrayEmpty(reqs))
         {
-            struct tau_announce_request* req = tr_ptrArrayNth(reqs, j);
+            bool found;
+            struct tau_announce_request const key = { .transaction_id = transaction_id };
+            int const pos = tr_ptrArrayLowerBound(reqs, &key, compare_announce_requests, &found);
+            struct tau_announce_request* req = found ? tr_ptrArrayNth(reqs, pos) : NULL;
 
-            if (req->sent_at != 0 && transaction_id == req->transaction_id)
+            if (req != NULL && req->sent_at != 0)
             {
                 dbgmsg(tracker->key, "%" PRIu32 " is an announce request!", transaction_id);
-                tr_ptrArrayRemove(reqs, j);
+                tr_ptrArrayRemove(reqs, pos);
                 on_announce_response(req, action_id, buf);
                 tau_announce_request_free(req);
                 evbuffer_free(buf);
@@ -962,14 +1180,17 @@ bool tau_handle_message(tr_session* session, uint8_t const* msg, size_t msglen)
         /* is it a response to one of this tracker's scrapes? */
         reqs = &tracker->scrapes;
 
-        for (int j = 0, jn = tr_ptrArraySize(reqs); j < jn; ++j)
+        if (!tr_ptrArrayEmpty(reqs))
         {
-            struct tau_scrape_request* req = tr_ptrArrayNth(reqs, j);
+            bool found;
+            struct tau_scrape_request const key = { .transaction_id = transaction_id };
+            int const pos = tr_ptrArrayLowerBound(reqs, &key, compare_scrape_requests, &found);
+            struct tau_scrape_request* req = found ? tr_ptrArrayNth(reqs, pos) : NULL;
 
-            if (req->sent_at != 0 && transaction_id == req->transaction_id)
+            if (req != NULL && req->sent_at != 0)
             {
                 dbgmsg(tracker->key, "%" PRIu32 " is a scrape request!", transaction_id);
-                tr_ptrArrayRemove(reqs, j);
+                tr_ptrArrayRemove(reqs, pos);
                 on_scrape_response(req, action_id, buf);
                 tau_scrape_request_free(req);
                 evbuffer_free(buf);
@@ -988,8 +1209,9 @@ void tr_tracker_udp_announce(tr_session* session, tr_announce_request const* req
 {
     struct tr_announcer_udp* tau = announcer_udp_get(session);
     struct tau_tracker* tracker = tau_session_get_tracker(tau, request->url);
-    struct tau_announce_request* r = tau_announce_request_new(request, response_func, user_data);
-    tr_ptrArrayAppend(&tracker->announces, r);
+    tau_transaction_t const transaction_id = tau_tracker_new_transaction_id(tracker);
+    struct tau_announce_request* r = tau_announce_request_new(request, transaction_id, response_func, user_data);
+    tr_ptrArrayInsertSorted(&tracker->announces, r, compare_announce_requests);
     tau_tracker_upkeep_ex(tracker, false);
 }
 
@@ -998,7 +1220,8 @@ void tr_tracker_udp_scrape(tr_session* session, tr_scrape_request const* request
 {
     struct tr_announcer_udp* tau = announcer_udp_get(session);
     struct tau_tracker* tracker = tau_session_get_tracker(tau, request->url);
-    struct tau_scrape_request* r = tau_scrape_request_new(request, response_func, user_data);
-    tr_ptrArrayAppend(&tracker->scrapes, r);
+    tau_transaction_t const transaction_id = tau_tracker_new_transaction_id(tracker);
+    struct tau_scrape_request* r = tau_scrape_request_new(request, transaction_id, response_func, user_data);
+    tr_ptrArrayInsertSorted(&tracker->scrapes, r, compare_scrape_requests);
     tau_tracker_upkeep_ex(tracker, false);
 }
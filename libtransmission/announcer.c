@@ -62,7 +62,9 @@ enum
     TAU_UPKEEP_INTERVAL_SECS = 5,
 
     /* how many infohashes to remove when we get a scrape-too-long error */
-    TR_MULTISCRAPE_STEP = 5
+    TR_MULTISCRAPE_STEP = 5,
+    /* periodic reannounces are delayed by up to interval/N to spread them out */
+    ANNOUNCE_JITTER_DIVISOR = 20
 };
 
 /***
@@ -163,6 +165,8 @@ static int compareScrapeInfo(void const* va, void const* vb)
     return tr_strcmp0(a->url, b->url);
 }
 
+struct tr_tier;
+
 /**
  * "global" (per-tr_session) fields
  */
@@ -171,6 +175,12 @@ typedef struct tr_announcer
     tr_ptrArray stops; /* tr_announce_request */
     tr_ptrArray scrape_info; /* struct tr_scrape_info */
 
+    /* a min-heap of the tiers that have an announce or scrape pending,
+       keyed by when they're due, so that upkeep only visits those */
+    struct tr_tier** upkeepHeap;
+    int upkeepHeapCount;
+    int upkeepHeapAlloc;
+
     tr_session* session;
     struct event* upkeepTimer;
     int slotsAvailable;
@@ -196,7 +206,7 @@ static struct tr_scrape_info* tr_announcerGetScrapeInfo(struct tr_announcer* ann
         {
             info = tr_new0(struct tr_scrape_info, 1);
             info->url = tr_strdup(url);
-            info->multiscrape_max = TR_MULTISCRAPE_MAX;
+            info->multiscrape_max = strncmp(url, "udp://", 6) == 0 ? TR_MULTISCRAPE_MAX_UDP : TR_MULTISCRAPE_MAX;
             tr_ptrArrayInsert(&announcer->scrape_info, info, pos);
         }
     }
@@ -241,6 +251,7 @@ void tr_announcerClose(tr_session* session)
 
     tr_ptrArrayDestruct(&announcer->stops, NULL);
     tr_ptrArrayDestruct(&announcer->scrape_info, scrapeInfoFree);
+    tr_free(announcer->upkeepHeap);
 
     session->announcer = NULL;
     tr_free(announcer);
@@ -351,6 +362,11 @@ typedef struct tr_tier
 
     int lastAnnouncePeerCount;
 
+    /* when this tier next needs upkeep, and its position in the
+       announcer's upkeepHeap (or -1 if nothing is pending) */
+    time_t upkeepAt;
+    int upkeepHeapIndex;
+
     bool isRunning;
     bool isAnnouncing;
     bool isScraping;
@@ -361,6 +377,170 @@ typedef struct tr_tier
 }
 tr_tier;
 
+/***
+****  UPKEEP HEAP
+***/
+
+static inline bool upkeepHeapIsBefore(tr_tier const* a, tr_tier const* b)
+{
+    return a->upkeepAt < b->upkeepAt;
+}
+
+static void upkeepHeapSet(tr_announcer* announcer, int pos, tr_tier* tier)
+{
+    announcer->upkeepHeap[pos] = tier;
+    tier->upkeepHeapIndex = pos;
+}
+
+static void upkeepHeapSiftUp(tr_announcer* announcer, int pos)
+{
+    tr_tier* const tier = announcer->upkeepHeap[pos];
+
+    while (pos > 0)
+    {
+        int const parent = (pos - 1) / 2;
+
+        if (!upkeepHeapIsBefore(tier, announcer->upkeepHeap[parent]))
+        {
+            break;
+        }
+
+        upkeepHeapSet(announcer, pos, announcer->upkeepHeap[parent]);
+        pos = parent;
+    }
+
+    upkeepHeapSet(announcer, pos, tier);
+}
+
+static void upkeepHeapSiftDown(tr_announcer* announcer, int pos)
+{
+    int const n = announcer->upkeepHeapCount;
+    tr_tier* const tier = announcer->upkeepHeap[pos];
+
+    for (;;)
+    {
+        int child = pos * 2 + 1;
+
+        if (child >= n)
+        {
+            break;
+        }
+
+        if (child + 1 < n && upkeepHeapIsBefore(announcer->upkeepHeap[child + 1], announcer->upkeepHeap[child]))
+        {
+            ++child;
+        }
+
+        if (!upkeepHeapIsBefore(announcer->upkeepHeap[child], tier))
+        {
+            break;
+        }
+
+        upkeepHeapSet(announcer, pos, announcer->upkeepHeap[child]);
+        pos = child;
+    }
+
+    upkeepHeapSet(announcer, pos, tier);
+}
+
+static void upkeepHeapRemove(tr_announcer* announcer, tr_tier* tier)
+{
+    int const pos = tier->upkeepHeapIndex;
+
+    TR_ASSERT(pos >= 0 && pos < announcer->upkeepHeapCount);
+    TR_ASSERT(announcer->upkeepHeap[pos] == tier);
+
+    tr_tier* const last = announcer->upkeepHeap[--announcer->upkeepHeapCount];
+    tier->upkeepHeapIndex = -1;
+
+    if (last != tier)
+    {
+        upkeepHeapSet(announcer, pos, last);
+        upkeepHeapSiftUp(announcer, pos);
+        upkeepHeapSiftDown(announcer, last->upkeepHeapIndex);
+    }
+}
+
+static void upkeepHeapInsert(tr_announcer* announcer, tr_tier* tier)
+{
+    TR_ASSERT(tier->upkeepHeapIndex == -1);
+
+    if (announcer->upkeepHeapCount == announcer->upkeepHeapAlloc)
+    {
+        announcer->upkeepHeapAlloc = MAX(64, announcer->upkeepHeapAlloc * 2);
+        announcer->upkeepHeap = tr_renew(struct tr_tier*, announcer->upkeepHeap, announcer->upkeepHeapAlloc);
+    }
+
+    upkeepHeapSet(announcer, announcer->upkeepHeapCount++, tier);
+    upkeepHeapSiftUp(announcer, tier->upkeepHeapIndex);
+}
+
+/* The earliest time at which tierNeedsToAnnounce() or tierNeedsToScrape()
+ * could become true without some other state change, or 0 if never.
+ * Tiers that are busy get rescheduled when their request finishes. */
+static time_t tierGetUpkeepTime(tr_tier const* tier)
+{
+    time_t ret = 0;
+
+    if (!tier->isAnnouncing && !tier->isScraping && tier->announceAt != 0 && tier->announce_event_count > 0)
+    {
+        ret = tier->announceAt;
+    }
+
+    if (!tier->isScraping && tier->scrapeAt != 0 && tier->currentTracker != NULL &&
+        tier->currentTracker->scrape_info != NULL && (ret == 0 || tier->scrapeAt < ret))
+    {
+        ret = tier->scrapeAt;
+    }
+
+    return ret;
+}
+
+/* call this whenever a tier's announce or scrape state changes */
+static void tierScheduleUpkeep(tr_tier* tier)
+{
+    tr_announcer* announcer = tier->tor->session->announcer;
+    time_t const upkeepAt = tierGetUpkeepTime(tier);
+
+    if (announcer == NULL)
+    {
+        return;
+    }
+
+    if (upkeepAt == 0)
+    {
+        if (tier->upkeepHeapIndex != -1)
+        {
+            upkeepHeapRemove(announcer, tier);
+        }
+    }
+    else if (tier->upkeepHeapIndex == -1)
+    {
+        tier->upkeepAt = upkeepAt;
+        upkeepHeapInsert(announcer, tier);
+    }
+    else if (tier->upkeepAt != upkeepAt)
+    {
+        tier->upkeepAt = upkeepAt;
+        upkeepHeapSiftUp(announcer, tier->upkeepHeapIndex);
+        upkeepHeapSiftDown(announcer, tier->upkeepHeapIndex);
+    }
+}
+
+/* remove and return the next tier that's due, or NULL if none are */
+static tr_tier* upkeepHeapPopDue(tr_announcer* announcer, time_t now)
+{
+    tr_tier* tier = NULL;
+
+    if (announcer->upkeepHeapCount > 0 && announcer->upkeepHeap[0]->upkeepAt <= now)
+    {
+        tier = announcer->upkeepHeap[0];
+        upkeepHeapRemove(announcer, tier);
+    }
+
+    return tier;
+}
+
 static time_t get_next_scrape_time(tr_session const* session, tr_tier const* tier, int interval)
 {
     time_t ret;
@@ -399,11 +579,19 @@ static void tierConstruct(tr_tier* tier, tr_torrent* tor)
     tier->announceIntervalSec = DEFAULT_ANNOUNCE_INTERVAL_SEC;
     tier->announceMinIntervalSec = DEFAULT_ANNOUNCE_MIN_INTERVAL_SEC;
     tier->scrapeAt = get_next_scrape_time(tor->session, tier, tr_rand_int_weak(180));
+    tier->upkeepHeapIndex = -1;
     tier->tor = tor;
 }
 
 static void tierDestruct(tr_tier* tier)
 {
+    tr_announcer* announcer = tier->tor->session->announcer;
+
+    if (announcer != NULL && tier->upkeepHeapIndex != -1)
+    {
+        upkeepHeapRemove(announcer, tier);
+    }
+
     tr_free(tier->announce_events);
 }
 
@@ -428,6 +616,8 @@ static void tierIncrementTracker(tr_tier* tier)
     tier->isScraping = false;
     tier->lastAnnounceStartTime = 0;
     tier->lastScrapeStartTime = 0;
+
+    tierScheduleUpkeep(tier);
 }
 
 /***
@@ -911,6 +1101,7 @@ static void tier_announce_event_push(tr_tier* tier, tr_announce_event e, time_t
     /* add it */
     tier->announce_events[tier->announce_event_count++] = e;
     tier->announceAt = announceAt;
+    tierScheduleUpkeep(tier);
 
     dbgmsg_tier_announce_queue(tier);
     dbgmsg(tier, "announcing in %d seconds", (int)difftime(announceAt, tr_time()));
@@ -1149,6 +1340,7 @@ static void on_announce_done(tr_announce_response const* response, void* vdata)
         tier->lastAnnounceSucceeded = false;
         tier->isAnnouncing = false;
         tier->manualAnnounceAllowedAt = now + tier->announceMinIntervalSec;
+        tr_torrentSetStatDirty(tier->tor, TR_STAT_DIRTY_STATE);
 
         if (!response->did_connect)
         {
@@ -1244,6 +1436,7 @@ static void on_announce_done(tr_announce_response const* response, void* vdata)
             }
 
             tier->isRunning = data->isRunningOnSuccess;
+            tr_torrentSetStatDirty(tier->tor, TR_STAT_DIRTY_STATE);
 
             /* if the tracker included scrape fields in its announce response,
                then a separate scrape isn't needed */
@@ -1275,12 +1468,16 @@ static void on_announce_done(tr_announce_response const* response, void* vdata)
 
             if (!isStopped && tier->announce_event_count == 0)
             {
-                /* the queue is empty, so enqueue a perodic update */
-                i = tier->announceIntervalSec;
+                /* the queue is empty, so enqueue a perodic update.
+                 * add a little jitter so that torrents which started together
+                 * don't keep reannouncing to the same tracker in lockstep */
+                i = tier->announceIntervalSec + tr_rand_int_weak(MAX(1, tier->announceIntervalSec / ANNOUNCE_JITTER_DIVISOR));
                 dbgmsg(tier, "Sending periodic reannounce in %d seconds", i);
                 tier_announce_event_push(tier, TR_ANNOUNCE_EVENT_NONE, now + i);
             }
         }
+
+        tierScheduleUpkeep(tier);
     }
 
     tr_free(data);
@@ -1344,6 +1541,7 @@ static void tierAnnounce(tr_announcer* announcer, tr_tier* tier)
 
     tier->isAnnouncing = true;
     tier->lastAnnounceStartTime = now;
+    tierScheduleUpkeep(tier);
     --announcer->slotsAvailable;
 
     announce_request_delegate(announcer, req, on_announce_done, data);
@@ -1406,6 +1604,7 @@ static void on_scrape_error(tr_session* session, tr_tier* tier, char const* errm
     tr_logAddTorInfo(tier->tor, "Retrying scrape in %zu seconds.", (size_t)interval);
     tier->lastScrapeSucceeded = false;
     tier->scrapeAt = get_next_scrape_time(session, tier, interval);
+    tierScheduleUpkeep(tier);
 }
 
 static tr_tier* find_tier(tr_torrent* tor, char const* scrape)
@@ -1511,6 +1710,8 @@ static void on_scrape_done(tr_scrape_response const* response, void* vsession)
                         tracker->consecutiveFailures = 0;
                     }
                 }
+
+                tierScheduleUpkeep(tier);
             }
         }
     }
@@ -1608,6 +1809,7 @@ static void multiscrape(tr_announcer* announcer, tr_ptrArray* tiers)
             memcpy(req->info_hash[req->info_hash_count++], hash, SHA_DIGEST_LENGTH);
             tier->isScraping = true;
             tier->lastScrapeStartTime = now;
+            tierScheduleUpkeep(tier);
             found = true;
         }
 
@@ -1621,6 +1823,7 @@ static void multiscrape(tr_announcer* announcer, tr_ptrArray* tiers)
             memcpy(req->info_hash[req->info_hash_count++], hash, SHA_DIGEST_LENGTH);
             tier->isScraping = true;
             tier->lastScrapeStartTime = now;
+            tierScheduleUpkeep(tier);
         }
     }
 
@@ -1678,7 +1881,7 @@ static int compareTiers(void const* va, void const* vb)
 static void announceMore(tr_announcer* announcer)
 {
     int n;
-    tr_torrent* tor;
+    tr_tier* tier;
     tr_ptrArray announceMe = TR_PTR_ARRAY_INIT;
     tr_ptrArray scrapeMe = TR_PTR_ARRAY_INIT;
     time_t const now = tr_time();
@@ -1690,25 +1893,17 @@ static void announceMore(tr_announcer* announcer)
         return;
     }
 
-    /* build a list of tiers that need to be announced */
-    tor = NULL;
-
-    while ((tor = tr_torrentNext(announcer->session, tor)) != NULL)
+    /* build a list of tiers that need to be announced.
+     * only the tiers that are due get visited here. */
+    while ((tier = upkeepHeapPopDue(announcer, now)) != NULL)
     {
-        struct tr_torrent_tiers* tt = tor->tiers;
-
-        for (int i = 0; tt != NULL && i < tt->tier_count; ++i)
+        if (tierNeedsToAnnounce(tier, now))
         {
-            tr_tier* tier = &tt->tiers[i];
-
-            if (tierNeedsToAnnounce(tier, now))
-            {
-                tr_ptrArrayAppend(&announceMe, tier);
-            }
-            else if (tierNeedsToScrape(tier, now))
-            {
-                tr_ptrArrayAppend(&scrapeMe, tier);
-            }
+            tr_ptrArrayAppend(&announceMe, tier);
+        }
+        else if (tierNeedsToScrape(tier, now))
+        {
+            tr_ptrArrayAppend(&scrapeMe, tier);
         }
     }
 
@@ -1724,7 +1919,7 @@ static void announceMore(tr_announcer* announcer)
     /* announce some */
     for (int i = 0; i < n; ++i)
     {
-        tr_tier* tier = tr_ptrArrayNth(&announceMe, i);
+        tier = tr_ptrArrayNth(&announceMe, i);
         tr_logAddTorDbg(tier->tor, "%s", "Announcing to tracker");
         dbgmsg(tier, "announcing tier %d of %d", i, n);
         tierAnnounce(announcer, tier);
@@ -1733,6 +1928,17 @@ static void announceMore(tr_announcer* announcer)
     /* scrape some */
     multiscrape(announcer, &scrapeMe);
 
+    /* anything that didn't fit into this pass goes back into the heap */
+    for (int i = 0, count = tr_ptrArraySize(&announceMe); i < count; ++i)
+    {
+        tierScheduleUpkeep(tr_ptrArrayNth(&announceMe, i));
+    }
+
+    for (int i = 0, count = tr_ptrArraySize(&scrapeMe); i < count; ++i)
+    {
+        tierScheduleUpkeep(tr_ptrArrayNth(&scrapeMe, i));
+    }
+
     /* cleanup */
     tr_ptrArrayDestruct(&scrapeMe, NULL);
     tr_ptrArrayDestruct(&announceMe, NULL);
@@ -1920,6 +2126,9 @@ static void copy_tier_attributes_impl(struct tr_tier* tgt, int trackerIndex, tr_
     tgt->currentTracker->leecherCount = src->currentTracker->leecherCount;
     tgt->currentTracker->downloadCount = src->currentTracker->downloadCount;
     tgt->currentTracker->downloaderCount = src->currentTracker->downloaderCount;
+    tgt->upkeepAt = keep.upkeepAt;
+    tgt->upkeepHeapIndex = keep.upkeepHeapIndex;
+    tierScheduleUpkeep(tgt);
 }
 
 static void copy_tier_attributes(struct tr_torrent_tiers* tt, tr_tier const* src)
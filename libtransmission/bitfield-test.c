@@ -221,12 +221,54 @@ static int test_bitfield_has_all_none(void)
     return 0;
 }
 
+static int test_bitfield_counts(void)
+{
+    int const bitCount = 100 + tr_rand_int_weak(1000);
+    uint16_t* counts = tr_new0(uint16_t, bitCount);
+    tr_bitfield bf;
+
+    /* generate a random bitfield */
+    tr_bitfieldConstruct(&bf, bitCount);
+
+    for (int i = 0, n = tr_rand_int_weak(bitCount); i < n; ++i)
+    {
+        tr_bitfieldAdd(&bf, tr_rand_int_weak(bitCount));
+    }
+
+    /* add it twice, then take it away once */
+    tr_bitfieldIncrCounts(&bf, counts, bitCount);
+    tr_bitfieldIncrCounts(&bf, counts, bitCount);
+    tr_bitfieldDecrCounts(&bf, counts, bitCount);
+
+    for (int i = 0; i < bitCount; ++i)
+    {
+        check_int(counts[i], ==, tr_bitfieldHas(&bf, i) ? 1 : 0);
+    }
+
+    /* have-all and have-none */
+    tr_bitfieldSetHasAll(&bf);
+    tr_bitfieldIncrCounts(&bf, counts, bitCount);
+    tr_bitfieldSetHasNone(&bf);
+    tr_bitfieldIncrCounts(&bf, counts, bitCount);
+
+    for (int i = 0; i < bitCount; ++i)
+    {
+        check_int(counts[i], >=, 1);
+        check_int(counts[i], <=, 2);
+    }
+
+    tr_bitfieldDestruct(&bf);
+    tr_free(counts);
+    return 0;
+}
+
 int main(void)
 {
     testFunc const tests[] =
     {
         test_bitfields,
-        test_bitfield_has_all_none
+        test_bitfield_has_all_none,
+        test_bitfield_counts
     };
 
     int ret = runTests(tests, NUM_TESTS(tests));
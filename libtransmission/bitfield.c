@@ -161,6 +161,66 @@ bool tr_bitfieldHas(tr_bitfield const* b, size_t n)
     return (b->bits[n >> 3U] << (n & 7U) & 0x80) != 0;
 }
 
+/* Per-lane masks for expanding one bitfield byte into eight counters.
+   Kept as a constant array so the inner loop below is a fixed-width,
+   branch-free pattern that compilers turn into 128-bit vector ops. */
+static uint8_t const laneMask[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+static void addToCounts(tr_bitfield const* b, uint16_t* counts, size_t count_size, uint16_t delta)
+{
+    if (tr_bitfieldHasAll(b))
+    {
+        for (size_t i = 0; i < count_size; ++i)
+        {
+            counts[i] += delta;
+        }
+
+        return;
+    }
+
+    if (tr_bitfieldHasNone(b) || b->bits == NULL)
+    {
+        return;
+    }
+
+    size_t const full_bytes = MIN(b->alloc_count, count_size >> 3U);
+
+    for (size_t i = 0; i < full_bytes; ++i)
+    {
+        uint8_t const val = b->bits[i];
+
+        if (val != 0)
+        {
+            uint16_t* c = counts + (i << 3U);
+
+            for (size_t j = 0; j < 8; ++j)
+            {
+                c[j] += (uint16_t)(-(uint16_t)((val & laneMask[j]) != 0) & delta);
+            }
+        }
+    }
+
+    /* trailing bits that don't fill a whole byte of counters */
+    for (size_t i = full_bytes << 3U, n = MIN(count_size, b->alloc_count << 3U); i < n; ++i)
+    {
+        if ((b->bits[i >> 3U] & laneMask[i & 7U]) != 0)
+        {
+            counts[i] += delta;
+        }
+    }
+}
+
+void tr_bitfieldIncrCounts(tr_bitfield const* b, uint16_t* counts, size_t count_size)
+{
+    addToCounts(b, counts, count_size, 1);
+}
+
+void tr_bitfieldDecrCounts(tr_bitfield const* b, uint16_t* counts, size_t count_size)
+{
+    /* unsigned wraparound: adding 0xFFFF is the same as subtracting one */
+    addToCounts(b, counts, count_size, UINT16_MAX);
+}
+
 /***
 ****
 ***/
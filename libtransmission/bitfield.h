@@ -91,3 +91,9 @@ static inline bool tr_bitfieldHasNone(tr_bitfield const* b)
 }
 
 bool tr_bitfieldHas(tr_bitfield const* b, size_t n);
+
+/** @brief add one to counts[i] for every bit i in [0, count_size) that's set */
+void tr_bitfieldIncrCounts(tr_bitfield const* b, uint16_t* counts, size_t count_size);
+
+/** @brief subtract one from counts[i] for every bit i in [0, count_size) that's set */
+void tr_bitfieldDecrCounts(tr_bitfield const* b, uint16_t* counts, size_t count_size);
@@ -9,8 +9,13 @@
 #include <stdio.h>
 #include <string.h> /* strlen() */
 
+#include <zlib.h>
+
+#include <event2/buffer.h>
+
 #include "transmission.h"
 #include "blocklist.h"
+#include "crypto-utils.h" /* tr_rand_int_weak() */
 #include "file.h"
 #include "net.h"
 #include "session.h" /* tr_sessionIsAddressBlocked() */
@@ -147,12 +152,328 @@ static int test_updating(void)
 ****
 ***/
 
+static char const* contents3 =
+    "Evilcorp:216.88.88.0-216.88.88.255\n"
+    "2001:db8::/32\n"
+    "2001:db9:1234::/48\n";
+
+static int test_merging(void)
+{
+    char* path;
+    tr_session* session;
+
+    /* two lists, one of them with IPv6 ranges */
+    session = libttest_session_init(NULL);
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "blocklists", "level1", NULL);
+    create_text_file(path, contents1);
+    tr_free(path);
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "blocklists", "level2", NULL);
+    create_text_file(path, contents3);
+    tr_free(path);
+    tr_sessionReloadBlocklists(session);
+    check_int(tr_blocklistGetRuleCount(session), ==, 8);
+    tr_blocklistSetEnabled(session, true);
+
+    /* both lists are checked */
+    check(address_is_blocked(session, "10.1.2.3"));
+    check(address_is_blocked(session, "216.16.1.151"));
+    check(!address_is_blocked(session, "216.16.1.152"));
+    check(!address_is_blocked(session, "216.88.87.255"));
+    check(address_is_blocked(session, "216.88.88.0"));
+    check(address_is_blocked(session, "216.88.88.255"));
+    check(!address_is_blocked(session, "216.88.89.0"));
+
+    /* IPv6 */
+    check(!address_is_blocked(session, "2001:db7:ffff:ffff:ffff:ffff:ffff:ffff"));
+    check(address_is_blocked(session, "2001:db8::"));
+    check(address_is_blocked(session, "2001:db8:ffff:ffff:ffff:ffff:ffff:ffff"));
+    check(!address_is_blocked(session, "2001:db9::1"));
+    check(address_is_blocked(session, "2001:db9:1234:5678::1"));
+    check(!address_is_blocked(session, "2001:db9:1235::"));
+    check(!address_is_blocked(session, "::1"));
+
+    /* IPv4 addresses mapped into IPv6 */
+    check(address_is_blocked(session, "::ffff:216.88.88.1"));
+    check(!address_is_blocked(session, "::ffff:216.88.89.1"));
+
+    /* nothing's blocked when the blocklist is disabled */
+    tr_blocklistSetEnabled(session, false);
+    check(!address_is_blocked(session, "216.88.88.0"));
+    check(!address_is_blocked(session, "2001:db8::"));
+
+    /* cleanup */
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****
+***/
+
+static int test_many_ranges(void)
+{
+    enum
+    {
+        RANGE_COUNT = 1000
+    };
+
+    char* path;
+    tr_session* session;
+    uint32_t begins[RANGE_COUNT];
+    uint32_t ends[RANGE_COUNT];
+    struct evbuffer* buf = evbuffer_new();
+
+    /* random, possibly overlapping, ranges */
+    for (int i = 0; i < RANGE_COUNT; ++i)
+    {
+        begins[i] = (uint32_t)tr_rand_int_weak((1 << 24) - 256) << 8;
+        ends[i] = begins[i] + tr_rand_int_weak(1 << 16);
+        evbuffer_add_printf(buf, "range %d:%u.%u.%u.%u-%u.%u.%u.%u\n", i, begins[i] >> 24, (begins[i] >> 16) & 0xff,
+            (begins[i] >> 8) & 0xff, begins[i] & 0xff, ends[i] >> 24, (ends[i] >> 16) & 0xff, (ends[i] >> 8) & 0xff,
+            ends[i] & 0xff);
+    }
+
+    session = libttest_session_init(NULL);
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "blocklists", "level1", NULL);
+    evbuffer_add(buf, "", 1);
+    create_text_file(path, (char const*)evbuffer_pullup(buf, -1));
+    tr_free(path);
+    tr_sessionReloadBlocklists(session);
+    tr_blocklistSetEnabled(session, true);
+
+    /* compare with a brute-force search, near the edges and at random */
+    for (int i = 0; i < 20000; ++i)
+    {
+        uint32_t needle;
+        bool expected = false;
+        tr_address addr;
+
+        switch (i % 4)
+        {
+        case 0:
+            needle = begins[tr_rand_int_weak(RANGE_COUNT)] - 1;
+            break;
+
+        case 1:
+            needle = ends[tr_rand_int_weak(RANGE_COUNT)] + 1;
+            break;
+
+        case 2:
+            needle = ends[tr_rand_int_weak(RANGE_COUNT)];
+            break;
+
+        default:
+            needle = (uint32_t)tr_rand_int_weak(1 << 16) << 16 | tr_rand_int_weak(1 << 16);
+            break;
+        }
+
+        for (int j = 0; !expected && j < RANGE_COUNT; ++j)
+        {
+            expected = begins[j] <= needle && needle <= ends[j];
+        }
+
+        addr.type = TR_AF_INET;
+        addr.addr.addr4.s_addr = htonl(needle);
+        check_bool(tr_sessionIsAddressBlocked(session, &addr), ==, expected);
+    }
+
+    /* cleanup */
+    libttest_session_close(session);
+    evbuffer_free(buf);
+    return 0;
+}
+
+/***
+****
+***/
+
+static char const* contents4 =
+    "# DAT format, with DOS line endings and no newline at the end\r\n"
+    "000.000.000.000 - 000.255.255.255 , 000 , invalid ip\r\n"
+    "216.016.001.144 - 216.016.001.151 , 100 , Austin Law Firm\r\n"
+    "216.019.018.255 - 216.019.018.000 , 100 , backwards\r\n"
+    "216.079.131.192 - 216.079.131.223 , 100 , Fox Speed Channel";
+
+static int test_formats(void)
+{
+    char* path;
+    tr_session* session;
+
+    session = libttest_session_init(NULL);
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "level1.dat", NULL);
+    create_text_file(path, contents4);
+    check_int(tr_blocklistSetContent(session, path), ==, 3);
+    tr_blocklistSetEnabled(session, true);
+
+    check(address_is_blocked(session, "0.1.2.3"));
+    check(!address_is_blocked(session, "216.16.1.143"));
+    check(address_is_blocked(session, "216.16.1.144"));
+    check(address_is_blocked(session, "216.16.1.151"));
+    check(!address_is_blocked(session, "216.19.18.128"));
+    check(address_is_blocked(session, "216.79.131.223"));
+    check(!address_is_blocked(session, "216.79.131.224"));
+
+    /* cleanup */
+    libttest_session_close(session);
+    tr_free(path);
+    return 0;
+}
+
+/***
+****
+***/
+
+static void create_compressed_file(char const* path, char const* contents, bool zip)
+{
+    z_stream stream;
+    uLong const len = strlen(contents);
+    uLong deflated_len;
+    uint8_t* deflated;
+    struct evbuffer* buf = evbuffer_new();
+
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, zip ? -MAX_WBITS : 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    deflated_len = deflateBound(&stream, len);
+    deflated = tr_new(uint8_t, deflated_len);
+    stream.next_in = (Bytef*)contents;
+    stream.avail_in = len;
+    stream.next_out = deflated;
+    stream.avail_out = deflated_len;
+    deflate(&stream, Z_FINISH);
+    deflated_len = stream.total_out;
+    deflateEnd(&stream);
+
+    if (zip)
+    {
+        /* a local file header for "level1.p2p", deflated */
+        uint32_t const fields[] = { 0x04034b50, 20, 0, Z_DEFLATED, 0, 0, crc32(0, (Bytef const*)contents, len), deflated_len,
+            len, 10, 0 };
+        int const sizes[] = { 4, 2, 2, 2, 2, 2, 4, 4, 4, 2, 2 };
+
+        for (size_t i = 0; i < TR_N_ELEMENTS(fields); ++i)
+        {
+            for (int j = 0; j < sizes[i]; ++j)
+            {
+                uint8_t const ch = (fields[i] >> (8 * j)) & 0xff;
+                evbuffer_add(buf, &ch, 1);
+            }
+        }
+
+        evbuffer_add(buf, "level1.p2p", 10);
+    }
+
+    evbuffer_add(buf, deflated, deflated_len);
+    libtest_create_file_with_contents(path, evbuffer_pullup(buf, -1), evbuffer_get_length(buf));
+
+    tr_free(deflated);
+    evbuffer_free(buf);
+}
+
+static int test_compressed(void)
+{
+    char* path;
+    tr_session* session;
+
+    session = libttest_session_init(NULL);
+    tr_blocklistSetEnabled(session, true);
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "level1.gz", NULL);
+    create_compressed_file(path, contents2, false);
+    check_int(tr_blocklistSetContent(session, path), ==, 6);
+    check(address_is_blocked(session, "216.88.88.0"));
+    check(!address_is_blocked(session, "216.88.89.0"));
+    tr_free(path);
+
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "level1.zip", NULL);
+    create_compressed_file(path, contents1, true);
+    check_int(tr_blocklistSetContent(session, path), ==, 5);
+    check(address_is_blocked(session, "216.16.1.144"));
+    check(!address_is_blocked(session, "216.88.88.0"));
+    tr_free(path);
+
+    /* a text list whose first bytes happen to look like a zlib header */
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "level1", NULL);
+    create_text_file(path, "x^ marks the spot:216.88.88.0-216.88.88.255\n");
+    check_int(tr_blocklistSetContent(session, path), ==, 1);
+    check(address_is_blocked(session, "216.88.88.0"));
+    create_text_file(path, "xmas:216.88.89.0-216.88.89.255\n");
+    check_int(tr_blocklistSetContent(session, path), ==, 1);
+    check(address_is_blocked(session, "216.88.89.0"));
+    tr_free(path);
+
+    /* removing the list */
+    check_int(tr_blocklistSetContent(session, NULL), ==, 0);
+    check_int(tr_blocklistGetRuleCount(session), ==, 0);
+    check(!address_is_blocked(session, "216.16.1.144"));
+
+    /* cleanup */
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****
+***/
+
+static void on_blocklist_compiled(tr_session* session UNUSED, char const* contentFilename UNUSED, int ruleCount,
+    void* user_data)
+{
+    *(int*)user_data = ruleCount;
+}
+
+static int test_async(void)
+{
+    char* path;
+    tr_session* session;
+    int rule_count = -1;
+
+    session = libttest_session_init(NULL);
+    tr_blocklistSetEnabled(session, true);
+    path = tr_buildPath(tr_sessionGetConfigDir(session), "level1", NULL);
+    create_text_file(path, contents1);
+    check_int(tr_blocklistSetContent(session, path), ==, 5);
+    check(!address_is_blocked(session, "216.88.88.0"));
+
+    /* the old list stays in use until the new one is compiled */
+    create_text_file(path, contents2);
+    tr_sessionSetBlocklistContentAsync(session, path, on_blocklist_compiled, &rule_count);
+
+    for (int i = 0; rule_count == -1 && i < 100; ++i)
+    {
+        check(address_is_blocked(session, "216.16.1.144"));
+        tr_wait_msec(50);
+    }
+
+    check_int(rule_count, ==, 6);
+    check(address_is_blocked(session, "216.88.88.0"));
+    check_int(tr_blocklistGetRuleCount(session), ==, 6);
+
+    /* closing the session waits for a compile that's still running */
+    rule_count = -1;
+    create_text_file(path, contents1);
+    tr_sessionSetBlocklistContentAsync(session, path, on_blocklist_compiled, &rule_count);
+    libttest_session_close(session);
+    check_int(rule_count, ==, 5);
+
+    /* cleanup */
+    tr_free(path);
+    return 0;
+}
+
+/***
+****
+***/
+
 int main(void)
 {
     testFunc const tests[] =
     {
         test_parsing,
-        test_updating
+        test_updating,
+        test_merging,
+        test_many_ranges,
+        test_formats,
+        test_compressed,
+        test_async
     };
 
     return runTests(tests, NUM_TESTS(tests));
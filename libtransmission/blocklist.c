@@ -11,6 +11,8 @@
 #include <stdlib.h> /* bsearch(), qsort() */
 #include <string.h>
 
+#include <zlib.h>
+
 #include "transmission.h"
 #include "blocklist.h"
 #include "error.h"
@@ -30,6 +32,35 @@ struct tr_ipv4_range
     uint32_t end;
 };
 
+/* an IPv6 address in host byte order, split in two so that
+ * addresses can be compared as integers */
+struct tr_ipv6_addr
+{
+    uint64_t hi;
+    uint64_t lo;
+};
+
+struct tr_ipv6_range
+{
+    struct tr_ipv6_addr begin;
+    struct tr_ipv6_addr end;
+};
+
+/* A compiled blocklist file ("*.bin") is this header, followed by
+ * `ipv4_count' tr_ipv4_ranges and then `ipv6_count' tr_ipv6_ranges.
+ * Each array is sorted and its ranges don't overlap.
+ * Files written before the header existed are a bare tr_ipv4_range array. */
+#define BLOCKLIST_FILE_MAGIC "TRBL"
+#define BLOCKLIST_FILE_VERSION 1
+
+struct tr_blocklist_header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t ipv4_count;
+    uint32_t ipv6_count;
+};
+
 struct tr_blocklistFile
 {
     bool isEnabled;
@@ -37,22 +68,57 @@ struct tr_blocklistFile
     size_t ruleCount;
     uint64_t byteCount;
     char* filename;
-    struct tr_ipv4_range* rules;
+    void* map;
+    struct tr_ipv4_range const* ipv4;
+    size_t ipv4Count;
+    struct tr_ipv6_range const* ipv6;
+    size_t ipv6Count;
 };
 
 static void blocklistClose(tr_blocklistFile* b)
 {
-    if (b->rules != NULL)
+    if (b->map != NULL)
     {
-        tr_sys_file_unmap(b->rules, b->byteCount, NULL);
+        tr_sys_file_unmap(b->map, b->byteCount, NULL);
         tr_sys_file_close(b->fd, NULL);
-        b->rules = NULL;
+        b->map = NULL;
+        b->ipv4 = NULL;
+        b->ipv4Count = 0;
+        b->ipv6 = NULL;
+        b->ipv6Count = 0;
         b->ruleCount = 0;
         b->byteCount = 0;
         b->fd = TR_BAD_SYS_FILE;
     }
 }
 
+static bool blocklistParseMap(tr_blocklistFile* b)
+{
+    struct tr_blocklist_header const* header = b->map;
+
+    if (b->byteCount >= sizeof(struct tr_blocklist_header) &&
+        memcmp(header->magic, BLOCKLIST_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == BLOCKLIST_FILE_VERSION &&
+        b->byteCount == sizeof(struct tr_blocklist_header) + header->ipv4_count * sizeof(struct tr_ipv4_range) +
+        header->ipv6_count * sizeof(struct tr_ipv6_range))
+    {
+        b->ipv4 = (struct tr_ipv4_range const*)(header + 1);
+        b->ipv4Count = header->ipv4_count;
+        b->ipv6 = (struct tr_ipv6_range const*)(b->ipv4 + b->ipv4Count);
+        b->ipv6Count = header->ipv6_count;
+        return true;
+    }
+
+    if (b->byteCount % sizeof(struct tr_ipv4_range) == 0) /* the old format */
+    {
+        b->ipv4 = b->map;
+        b->ipv4Count = b->byteCount / sizeof(struct tr_ipv4_range);
+        return true;
+    }
+
+    return false;
+}
+
 static void blocklistLoad(tr_blocklistFile* b)
 {
     tr_sys_file_t fd;
@@ -85,9 +151,9 @@ static void blocklistLoad(tr_blocklistFile* b)
         return;
     }
 
-    b->rules = tr_sys_file_map_for_reading(fd, 0, byteCount, &error);
+    b->map = tr_sys_file_map_for_reading(fd, 0, byteCount, &error);
 
-    if (b->rules == NULL)
+    if (b->map == NULL)
     {
         tr_logAddError(err_fmt, b->filename, error->message);
         tr_sys_file_close(fd, NULL);
@@ -97,37 +163,47 @@ static void blocklistLoad(tr_blocklistFile* b)
 
     b->fd = fd;
     b->byteCount = byteCount;
-    b->ruleCount = byteCount / sizeof(struct tr_ipv4_range);
 
     base = tr_sys_path_basename(b->filename, NULL);
-    tr_logAddInfo(_("Blocklist \"%s\" contains %zu entries"), base, b->ruleCount);
+
+    if (!blocklistParseMap(b))
+    {
+        tr_logAddError(_("Blocklist \"%s\" is in an unknown format"), base);
+        blocklistClose(b);
+    }
+    else
+    {
+        b->ruleCount = b->ipv4Count + b->ipv6Count;
+        tr_logAddInfo(_("Blocklist \"%s\" contains %zu entries"), base, b->ruleCount);
+    }
+
     tr_free(base);
 }
 
 static void blocklistEnsureLoaded(tr_blocklistFile* b)
 {
-    if (b->rules == NULL)
+    if (b->map == NULL)
     {
         blocklistLoad(b);
     }
 }
 
-static int compareAddressToRange(void const* va, void const* vb)
+static inline bool ipv6AddrIsLess(struct tr_ipv6_addr const* a, struct tr_ipv6_addr const* b)
 {
-    uint32_t const* a = va;
-    struct tr_ipv4_range const* b = vb;
+    return a->hi < b->hi || (a->hi == b->hi && a->lo < b->lo);
+}
 
-    if (*a < b->begin)
-    {
-        return -1;
-    }
+static struct tr_ipv6_addr ipv6AddrFromBytes(uint8_t const* bytes)
+{
+    struct tr_ipv6_addr addr = { 0, 0 };
 
-    if (*a > b->end)
+    for (int i = 0; i < 8; ++i)
     {
-        return 1;
+        addr.hi = (addr.hi << 8) | bytes[i];
+        addr.lo = (addr.lo << 8) | bytes[i + 8];
     }
 
-    return 0;
+    return addr;
 }
 
 static void blocklistDelete(tr_blocklistFile* b)
@@ -188,30 +264,92 @@ void tr_blocklistFileSetEnabled(tr_blocklistFile* b, bool isEnabled)
     b->isEnabled = isEnabled;
 }
 
-bool tr_blocklistFileHasAddress(tr_blocklistFile* b, tr_address const* addr)
+/***
+****  Parsing.
+****
+****  Lists can run to millions of lines, so the IPv4 formats are parsed
+****  by hand rather than with sscanf() and tr_address_from_string().
+***/
+
+static inline char const* skipSpaces(char const* walk)
 {
-    TR_ASSERT(tr_address_is_valid(addr));
+    while (*walk == ' ' || *walk == '\t')
+    {
+        ++walk;
+    }
+
+    return walk;
+}
 
-    uint32_t needle;
-    struct tr_ipv4_range const* range;
+/* a decimal number of up to `max_digits' digits */
+static char const* parseNumber(char const* walk, int max_digits, unsigned int* setme)
+{
+    int digits = 0;
+    unsigned int n = 0;
 
-    if (!b->isEnabled || addr->type == TR_AF_INET6)
+    while (digits < max_digits && '0' <= *walk && *walk <= '9')
     {
-        return false;
+        n = n * 10 + (unsigned int)(*walk - '0');
+        ++walk;
+        ++digits;
     }
 
-    blocklistEnsureLoaded(b);
+    if (digits == 0)
+    {
+        return NULL;
+    }
 
-    if (b->rules == NULL || b->ruleCount == 0)
+    *setme = n;
+    return walk;
+}
+
+/* "x.x.x.x", in host byte order. DAT lists pad each octet with zeroes */
+static char const* parseIPv4(char const* walk, uint32_t* setme)
+{
+    uint32_t addr = 0;
+
+    for (int i = 0; i < 4; ++i)
     {
-        return false;
+        unsigned int octet;
+
+        if (i > 0 && *walk++ != '.')
+        {
+            return NULL;
+        }
+
+        if ((walk = parseNumber(walk, 3, &octet)) == NULL || octet > 0xff)
+        {
+            return NULL;
+        }
+
+        addr = addr << 8 | octet;
+    }
+
+    *setme = addr;
+    return walk;
+}
+
+/* "x.x.x.x - y.y.y.y" */
+static char const* parseIPv4Range(char const* walk, struct tr_ipv4_range* range)
+{
+    if ((walk = parseIPv4(skipSpaces(walk), &range->begin)) == NULL)
+    {
+        return NULL;
     }
 
-    needle = ntohl(addr->addr.addr4.s_addr);
+    walk = skipSpaces(walk);
 
-    range = bsearch(&needle, b->rules, b->ruleCount, sizeof(struct tr_ipv4_range), compareAddressToRange);
+    if (*walk++ != '-')
+    {
+        return NULL;
+    }
 
-    return range != NULL;
+    if ((walk = parseIPv4(skipSpaces(walk), &range->end)) == NULL || range->end < range->begin)
+    {
+        return NULL;
+    }
+
+    return walk;
 }
 
 /*
@@ -221,146 +359,458 @@ bool tr_blocklistFileHasAddress(tr_blocklistFile* b, tr_address const* addr)
  */
 static bool parseLine1(char const* line, struct tr_ipv4_range* range)
 {
-    char* walk;
-    int b[4];
-    int e[4];
-    char str[64];
-    tr_address addr;
-
-    walk = strrchr(line, ':');
+    char const* walk = strrchr(line, ':');
 
-    if (walk == NULL)
-    {
-        return false;
-    }
+    return walk != NULL && parseIPv4Range(walk + 1, range) != NULL;
+}
 
-    ++walk; /* walk past the colon */
+/*
+ * DAT format: "000.000.000.000 - 000.255.255.255 , 000 , invalid ip"
+ * http://wiki.phoenixlabs.org/wiki/DAT_Format
+ */
+static bool parseLine2(char const* line, struct tr_ipv4_range* range)
+{
+    unsigned int level;
+    char const* walk = parseIPv4Range(line, range);
 
-    if (sscanf(walk, "%d.%d.%d.%d-%d.%d.%d.%d", &b[0], &b[1], &b[2], &b[3], &e[0], &e[1], &e[2], &e[3]) != 8)
+    if (walk == NULL)
     {
         return false;
     }
 
-    tr_snprintf(str, sizeof(str), "%d.%d.%d.%d", b[0], b[1], b[2], b[3]);
+    walk = skipSpaces(walk);
 
-    if (!tr_address_from_string(&addr, str))
+    if (*walk++ != ',')
     {
         return false;
     }
 
-    range->begin = ntohl(addr.addr.addr4.s_addr);
+    return parseNumber(skipSpaces(walk), 3, &level) != NULL;
+}
 
-    tr_snprintf(str, sizeof(str), "%d.%d.%d.%d", e[0], e[1], e[2], e[3]);
+/*
+ * CIDR notation: "0.0.0.0/8", IPv4 only
+ * https://en.wikipedia.org/wiki/Classless_Inter-Domain_Routing#CIDR_notation
+ */
+static bool parseLine3(char const* line, struct tr_ipv4_range* range)
+{
+    uint32_t ip;
+    unsigned int pflen;
+    uint32_t mask = 0xffffffff;
+    char const* walk = parseIPv4(skipSpaces(line), &ip);
 
-    if (!tr_address_from_string(&addr, str))
+    if (walk == NULL || *walk++ != '/' || parseNumber(walk, 2, &pflen) == NULL || pflen > 32)
     {
         return false;
     }
 
-    range->end = ntohl(addr.addr.addr4.s_addr);
+    /* this is host order */
+    mask = pflen == 0 ? 0 : mask << (32 - pflen);
+
+    /* fill the non-prefix bits the way we need it */
+    range->begin = ip & mask;
+    range->end = ip | (~mask);
 
     return true;
 }
 
+static bool parseLine(char const* line, struct tr_ipv4_range* range)
+{
+    return parseLine1(line, range) || parseLine2(line, range) || parseLine3(line, range);
+}
+
 /*
- * DAT format: "000.000.000.000 - 000.255.255.255 , 000 , invalid ip"
- * http://wiki.phoenixlabs.org/wiki/DAT_Format
+ * CIDR notation for IPv6: "2001:db8::/32"
  */
-static bool parseLine2(char const* line, struct tr_ipv4_range* range)
+static bool parseLine6(char const* line, struct tr_ipv6_range* range)
 {
-    int unk;
-    int a[4];
-    int b[4];
-    char str[32];
+    char const* slash;
+    char str[64];
+    unsigned int pflen;
     tr_address addr;
+    struct tr_ipv6_addr ip;
+    uint64_t hi_mask;
+    uint64_t lo_mask;
+
+    line = skipSpaces(line);
+    slash = strchr(line, '/');
 
-    if (sscanf(line, "%3d.%3d.%3d.%3d - %3d.%3d.%3d.%3d , %3d , ", &a[0], &a[1], &a[2], &a[3], &b[0], &b[1], &b[2], &b[3],
-        &unk) != 9)
+    if (slash == NULL || (size_t)(slash - line) >= sizeof(str) || parseNumber(slash + 1, 3, &pflen) == NULL || pflen > 128)
     {
         return false;
     }
 
-    tr_snprintf(str, sizeof(str), "%d.%d.%d.%d", a[0], a[1], a[2], a[3]);
+    memcpy(str, line, slash - line);
+    str[slash - line] = '\0';
 
-    if (!tr_address_from_string(&addr, str))
+    if (!tr_address_from_string(&addr, str) || addr.type != TR_AF_INET6)
     {
         return false;
     }
 
-    range->begin = ntohl(addr.addr.addr4.s_addr);
+    ip = ipv6AddrFromBytes(addr.addr.addr6.s6_addr);
+
+    /* this is host order */
+    hi_mask = pflen >= 64 ? UINT64_MAX : pflen == 0 ? 0 : UINT64_MAX << (64 - pflen);
+    lo_mask = pflen <= 64 ? 0 : UINT64_MAX << (128 - pflen);
+
+    /* fill the non-prefix bits the way we need it */
+    range->begin.hi = ip.hi & hi_mask;
+    range->begin.lo = ip.lo & lo_mask;
+    range->end.hi = ip.hi | ~hi_mask;
+    range->end.lo = ip.lo | ~lo_mask;
+
+    return true;
+}
+
+/* LSD radix sort on `begin', a byte at a time. Passes over a byte
+ * that's the same in every range are skipped */
+static void sortIPv4Ranges(struct tr_ipv4_range* ranges, size_t ranges_count)
+{
+    size_t counts[4][256];
+    struct tr_ipv4_range* src = ranges;
+    struct tr_ipv4_range* dst = tr_new(struct tr_ipv4_range, ranges_count);
+    struct tr_ipv4_range* const tmp = dst;
 
-    tr_snprintf(str, sizeof(str), "%d.%d.%d.%d", b[0], b[1], b[2], b[3]);
+    memset(counts, 0, sizeof(counts));
 
-    if (!tr_address_from_string(&addr, str))
+    for (size_t i = 0; i < ranges_count; ++i)
     {
-        return false;
+        uint32_t const begin = ranges[i].begin;
+
+        ++counts[0][begin & 0xff];
+        ++counts[1][(begin >> 8) & 0xff];
+        ++counts[2][(begin >> 16) & 0xff];
+        ++counts[3][begin >> 24];
     }
 
-    range->end = ntohl(addr.addr.addr4.s_addr);
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        int const shift = pass * 8;
+        size_t* const offsets = counts[pass];
+        size_t offset = 0;
 
-    return true;
+        if (offsets[(src[0].begin >> shift) & 0xff] == ranges_count)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < 256; ++i)
+        {
+            size_t const count = offsets[i];
+            offsets[i] = offset;
+            offset += count;
+        }
+
+        for (size_t i = 0; i < ranges_count; ++i)
+        {
+            dst[offsets[(src[i].begin >> shift) & 0xff]++] = src[i];
+        }
+
+        dst = src;
+        src = src == ranges ? tmp : ranges;
+    }
+
+    if (src != ranges)
+    {
+        memcpy(ranges, src, sizeof(struct tr_ipv4_range) * ranges_count);
+    }
+
+    tr_free(tmp);
 }
 
-/*
- * CIDR notation: "0.0.0.0/8", IPv4 only
- * https://en.wikipedia.org/wiki/Classless_Inter-Domain_Routing#CIDR_notation
- */
-static bool parseLine3(char const* line, struct tr_ipv4_range* range)
+static int compareIPv6RangesByFirstAddress(void const* va, void const* vb)
 {
-    unsigned int ip[4];
-    unsigned int pflen;
-    uint32_t ip_u;
-    uint32_t mask = 0xffffffff;
+    struct tr_ipv6_range const* a = va;
+    struct tr_ipv6_range const* b = vb;
+
+    if (ipv6AddrIsLess(&a->begin, &b->begin))
+    {
+        return -1;
+    }
+
+    if (ipv6AddrIsLess(&b->begin, &a->begin))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+static size_t mergeIPv4Ranges(struct tr_ipv4_range* ranges, size_t ranges_count)
+{
+    struct tr_ipv4_range* keep = ranges;
+
+    if (ranges_count == 0)
+    {
+        return 0;
+    }
+
+    sortIPv4Ranges(ranges, ranges_count);
+
+    for (size_t i = 1; i < ranges_count; ++i)
+    {
+        struct tr_ipv4_range const* r = &ranges[i];
+
+        if (keep->end < r->begin)
+        {
+            *++keep = *r;
+        }
+        else if (keep->end < r->end)
+        {
+            keep->end = r->end;
+        }
+    }
+
+    return keep + 1 - ranges;
+}
+
+static size_t mergeIPv6Ranges(struct tr_ipv6_range* ranges, size_t ranges_count)
+{
+    struct tr_ipv6_range* keep = ranges;
+
+    if (ranges_count == 0)
+    {
+        return 0;
+    }
+
+    qsort(ranges, ranges_count, sizeof(struct tr_ipv6_range), compareIPv6RangesByFirstAddress);
+
+    for (size_t i = 1; i < ranges_count; ++i)
+    {
+        struct tr_ipv6_range const* r = &ranges[i];
+
+        if (ipv6AddrIsLess(&keep->end, &r->begin))
+        {
+            *++keep = *r;
+        }
+        else if (ipv6AddrIsLess(&keep->end, &r->end))
+        {
+            keep->end = r->end;
+        }
+    }
+
+    return keep + 1 - ranges;
+}
+
+/***
+****  Reading the source list.
+****
+****  Lists are read in large chunks rather than a line at a time, and
+****  gzip, zlib, and zip (the first entry) files are inflated on the fly.
+***/
+
+#define BLOCKLIST_READ_SIZE (1024 * 256)
+
+struct blocklist_source
+{
+    tr_sys_file_t fd;
+    bool isInflating;
+    bool isDone;
+
+    /* bytes of a stored zip entry left to read */
+    uint64_t remaining;
+
+    /* if nonzero, `buf' still holds the first rewind_len bytes of the file.
+     * That's what a list that only looked compressed is read from again */
+    size_t rewind_len;
+
+    /* next_in and avail_in are the unread part of `buf',
+     * whether or not the source is being inflated */
+    z_stream stream;
+    uint8_t* buf;
+};
+
+static size_t sourceFill(struct blocklist_source* src)
+{
+    uint64_t n = 0;
+
+    tr_sys_file_read(src->fd, src->buf, BLOCKLIST_READ_SIZE, &n, NULL);
+    src->stream.next_in = src->buf;
+    src->stream.avail_in = n;
+    src->rewind_len = 0;
+    return n;
+}
+
+static inline uint32_t readLE(uint8_t const* walk, int n)
+{
+    uint32_t val = 0;
+
+    while (n-- > 0)
+    {
+        val = val << 8 | walk[n];
+    }
+
+    return val;
+}
+
+/* https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT, 4.3.7 */
+static bool sourceOpenZip(struct blocklist_source* src)
+{
+    uint8_t const* const header = src->stream.next_in;
+    uint32_t const flags = readLE(header + 6, 2);
+    uint32_t const method = readLE(header + 8, 2);
+    size_t const header_len = 30 + readLE(header + 26, 2) + readLE(header + 28, 2);
 
-    if (sscanf(line, "%u.%u.%u.%u/%u", &ip[0], &ip[1], &ip[2], &ip[3], &pflen) != 5)
+    if (header_len > src->stream.avail_in)
     {
         return false;
     }
 
-    if (pflen > 32 || ip[0] > 0xff || ip[1] > 0xff || ip[2] > 0xff || ip[3] > 0xff)
+    src->stream.next_in += header_len;
+    src->stream.avail_in -= header_len;
+
+    if (method == Z_DEFLATED)
+    {
+        src->isInflating = true;
+        return inflateInit2(&src->stream, -MAX_WBITS) == Z_OK;
+    }
+
+    /* a stored entry is only delimited by its size, which is
+     * in the data descriptor instead if bit 3 of the flags is set */
+    if (method == 0 && (flags & 0x08) == 0)
+    {
+        src->remaining = readLE(header + 18, 4);
+        return true;
+    }
+
+    return false;
+}
+
+static bool sourceOpen(struct blocklist_source* src, char const* filename, tr_error** error)
+{
+    uint8_t const* magic;
+    bool ok = true;
+
+    memset(src, 0, sizeof(struct blocklist_source));
+    src->remaining = UINT64_MAX;
+    src->fd = tr_sys_file_open(filename, TR_SYS_FILE_READ | TR_SYS_FILE_SEQUENTIAL, 0, error);
+
+    if (src->fd == TR_BAD_SYS_FILE)
     {
         return false;
     }
 
-    /* this is host order */
-    mask <<= 32 - pflen;
-    ip_u = ip[0] << 24 | ip[1] << 16 | ip[2] << 8 | ip[3];
+    src->buf = tr_new(uint8_t, BLOCKLIST_READ_SIZE);
+    sourceFill(src);
+    magic = src->stream.next_in;
 
-    /* fill the non-prefix bits the way we need it */
-    range->begin = ip_u & mask;
-    range->end = ip_u | (~mask);
+    if (src->stream.avail_in >= 30 && memcmp(magic, "PK\003\004", 4) == 0)
+    {
+        ok = sourceOpenZip(src);
+    }
+    else if (src->stream.avail_in >= 2 && ((magic[0] == 0x1f && magic[1] == 0x8b) ||
+        ((magic[0] & 0x0f) == Z_DEFLATED && (magic[0] << 8 | magic[1]) % 31 == 0 && (magic[1] & 0x20) == 0)))
+    {
+        /* that's a gzip header, or a zlib header (RFC 1950) for deflate with no preset
+         * dictionary. 15 + 32 lets zlib tell the two apart. See inflateInit2() */
+        src->isInflating = true;
+        src->rewind_len = src->stream.avail_in;
+        ok = inflateInit2(&src->stream, 15 + 32) == Z_OK;
+    }
 
-    return true;
+    if (!ok)
+    {
+        tr_error_set_literal(error, 0, _("Unsupported compression"));
+    }
+
+    return ok;
 }
 
-static bool parseLine(char const* line, struct tr_ipv4_range* range)
+static void sourceClose(struct blocklist_source* src)
 {
-    return parseLine1(line, range) || parseLine2(line, range) || parseLine3(line, range);
+    if (src->isInflating)
+    {
+        inflateEnd(&src->stream);
+    }
+
+    tr_free(src->buf);
+    tr_sys_file_close(src->fd, NULL);
 }
 
-static int compareAddressRangesByFirstAddress(void const* va, void const* vb)
+/* returns the number of bytes read into `buf', or 0 at the end of the input */
+static size_t sourceRead(struct blocklist_source* src, char* buf, size_t buflen)
 {
-    struct tr_ipv4_range const* a = va;
-    struct tr_ipv4_range const* b = vb;
+    if (src->isDone)
+    {
+        return 0;
+    }
 
-    if (a->begin != b->begin)
+    if (!src->isInflating)
     {
-        return a->begin < b->begin ? -1 : 1;
+        size_t n;
+
+        if (src->stream.avail_in == 0 && sourceFill(src) == 0)
+        {
+            src->isDone = true;
+            return 0;
+        }
+
+        n = MIN(buflen, src->stream.avail_in);
+        n = (size_t)MIN(n, src->remaining);
+        memcpy(buf, src->stream.next_in, n);
+        src->stream.next_in += n;
+        src->stream.avail_in -= n;
+        src->remaining -= n;
+        src->isDone = src->remaining == 0;
+        return n;
     }
 
-    return 0;
+    src->stream.next_out = (Bytef*)buf;
+    src->stream.avail_out = buflen;
+
+    while (!src->isDone && src->stream.avail_out == buflen)
+    {
+        int err;
+
+        if (src->stream.avail_in == 0 && sourceFill(src) == 0)
+        {
+            src->isDone = true; /* truncated; keep what we've got */
+            break;
+        }
+
+        err = inflate(&src->stream, Z_NO_FLUSH);
+
+        if (err == Z_STREAM_END)
+        {
+            src->isDone = true;
+        }
+        else if (err != Z_OK && src->rewind_len != 0 && src->stream.total_out == 0)
+        {
+            /* a text list can start with what looks like a zlib header,
+             * so read it as text after all */
+            inflateEnd(&src->stream);
+            src->isInflating = false;
+            src->stream.next_in = src->buf;
+            src->stream.avail_in = src->rewind_len;
+            return sourceRead(src, buf, buflen);
+        }
+        else if (err != Z_OK)
+        {
+            tr_logAddError(_("Error uncompressing blocklist: %s (%d)"), zError(err), err);
+            src->isDone = true;
+        }
+    }
+
+    return buflen - src->stream.avail_out;
 }
 
 int tr_blocklistFileSetContent(tr_blocklistFile* b, char const* filename)
 {
-    tr_sys_file_t in;
     tr_sys_file_t out;
     int inCount = 0;
-    char line[2048];
+    char* buf;
+    size_t buf_len = 0;
+    bool is_overlong = false;
     char const* err_fmt = _("Couldn't read \"%1$s\": %2$s");
+    struct blocklist_source src;
     struct tr_ipv4_range* ranges = NULL;
     size_t ranges_alloc = 0;
     size_t ranges_count = 0;
+    struct tr_ipv6_range* ranges6 = NULL;
+    size_t ranges6_alloc = 0;
+    size_t ranges6_count = 0;
+    struct tr_blocklist_header header;
     tr_error* error = NULL;
 
     if (filename == NULL)
@@ -369,12 +819,16 @@ int tr_blocklistFileSetContent(tr_blocklistFile* b, char const* filename)
         return 0;
     }
 
-    in = tr_sys_file_open(filename, TR_SYS_FILE_READ, 0, &error);
-
-    if (in == TR_BAD_SYS_FILE)
+    if (!sourceOpen(&src, filename, &error))
     {
         tr_logAddError(err_fmt, filename, error->message);
         tr_error_free(error);
+
+        if (src.fd != TR_BAD_SYS_FILE)
+        {
+            sourceClose(&src);
+        }
+
         return 0;
     }
 
@@ -386,76 +840,134 @@ int tr_blocklistFileSetContent(tr_blocklistFile* b, char const* filename)
     {
         tr_logAddError(err_fmt, b->filename, error->message);
         tr_error_free(error);
-        tr_sys_file_close(in, NULL);
+        sourceClose(&src);
         return 0;
     }
 
-    /* load the rules into memory */
-    while (tr_sys_file_read_line(in, line, sizeof(line), NULL))
-    {
-        struct tr_ipv4_range range;
+    /* load the rules into memory. `buf' has room for a newline
+     * to be added after the last line if the file doesn't end with one */
+    buf = tr_new(char, BLOCKLIST_READ_SIZE + 1);
 
-        ++inCount;
+    for (;;)
+    {
+        size_t const n = sourceRead(&src, buf + buf_len, BLOCKLIST_READ_SIZE - buf_len);
+        char* walk = buf;
+        char* end = buf + buf_len + n;
+        char* eol;
 
-        if (!parseLine(line, &range))
+        if (n == 0)
         {
-            /* don't try to display the actual lines - it causes issues */
-            tr_logAddError(_("blocklist skipped invalid address at line %d"), inCount);
-            continue;
-        }
+            if (buf_len == 0)
+            {
+                break;
+            }
 
-        if (ranges_alloc == ranges_count)
-        {
-            ranges_alloc += 4096; /* arbitrary */
-            ranges = tr_renew(struct tr_ipv4_range, ranges, ranges_alloc);
+            *end++ = '\n';
         }
 
-        ranges[ranges_count++] = range;
-    }
+        while ((eol = memchr(walk, '\n', end - walk)) != NULL)
+        {
+            struct tr_ipv4_range range;
+            struct tr_ipv6_range range6;
 
-    if (ranges_count > 0) /* sort and merge */
-    {
-        struct tr_ipv4_range* keep = ranges;
+            ++inCount;
+            *eol = '\0';
 
-        /* sort */
-        qsort(ranges, ranges_count, sizeof(struct tr_ipv4_range), compareAddressRangesByFirstAddress);
+            if (eol != walk && eol[-1] == '\r')
+            {
+                eol[-1] = '\0';
+            }
 
-        /* merge */
-        for (size_t i = 1; i < ranges_count; ++i)
-        {
-            struct tr_ipv4_range const* r = &ranges[i];
+            if (!is_overlong && parseLine(walk, &range))
+            {
+                if (ranges_alloc == ranges_count)
+                {
+                    ranges_alloc = ranges_alloc == 0 ? 4096 : ranges_alloc * 2;
+                    ranges = tr_renew(struct tr_ipv4_range, ranges, ranges_alloc);
+                }
 
-            if (keep->end < r->begin)
+                ranges[ranges_count++] = range;
+            }
+            else if (!is_overlong && strchr(walk, ':') != NULL && parseLine6(walk, &range6))
             {
-                *++keep = *r;
+                if (ranges6_alloc == ranges6_count)
+                {
+                    ranges6_alloc = ranges6_alloc == 0 ? 1024 : ranges6_alloc * 2;
+                    ranges6 = tr_renew(struct tr_ipv6_range, ranges6, ranges6_alloc);
+                }
+
+                ranges6[ranges6_count++] = range6;
             }
-            else if (keep->end < r->end)
+            else
             {
-                keep->end = r->end;
+                /* don't try to display the actual lines - it causes issues */
+                tr_logAddError(_("blocklist skipped invalid address at line %d"), inCount);
             }
+
+            is_overlong = false;
+            walk = eol + 1;
         }
 
-        ranges_count = keep + 1 - ranges;
+        buf_len = end - walk;
+
+        if (n == 0)
+        {
+            break;
+        }
+
+        if (buf_len == BLOCKLIST_READ_SIZE) /* no line is that long; skip it */
+        {
+            is_overlong = true;
+            buf_len = 0;
+        }
+        else
+        {
+            memmove(buf, walk, buf_len);
+        }
+    }
+
+    tr_free(buf);
+    sourceClose(&src);
+
+    /* sort and merge */
+    ranges_count = mergeIPv4Ranges(ranges, ranges_count);
+    ranges6_count = mergeIPv6Ranges(ranges6, ranges6_count);
 
 #ifdef TR_ENABLE_ASSERTS
 
-        /* sanity checks: make sure the rules are sorted in ascending order and don't overlap */
+    /* sanity checks: make sure the rules are sorted in ascending order and don't overlap */
+    {
+        for (size_t i = 0; i < ranges_count; ++i)
         {
-            for (size_t i = 0; i < ranges_count; ++i)
-            {
-                TR_ASSERT(ranges[i].begin <= ranges[i].end);
-            }
+            TR_ASSERT(ranges[i].begin <= ranges[i].end);
+        }
 
-            for (size_t i = 1; i < ranges_count; ++i)
-            {
-                TR_ASSERT(ranges[i - 1].end < ranges[i].begin);
-            }
+        for (size_t i = 1; i < ranges_count; ++i)
+        {
+            TR_ASSERT(ranges[i - 1].end < ranges[i].begin);
         }
 
-#endif
+        for (size_t i = 0; i < ranges6_count; ++i)
+        {
+            TR_ASSERT(!ipv6AddrIsLess(&ranges6[i].end, &ranges6[i].begin));
+        }
+
+        for (size_t i = 1; i < ranges6_count; ++i)
+        {
+            TR_ASSERT(ipv6AddrIsLess(&ranges6[i - 1].end, &ranges6[i].begin));
+        }
     }
 
-    if (!tr_sys_file_write(out, ranges, sizeof(struct tr_ipv4_range) * ranges_count, NULL, &error))
+#endif
+
+    memcpy(header.magic, BLOCKLIST_FILE_MAGIC, sizeof(header.magic));
+    header.version = BLOCKLIST_FILE_VERSION;
+    header.ipv4_count = ranges_count;
+    header.ipv6_count = ranges6_count;
+
+    if (!tr_sys_file_write(out, &header, sizeof(header), NULL, &error) ||
+        !tr_sys_file_write(out, ranges, sizeof(struct tr_ipv4_range) * ranges_count, NULL, &error) ||
+        !tr_sys_file_write(out, ranges6, sizeof(struct tr_ipv6_range) * ranges6_count, NULL, &error))
     {
         tr_logAddError(_("Couldn't save file \"%1$s\": %2$s"), b->filename, error->message);
         tr_error_free(error);
@@ -463,15 +975,267 @@ int tr_blocklistFileSetContent(tr_blocklistFile* b, char const* filename)
     else
     {
         char* base = tr_sys_path_basename(b->filename, NULL);
-        tr_logAddInfo(_("Blocklist \"%s\" updated with %zu entries"), base, ranges_count);
+        tr_logAddInfo(_("Blocklist \"%s\" updated with %zu entries"), base, ranges_count + ranges6_count);
         tr_free(base);
     }
 
+    tr_free(ranges6);
     tr_free(ranges);
     tr_sys_file_close(out, NULL);
-    tr_sys_file_close(in, NULL);
 
     blocklistLoad(b);
 
-    return ranges_count;
+    return ranges_count + ranges6_count;
+}
+
+/***
+****  The merged index.
+****
+****  Every lookup used to bsearch each blocklist file in turn. Instead,
+****  the ranges of all the files are merged into one sorted array per
+****  address family, laid out in Eytzinger (breadth-first) order: the
+****  first few levels of the search tree share a handful of cache lines,
+****  and each step down the tree is a branch-free index computation.
+***/
+
+struct tr_blocklistIndex
+{
+    /* 1-based, in Eytzinger order. The ranges don't overlap, so sorting
+     * by `begin' also sorts by `end' and we can search on the latter */
+    size_t ipv4Count;
+    uint32_t* ipv4Begins;
+    uint32_t* ipv4Ends;
+
+    size_t ipv6Count;
+    struct tr_ipv6_addr* ipv6Begins;
+    struct tr_ipv6_addr* ipv6Ends;
+};
+
+/* order[k] is the sorted position of the item that goes in slot k */
+static size_t eytzingerOrder(size_t* order, size_t n, size_t i, size_t k)
+{
+    if (k <= n)
+    {
+        i = eytzingerOrder(order, n, i, 2 * k);
+        order[k] = i++;
+        i = eytzingerOrder(order, n, i, 2 * k + 1);
+    }
+
+    return i;
+}
+
+/* A search that went right at every slot whose key is less than the
+ * needle ends past the last level. Undoing the trailing right turns
+ * and the left turn before them leaves the slot of the first key that
+ * isn't less than the needle, or 0 if there isn't one */
+static inline size_t eytzingerResolve(size_t k)
+{
+    while ((k & 1) != 0)
+    {
+        k >>= 1;
+    }
+
+    return k >> 1;
+}
+
+/* k-way merge of the files' sorted ranges, joining any that overlap */
+static size_t indexMergeIPv4(struct tr_blocklistFile** files, size_t n_files, struct tr_ipv4_range* out)
+{
+    size_t n = 0;
+    size_t* pos = tr_new0(size_t, n_files);
+
+    for (;;)
+    {
+        size_t which = 0;
+        struct tr_ipv4_range const* next = NULL;
+
+        for (size_t i = 0; i < n_files; ++i)
+        {
+            if (pos[i] < files[i]->ipv4Count && (next == NULL || files[i]->ipv4[pos[i]].begin < next->begin))
+            {
+                next = &files[i]->ipv4[pos[i]];
+                which = i;
+            }
+        }
+
+        if (next == NULL)
+        {
+            break;
+        }
+
+        ++pos[which];
+
+        if (n == 0 || out[n - 1].end < next->begin)
+        {
+            out[n++] = *next;
+        }
+        else if (out[n - 1].end < next->end)
+        {
+            out[n - 1].end = next->end;
+        }
+    }
+
+    tr_free(pos);
+    return n;
+}
+
+static size_t indexMergeIPv6(struct tr_blocklistFile** files, size_t n_files, struct tr_ipv6_range* out)
+{
+    size_t n = 0;
+    size_t* pos = tr_new0(size_t, n_files);
+
+    for (;;)
+    {
+        size_t which = 0;
+        struct tr_ipv6_range const* next = NULL;
+
+        for (size_t i = 0; i < n_files; ++i)
+        {
+            if (pos[i] < files[i]->ipv6Count &&
+                (next == NULL || ipv6AddrIsLess(&files[i]->ipv6[pos[i]].begin, &next->begin)))
+            {
+                next = &files[i]->ipv6[pos[i]];
+                which = i;
+            }
+        }
+
+        if (next == NULL)
+        {
+            break;
+        }
+
+        ++pos[which];
+
+        if (n == 0 || ipv6AddrIsLess(&out[n - 1].end, &next->begin))
+        {
+            out[n++] = *next;
+        }
+        else if (ipv6AddrIsLess(&out[n - 1].end, &next->end))
+        {
+            out[n - 1].end = next->end;
+        }
+    }
+
+    tr_free(pos);
+    return n;
+}
+
+tr_blocklistIndex* tr_blocklistIndexNew(tr_blocklistFile** files, size_t n_files)
+{
+    size_t n4 = 0;
+    size_t n6 = 0;
+    size_t* order;
+    struct tr_ipv4_range* ranges;
+    struct tr_ipv6_range* ranges6;
+    tr_blocklistIndex* index = tr_new0(tr_blocklistIndex, 1);
+
+    for (size_t i = 0; i < n_files; ++i)
+    {
+        blocklistEnsureLoaded(files[i]);
+        n4 += files[i]->ipv4Count;
+        n6 += files[i]->ipv6Count;
+    }
+
+    ranges = tr_new(struct tr_ipv4_range, n4);
+    ranges6 = tr_new(struct tr_ipv6_range, n6);
+    n4 = indexMergeIPv4(files, n_files, ranges);
+    n6 = indexMergeIPv6(files, n_files, ranges6);
+    order = tr_new(size_t, MAX(n4, n6) + 1);
+
+    index->ipv4Count = n4;
+    index->ipv4Begins = tr_new(uint32_t, n4 + 1);
+    index->ipv4Ends = tr_new(uint32_t, n4 + 1);
+    eytzingerOrder(order, n4, 0, 1);
+
+    for (size_t k = 1; k <= n4; ++k)
+    {
+        index->ipv4Begins[k] = ranges[order[k]].begin;
+        index->ipv4Ends[k] = ranges[order[k]].end;
+    }
+
+    index->ipv6Count = n6;
+    index->ipv6Begins = tr_new(struct tr_ipv6_addr, n6 + 1);
+    index->ipv6Ends = tr_new(struct tr_ipv6_addr, n6 + 1);
+    eytzingerOrder(order, n6, 0, 1);
+
+    for (size_t k = 1; k <= n6; ++k)
+    {
+        index->ipv6Begins[k] = ranges6[order[k]].begin;
+        index->ipv6Ends[k] = ranges6[order[k]].end;
+    }
+
+    tr_free(order);
+    tr_free(ranges6);
+    tr_free(ranges);
+    return index;
+}
+
+void tr_blocklistIndexFree(tr_blocklistIndex* index)
+{
+    if (index != NULL)
+    {
+        tr_free(index->ipv6Ends);
+        tr_free(index->ipv6Begins);
+        tr_free(index->ipv4Ends);
+        tr_free(index->ipv4Begins);
+        tr_free(index);
+    }
+}
+
+static bool indexHasIPv4(tr_blocklistIndex const* index, uint32_t needle)
+{
+    size_t k = 1;
+    size_t const n = index->ipv4Count;
+    uint32_t const* const ends = index->ipv4Ends;
+
+    while (k <= n)
+    {
+        k = 2 * k + (ends[k] < needle);
+    }
+
+    k = eytzingerResolve(k);
+
+    return k != 0 && index->ipv4Begins[k] <= needle;
+}
+
+static bool indexHasIPv6(tr_blocklistIndex const* index, struct tr_ipv6_addr const* needle)
+{
+    size_t k = 1;
+    size_t const n = index->ipv6Count;
+    struct tr_ipv6_addr const* const ends = index->ipv6Ends;
+
+    while (k <= n)
+    {
+        k = 2 * k + ipv6AddrIsLess(&ends[k], needle);
+    }
+
+    k = eytzingerResolve(k);
+
+    return k != 0 && !ipv6AddrIsLess(needle, &index->ipv6Begins[k]);
+}
+
+bool tr_blocklistIndexHasAddress(tr_blocklistIndex const* index, tr_address const* addr)
+{
+    TR_ASSERT(tr_address_is_valid(addr));
+
+    if (addr->type == TR_AF_INET)
+    {
+        return indexHasIPv4(index, ntohl(addr->addr.addr4.s_addr));
+    }
+    else
+    {
+        uint8_t const* const bytes = addr->addr.addr6.s6_addr;
+        static uint8_t const v4_mapped_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+        struct tr_ipv6_addr needle;
+
+        /* ::ffff:a.b.c.d is an IPv4 peer reached over an IPv6 socket */
+        if (memcmp(bytes, v4_mapped_prefix, sizeof(v4_mapped_prefix)) == 0)
+        {
+            return indexHasIPv4(index, (uint32_t)bytes[12] << 24 | (uint32_t)bytes[13] << 16 |
+                (uint32_t)bytes[14] << 8 | bytes[15]);
+        }
+
+        needle = ipv6AddrFromBytes(bytes);
+        return indexHasIPv6(index, &needle);
+    }
 }
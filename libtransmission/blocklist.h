@@ -16,6 +16,8 @@ struct tr_address;
 
 typedef struct tr_blocklistFile tr_blocklistFile;
 
+typedef struct tr_blocklistIndex tr_blocklistIndex;
+
 tr_blocklistFile* tr_blocklistFileNew(char const* filename, bool isEnabled);
 
 bool tr_blocklistFileExists(tr_blocklistFile const* b);
@@ -30,6 +32,11 @@ bool tr_blocklistFileIsEnabled(tr_blocklistFile* b);
 
 void tr_blocklistFileSetEnabled(tr_blocklistFile* b, bool isEnabled);
 
-bool tr_blocklistFileHasAddress(tr_blocklistFile* b, struct tr_address const* addr);
-
 int tr_blocklistFileSetContent(tr_blocklistFile* b, char const* filename);
+
+/* the ranges of all `files', merged for fast lookups */
+tr_blocklistIndex* tr_blocklistIndexNew(tr_blocklistFile** files, size_t n_files);
+
+void tr_blocklistIndexFree(tr_blocklistIndex* index);
+
+bool tr_blocklistIndexHasAddress(tr_blocklistIndex const* index, struct tr_address const* addr);
@@ -0,0 +1,250 @@
+/*
+ * This file Copyright (C) 2017 Mnemosyne LLC
+ *
+ * It may be used under the GNU GPL versions 2 or 3
+ * or any future license endorsed by Mnemosyne LLC.
+ *
+ */
+
+#include "transmission.h"
+#include "bitfield.h"
+#include "completion.h"
+#include "torrent.h"
+
+#include "libtransmission-test.h"
+
+/***
+****
+***/
+
+/* count a file's bytes the slow way, one block at a time */
+static uint64_t countFileBytes(tr_torrent const* tor, tr_file_index_t index)
+{
+    uint64_t total = 0;
+    tr_file const* file = &tor->info.files[index];
+
+    for (tr_block_index_t b = 0; b < tor->blockCount; ++b)
+    {
+        uint64_t const begin = (uint64_t)b * tor->blockSize;
+        uint64_t const end = begin + tr_torBlockCountBytes(tor, b);
+
+        if (tr_torrentBlockIsComplete(tor, b))
+        {
+            uint64_t const lo = MAX(begin, file->offset);
+            uint64_t const hi = MIN(end, file->offset + file->length);
+
+            if (lo < hi)
+            {
+                total += hi - lo;
+            }
+        }
+    }
+
+    return total;
+}
+
+/* recompute the totals the slow way, one piece at a time */
+static int check_totals(tr_torrent const* tor)
+{
+    uint64_t haveValid = 0;
+    uint64_t sizeWhenDone = 0;
+
+    for (tr_piece_index_t p = 0; p < tor->info.pieceCount; ++p)
+    {
+        uint64_t have = 0;
+        tr_block_index_t f;
+        tr_block_index_t l;
+        tr_torGetPieceBlockRange(tor, p, &f, &l);
+
+        for (tr_block_index_t b = f; b <= l; ++b)
+        {
+            if (tr_torrentBlockIsComplete(tor, b))
+            {
+                have += tr_torBlockCountBytes(tor, b);
+            }
+        }
+
+        if (have == tr_torPieceCountBytes(tor, p))
+        {
+            haveValid += have;
+        }
+
+        sizeWhenDone += tor->info.pieceDND[p] ? have : tr_torPieceCountBytes(tor, p);
+    }
+
+    check_uint(tr_cpHaveValid(&tor->completion), ==, haveValid);
+    check_uint(tr_cpSizeWhenDone(&tor->completion), ==, sizeWhenDone);
+    check_uint(tr_cpLeftUntilDone(&tor->completion), ==, sizeWhenDone - tr_cpHaveTotal(&tor->completion));
+    return 0;
+}
+
+static int check_file_bytes(tr_torrent const* tor)
+{
+    tr_file_index_t n;
+    tr_file_stat* files = tr_torrentFiles(tor, &n);
+
+    check_uint(n, ==, tor->info.fileCount);
+
+    for (tr_file_index_t i = 0; i < n; ++i)
+    {
+        uint64_t const expected = countFileBytes(tor, i);
+
+        check_uint(files[i].bytesCompleted, ==, expected);
+        check_bool(tr_cpFileIsComplete(&tor->completion, i), ==, expected == tor->info.files[i].length);
+    }
+
+    tr_torrentFilesFree(files, n);
+    return 0;
+}
+
+static int test_file_bytes(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_bitfield blocks;
+
+    session = libttest_session_init(NULL);
+    tor = libttest_zero_torrent_init(session);
+    libttest_zero_torrent_populate(tor, true);
+    check_int(tor->info.fileCount, ==, 3);
+    check_int(tor->completeness, ==, TR_SEED);
+    check_int(check_file_bytes(tor), ==, 0);
+
+    /* the last piece holds the tail of the first file and all of the other two,
+       and its last block is shared between the second and third files */
+    for (tr_piece_index_t p = tor->info.pieceCount; p-- > 0;)
+    {
+        tr_torrentSetHasPiece(tor, p, false);
+        check_int(check_file_bytes(tor), ==, 0);
+    }
+
+    check_uint(tr_cpHaveTotal(&tor->completion), ==, 0);
+
+    /* add the blocks back out of order */
+    for (tr_block_index_t b = tor->blockCount; b-- > 0;)
+    {
+        if (b % 2 == 0)
+        {
+            tr_cpBlockAdd(&tor->completion, b);
+            check_int(check_file_bytes(tor), ==, 0);
+        }
+    }
+
+    for (tr_block_index_t b = 0; b < tor->blockCount; ++b)
+    {
+        tr_cpBlockAdd(&tor->completion, b);
+        check_int(check_file_bytes(tor), ==, 0);
+    }
+
+    check_uint(tr_cpHaveTotal(&tor->completion), ==, tor->info.totalSize);
+
+    /* rebuilding from a bitfield, as when loading .resume files, gives the same answers */
+    tr_bitfieldConstruct(&blocks, tor->blockCount);
+
+    for (tr_block_index_t b = 0; b < tor->blockCount; ++b)
+    {
+        if ((tor->blockCount - b) % 3 == 1)
+        {
+            tr_bitfieldAdd(&blocks, b);
+        }
+    }
+
+    tr_cpBlockInit(&tor->completion, &blocks);
+    check_int(check_file_bytes(tor), ==, 0);
+    check_int(check_totals(tor), ==, 0);
+    tr_bitfieldSetHasAll(&blocks);
+    tr_cpBlockInit(&tor->completion, &blocks);
+    check_int(check_file_bytes(tor), ==, 0);
+    check_int(check_totals(tor), ==, 0);
+    tr_bitfieldDestruct(&blocks);
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****
+***/
+
+static int test_totals(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_file_index_t file;
+    tr_block_index_t f;
+    tr_block_index_t l;
+
+    session = libttest_session_init(NULL);
+    tor = libttest_zero_torrent_init(session);
+    libttest_zero_torrent_populate(tor, false);
+    check_int(check_totals(tor), ==, 0);
+    check_uint(tr_cpLeftUntilDone(&tor->completion), ==, tor->info.pieceSize);
+
+    /* skip the two small files, which share the last piece with the big one */
+    file = 1;
+    tr_torrentSetFileDLs(tor, &file, 1, false);
+    check_int(check_totals(tor), ==, 0);
+    check(tor->info.pieceDND[tor->info.pieceCount - 1] == false);
+    file = 2;
+    tr_torrentSetFileDLs(tor, &file, 1, false);
+    check_int(check_totals(tor), ==, 0);
+
+    /* skip the big one too, so that every piece is DND */
+    file = 0;
+    tr_torrentSetFileDLs(tor, &file, 1, false);
+    check_int(check_totals(tor), ==, 0);
+    check_uint(tr_cpLeftUntilDone(&tor->completion), ==, 0);
+
+    /* lose some DND pieces, then get them back a block at a time */
+    tr_torrentSetHasPiece(tor, 1, false);
+    tr_torrentSetHasPiece(tor, tor->info.pieceCount - 1, false);
+    check_int(check_totals(tor), ==, 0);
+
+    tr_torGetPieceBlockRange(tor, tor->info.pieceCount - 1, &f, &l);
+
+    for (tr_block_index_t b = f; b <= l; ++b)
+    {
+        tr_cpBlockAdd(&tor->completion, b);
+        check_int(check_totals(tor), ==, 0);
+    }
+
+    /* want everything again */
+    for (file = 0; file < tor->info.fileCount; ++file)
+    {
+        tr_torrentSetFileDLs(tor, &file, 1, true);
+        check_int(check_totals(tor), ==, 0);
+    }
+
+    tr_torGetPieceBlockRange(tor, 1, &f, &l);
+
+    for (tr_block_index_t b = l + 1; b-- > f;)
+    {
+        tr_cpBlockAdd(&tor->completion, b);
+        check_int(check_totals(tor), ==, 0);
+    }
+
+    tr_torrentSetHasPiece(tor, 0, true);
+    check_int(check_totals(tor), ==, 0);
+    check_uint(tr_cpHaveValid(&tor->completion), ==, tor->info.totalSize);
+    check_uint(tr_cpLeftUntilDone(&tor->completion), ==, 0);
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****
+***/
+
+int main(void)
+{
+    testFunc const tests[] =
+    {
+        test_file_bytes,
+        test_totals
+    };
+
+    return runTests(tests, NUM_TESTS(tests));
+}
@@ -6,8 +6,12 @@
  *
  */
 
+#include <string.h> /* memset() */
+
 #include "transmission.h"
 #include "completion.h"
+#include "inout.h" /* tr_ioFindFileLocation() */
+#include "peer-mgr.h" /* tr_peerMgrUpdateDesiredAvailable() */
 #include "torrent.h"
 #include "tr-assert.h"
 #include "utils.h"
@@ -16,21 +20,142 @@
 ****
 ***/
 
+/* recount the running totals that depend on both the blocks and the pieces' DND flags */
+static void tr_cpRecount(tr_completion* cp)
+{
+    tr_torrent const* tor = cp->tor;
+
+    cp->sizeWhenDone = 0;
+    cp->haveValid = 0;
+
+    for (tr_piece_index_t p = 0; p < tor->info.pieceCount; ++p)
+    {
+        uint64_t const pieceSize = tr_torPieceCountBytes(tor, p);
+        uint64_t const missing = tr_cpMissingBytesInPiece(cp, p);
+
+        cp->sizeWhenDone += tor->info.pieceDND[p] ? pieceSize - missing : pieceSize;
+
+        if (missing == 0)
+        {
+            cp->haveValid += pieceSize;
+        }
+    }
+
+    TR_ASSERT(cp->sizeWhenDone <= tor->info.totalSize);
+    TR_ASSERT(cp->haveValid <= tor->info.totalSize);
+
+    tr_peerMgrRecountDesiredAvailable(cp->tor);
+    tr_torrentSetStatDirty(cp->tor, TR_STAT_DIRTY_PROGRESS);
+}
+
 static void tr_cpReset(tr_completion* cp)
 {
     cp->sizeNow = 0;
-    cp->sizeWhenDoneIsDirty = true;
-    cp->haveValidIsDirty = true;
     tr_bitfieldSetHasNone(&cp->blockBitfield);
+
+    if (cp->fileBytes != NULL)
+    {
+        memset(cp->fileBytes, 0, sizeof(uint64_t) * cp->tor->info.fileCount);
+    }
+
+    tr_cpRecount(cp);
 }
 
 void tr_cpConstruct(tr_completion* cp, tr_torrent* tor)
 {
     cp->tor = tor;
     tr_bitfieldConstruct(&cp->blockBitfield, tor->blockCount);
+
+    /* this is called again when a magnet link gets its metainfo */
+    tr_free(cp->fileBytes);
+    cp->fileBytes = tr_new0(uint64_t, tor->info.fileCount);
+
     tr_cpReset(cp);
 }
 
+static uint64_t countFileBytes(tr_completion const* cp, tr_file_index_t index)
+{
+    uint64_t total = 0;
+    tr_torrent const* tor = cp->tor;
+    tr_file const* f = &tor->info.files[index];
+
+    if (f->length != 0)
+    {
+        tr_block_index_t first;
+        tr_block_index_t last;
+        tr_torGetFileBlockRange(tor, index, &first, &last);
+
+        if (first == last)
+        {
+            if (tr_cpBlockIsComplete(cp, first))
+            {
+                total = f->length;
+            }
+        }
+        else
+        {
+            /* the first block */
+            if (tr_cpBlockIsComplete(cp, first))
+            {
+                total += tor->blockSize - f->offset % tor->blockSize;
+            }
+
+            /* the middle blocks */
+            if (first + 1 < last)
+            {
+                uint64_t u = tr_bitfieldCountRange(&cp->blockBitfield, first + 1, last);
+                u *= tor->blockSize;
+                total += u;
+            }
+
+            /* the last block */
+            if (tr_cpBlockIsComplete(cp, last))
+            {
+                total += f->offset + f->length - (uint64_t)tor->blockSize * last;
+            }
+        }
+    }
+
+    return total;
+}
+
+/* credit (or debit) every file that overlaps this block with its share of the block */
+static void fileBytesUpdate(tr_completion* cp, tr_block_index_t block, bool add)
+{
+    tr_torrent const* tor = cp->tor;
+    tr_piece_index_t const piece = tr_torBlockPiece(tor, block);
+    uint64_t const pieceBegin = (uint64_t)piece * tor->info.pieceSize;
+    uint64_t begin = (uint64_t)block * tor->blockSize;
+    uint64_t const end = begin + tr_torBlockCountBytes(tor, block);
+    tr_file_index_t i;
+    uint64_t fileOffset;
+
+    tr_ioFindFileLocation(tor, piece, begin - pieceBegin, &i, &fileOffset);
+
+    while (begin < end)
+    {
+        tr_file const* file = &tor->info.files[i++];
+        uint64_t const fileEnd = file->offset + file->length;
+
+        if (begin < fileEnd)
+        {
+            uint64_t const n = MIN(end, fileEnd) - begin;
+
+            if (add)
+            {
+                cp->fileBytes[i - 1] += n;
+            }
+            else
+            {
+                cp->fileBytes[i - 1] -= n;
+            }
+
+            TR_ASSERT(cp->fileBytes[i - 1] <= file->length);
+            begin += n;
+        }
+    }
+}
+
 void tr_cpBlockInit(tr_completion* cp, tr_bitfield const* b)
 {
     tr_cpReset(cp);
@@ -49,6 +174,15 @@ void tr_cpBlockInit(tr_completion* cp, tr_bitfield const* b)
     }
 
     TR_ASSERT(cp->sizeNow <= cp->tor->info.totalSize);
+
+    /* set fileBytes */
+    for (tr_file_index_t i = 0; i < cp->tor->info.fileCount; ++i)
+    {
+        cp->fileBytes[i] = countFileBytes(cp, i);
+    }
+
+    /* set sizeWhenDone and haveValid */
+    tr_cpRecount(cp);
 }
 
 /***
@@ -79,21 +213,38 @@ void tr_cpPieceRem(tr_completion* cp, tr_piece_index_t piece)
 {
     tr_block_index_t f;
     tr_block_index_t l;
+    uint64_t removed = 0;
     tr_torrent const* tor = cp->tor;
 
     tr_torGetPieceBlockRange(cp->tor, piece, &f, &l);
 
+    if (tr_cpPieceIsComplete(cp, piece))
+    {
+        cp->haveValid -= tr_torPieceCountBytes(tor, piece);
+    }
+
     for (tr_block_index_t i = f; i <= l; ++i)
     {
         if (tr_cpBlockIsComplete(cp, i))
         {
-            cp->sizeNow -= tr_torBlockCountBytes(tor, i);
+            removed += tr_torBlockCountBytes(tor, i);
+            fileBytesUpdate(cp, i, false);
         }
     }
 
-    cp->haveValidIsDirty = true;
-    cp->sizeWhenDoneIsDirty = true;
+    cp->sizeNow -= removed;
+
+    if (tor->info.pieceDND[piece])
+    {
+        cp->sizeWhenDone -= removed;
+    }
+    else
+    {
+        tr_peerMgrUpdateDesiredAvailable(cp->tor, piece, removed);
+    }
+
     tr_bitfieldRemRange(&cp->blockBitfield, f, l + 1);
+    tr_torrentSetStatDirty(cp->tor, TR_STAT_DIRTY_PROGRESS);
 }
 
 void tr_cpPieceAdd(tr_completion* cp, tr_piece_index_t piece)
@@ -116,103 +267,64 @@ void tr_cpBlockAdd(tr_completion* cp, tr_block_index_t block)
     {
         tr_piece_index_t const piece = tr_torBlockPiece(cp->tor, block);
 
-        tr_bitfieldAdd(&cp->blockBitfield, block);
-        cp->sizeNow += tr_torBlockCountBytes(tor, block);
-
-        cp->haveValidIsDirty = true;
-        cp->sizeWhenDoneIsDirty = cp->sizeWhenDoneIsDirty || tor->info.pieces[piece].dnd;
-    }
-}
+        uint32_t const n = tr_torBlockCountBytes(tor, block);
 
-/***
-****
-***/
+        tr_bitfieldAdd(&cp->blockBitfield, block);
+        cp->sizeNow += n;
+        fileBytesUpdate(cp, block, true);
 
-uint64_t tr_cpHaveValid(tr_completion const* ccp)
-{
-    if (ccp->haveValidIsDirty)
-    {
-        uint64_t size = 0;
-        tr_completion* cp = (tr_completion*)ccp; /* mutable */
-        tr_torrent const* tor = ccp->tor;
-        tr_info const* info = &tor->info;
+        if (tor->info.pieceDND[piece])
+        {
+            cp->sizeWhenDone += n;
+        }
+        else
+        {
+            tr_peerMgrUpdateDesiredAvailable(cp->tor, piece, -(int64_t)n);
+        }
 
-        for (tr_piece_index_t i = 0; i < info->pieceCount; ++i)
+        if (tr_cpPieceIsComplete(cp, piece))
         {
-            if (tr_cpPieceIsComplete(ccp, i))
-            {
-                size += tr_torPieceCountBytes(tor, i);
-            }
+            cp->haveValid += tr_torPieceCountBytes(tor, piece);
         }
 
-        cp->haveValidLazy = size;
-        cp->haveValidIsDirty = false;
+        tr_torrentSetStatDirty(cp->tor, TR_STAT_DIRTY_PROGRESS);
     }
-
-    return ccp->haveValidLazy;
 }
 
-uint64_t tr_cpSizeWhenDone(tr_completion const* ccp)
+void tr_cpSetPieceDND(tr_completion* cp, tr_piece_index_t piece, bool dnd)
 {
-    if (ccp->sizeWhenDoneIsDirty)
+    bool* pieceDND = &cp->tor->info.pieceDND[piece];
+
+    if (*pieceDND != dnd)
     {
-        uint64_t size = 0;
-        tr_torrent const* tor = ccp->tor;
-        tr_info const* inf = tr_torrentInfo(tor);
-        tr_completion* cp = (tr_completion*)ccp; /* mutable */
+        uint64_t const missing = tr_cpMissingBytesInPiece(cp, piece);
 
-        if (tr_cpHasAll(ccp))
+        if (dnd)
         {
-            size = inf->totalSize;
+            cp->sizeWhenDone -= missing;
+            tr_peerMgrUpdateDesiredAvailable(cp->tor, piece, -(int64_t)missing);
         }
         else
         {
-            for (tr_piece_index_t p = 0; p < inf->pieceCount; ++p)
-            {
-                uint64_t n = 0;
-                uint64_t const pieceSize = tr_torPieceCountBytes(tor, p);
-
-                if (!inf->pieces[p].dnd)
-                {
-                    n = pieceSize;
-                }
-                else
-                {
-                    tr_block_index_t f;
-                    tr_block_index_t l;
-                    tr_torGetPieceBlockRange(cp->tor, p, &f, &l);
-
-                    n = tr_bitfieldCountRange(&cp->blockBitfield, f, l + 1);
-                    n *= cp->tor->blockSize;
-
-                    if (l == cp->tor->blockCount - 1 && tr_bitfieldHas(&cp->blockBitfield, l))
-                    {
-                        n -= cp->tor->blockSize - cp->tor->lastBlockSize;
-                    }
-                }
-
-                TR_ASSERT(n <= tr_torPieceCountBytes(tor, p));
-                size += n;
-            }
+            cp->sizeWhenDone += missing;
+            tr_peerMgrUpdateDesiredAvailable(cp->tor, piece, missing);
         }
 
-        TR_ASSERT(size <= inf->totalSize);
-        TR_ASSERT(size >= cp->sizeNow);
-
-        cp->sizeWhenDoneLazy = size;
-        cp->sizeWhenDoneIsDirty = false;
+        *pieceDND = dnd;
+        tr_torrentSetStatDirty(cp->tor, TR_STAT_DIRTY_PROGRESS);
     }
-
-    return ccp->sizeWhenDoneLazy;
 }
 
+/***
+****
+***/
+
 uint64_t tr_cpLeftUntilDone(tr_completion const* cp)
 {
-    uint64_t const sizeWhenDone = tr_cpSizeWhenDone(cp);
-
-    TR_ASSERT(sizeWhenDone >= cp->sizeNow);
+    TR_ASSERT(cp->sizeWhenDone >= cp->sizeNow);
+    TR_ASSERT(cp->sizeWhenDone <= cp->tor->info.totalSize);
 
-    return sizeWhenDone - cp->sizeNow;
+    return cp->sizeWhenDone - cp->sizeNow;
 }
 
 void tr_cpGetAmountDone(tr_completion const* cp, float* tab, int tabCount)
@@ -287,17 +399,7 @@ size_t tr_cpMissingBytesInPiece(tr_completion const* cp, tr_piece_index_t piece)
 
 bool tr_cpFileIsComplete(tr_completion const* cp, tr_file_index_t i)
 {
-    if (cp->tor->info.files[i].length == 0)
-    {
-        return true;
-    }
-    else
-    {
-        tr_block_index_t f;
-        tr_block_index_t l;
-        tr_torGetFileBlockRange(cp->tor, i, &f, &l);
-        return tr_bitfieldCountRange(&cp->blockBitfield, f, l + 1) == (l + 1 - f);
-    }
+    return cp->fileBytes[i] == cp->tor->info.files[i].length;
 }
 
 void* tr_cpCreatePieceBitfield(tr_completion const* cp, size_t* byte_count)
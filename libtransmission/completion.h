@@ -23,23 +23,19 @@ typedef struct tr_completion
     tr_bitfield blockBitfield;
 
     /* number of bytes we'll have when done downloading. [0..info.totalSize]
-       DON'T access this directly; it's a lazy field.
-       use tr_cpSizeWhenDone() instead! */
-    uint64_t sizeWhenDoneLazy;
+       this is every wanted piece, plus what we have of the DND ones */
+    uint64_t sizeWhenDone;
 
-    /* whether or not sizeWhenDone needs to be recalculated */
-    bool sizeWhenDoneIsDirty;
-
-    /* number of bytes we'll have when done downloading. [0..info.totalSize]
-       DON'T access this directly; it's a lazy field.
-       use tr_cpHaveValid() instead! */
-    uint64_t haveValidLazy;
-
-    /* whether or not haveValidLazy needs to be recalculated */
-    bool haveValidIsDirty;
+    /* number of bytes in the pieces we have. [0..info.totalSize] */
+    uint64_t haveValid;
 
     /* number of bytes we want or have now. [0..sizeWhenDone] */
     uint64_t sizeNow;
+
+    /* number of bytes we have in each file. [0..files[i].length]
+       kept current as blocks are added and pieces are removed,
+       so that tr_torrentFiles() doesn't need to scan blockBitfield */
+    uint64_t* fileBytes;
 }
 tr_completion;
 
@@ -54,6 +50,7 @@ void tr_cpBlockInit(tr_completion* cp, tr_bitfield const* blocks);
 static inline void tr_cpDestruct(tr_completion* cp)
 {
     tr_bitfieldDestruct(&cp->blockBitfield);
+    tr_free(cp->fileBytes);
 }
 
 /**
@@ -66,10 +63,6 @@ double tr_cpPercentDone(tr_completion const* cp);
 
 tr_completeness tr_cpGetStatus(tr_completion const*);
 
-uint64_t tr_cpHaveValid(tr_completion const*);
-
-uint64_t tr_cpSizeWhenDone(tr_completion const*);
-
 uint64_t tr_cpLeftUntilDone(tr_completion const*);
 
 void tr_cpGetAmountDone(tr_completion const* completion, float* tab, int tabCount);
@@ -79,6 +72,16 @@ static inline uint64_t tr_cpHaveTotal(tr_completion const* cp)
     return cp->sizeNow;
 }
 
+static inline uint64_t tr_cpHaveValid(tr_completion const* cp)
+{
+    return cp->haveValid;
+}
+
+static inline uint64_t tr_cpSizeWhenDone(tr_completion const* cp)
+{
+    return cp->sizeWhenDone;
+}
+
 static inline bool tr_cpHasAll(tr_completion const* cp)
 {
     return tr_torrentHasMetadata(cp->tor) && tr_bitfieldHasAll(&cp->blockBitfield);
@@ -97,6 +100,9 @@ void tr_cpPieceAdd(tr_completion* cp, tr_piece_index_t i);
 
 void tr_cpPieceRem(tr_completion* cp, tr_piece_index_t i);
 
+/* sets the piece's DND flag, keeping sizeWhenDone in step */
+void tr_cpSetPieceDND(tr_completion* cp, tr_piece_index_t i, bool dnd);
+
 size_t tr_cpMissingBlocksInPiece(tr_completion const*, tr_piece_index_t);
 
 size_t tr_cpMissingBytesInPiece(tr_completion const*, tr_piece_index_t);
@@ -123,9 +129,9 @@ static inline bool tr_cpBlockIsComplete(tr_completion const* cp, tr_block_index_
 
 bool tr_cpFileIsComplete(tr_completion const* cp, tr_file_index_t);
 
-void* tr_cpCreatePieceBitfield(tr_completion const* cp, size_t* byte_count);
-
-static inline void tr_cpInvalidateDND(tr_completion* cp)
+static inline uint64_t tr_cpFileBytesCompleted(tr_completion const* cp, tr_file_index_t i)
 {
-    cp->sizeWhenDoneIsDirty = true;
+    return cp->fileBytes[i];
 }
+
+void* tr_cpCreatePieceBitfield(tr_completion const* cp, size_t* byte_count);
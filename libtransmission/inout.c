@@ -172,7 +172,12 @@ void tr_ioFindFileLocation(tr_torrent const* tor, tr_piece_index_t pieceIndex, u
 
     TR_ASSERT(offset < tor->info.totalSize);
 
-    tr_file const* file = bsearch(&offset, tor->info.files, tor->info.fileCount, sizeof(tr_file), compareOffsetToFile);
+    /* only search the files that overlap this piece */
+    tr_file_index_t first;
+    tr_file_index_t last;
+    tr_torGetPieceFileRange(tor, pieceIndex, &first, &last);
+
+    tr_file const* file = bsearch(&offset, tor->info.files + first, last + 1 - first, sizeof(tr_file), compareOffsetToFile);
 
     TR_ASSERT(file != NULL);
 
@@ -287,5 +292,5 @@ bool tr_ioTestPiece(tr_torrent* tor, tr_piece_index_t piece)
 {
     uint8_t hash[SHA_DIGEST_LENGTH];
 
-    return recalculateHash(tor, piece, hash) && memcmp(hash, tor->info.pieces[piece].hash, SHA_DIGEST_LENGTH) == 0;
+    return recalculateHash(tor, piece, hash) && memcmp(hash, tor->info.pieceHashes[piece], SHA_DIGEST_LENGTH) == 0;
 }
@@ -240,6 +240,54 @@ static int test_unescape(void)
     return 0;
 }
 
+static int test_numbers(void)
+{
+    tr_variant top;
+    char* json;
+    size_t len;
+    double d;
+    int64_t i;
+
+    tr_variantInitDict(&top, 0);
+    tr_variantDictAddReal(&top, tr_quark_new("a", 1), 0.5);
+    tr_variantDictAddReal(&top, tr_quark_new("b", 1), -2.25);
+    tr_variantDictAddReal(&top, tr_quark_new("c", 1), 403650.656250);
+    tr_variantDictAddReal(&top, tr_quark_new("d", 1), 0.1234);
+    tr_variantDictAddReal(&top, tr_quark_new("e", 1), 3.0);
+    tr_variantDictAddInt(&top, tr_quark_new("f", 1), INT64_MIN);
+    tr_variantDictAddStr(&top, tr_quark_new("g", 1), "plain ascii, then tab\t quote\" backslash\\ ctrl\001 del\177 \xc3\xa9");
+
+    /* numbers are written with a '.' no matter what the locale is */
+    json = tr_variantToStr(&top, TR_VARIANT_FMT_JSON_LEAN, &len);
+    check_str(json, ==, "{\"a\":0.5000,\"b\":-2.2500,\"c\":403650.6562,\"d\":0.1234,\"e\":3,\"f\":-9223372036854775808,"
+        "\"g\":\"plain ascii, then tab\\t quote\\\" backslash\\\\ ctrl\\u0001 del\\u007f \\u00e9\"}\n");
+    tr_variantFree(&top);
+
+    /* ...and read back the same way */
+    check_int(tr_variantFromJson(&top, json, len), ==, 0);
+    check(tr_variantDictFindReal(&top, tr_quark_new("c", 1), &d));
+    check_int((int64_t)(d * 10000), ==, 4036506562);
+    check(tr_variantDictFindInt(&top, tr_quark_new("f", 1), &i));
+    check_int(i, ==, INT64_MIN);
+    tr_variantFree(&top);
+    tr_free(json);
+
+    char const* in = "[1e3, -0.125, 2.5E-3, 12345678901234567890.5, \"6.75\", \"6,75\"]";
+    double const expected[] = { 1e3, -0.125, 2.5E-3, 12345678901234567890.5, 6.75 };
+    check_int(tr_variantFromJson(&top, in, strlen(in)), ==, 0);
+
+    for (size_t n = 0; n < TR_N_ELEMENTS(expected); ++n)
+    {
+        check(tr_variantGetReal(tr_variantListChild(&top, n), &d));
+        check_mem(&d, ==, &expected[n], sizeof(d));
+    }
+
+    check(!tr_variantGetReal(tr_variantListChild(&top, 5), &d));
+    tr_variantFree(&top);
+
+    return 0;
+}
+
 int main(void)
 {
     char const* comma_locales[] =
@@ -256,7 +304,8 @@ int main(void)
         test1,
         test2,
         test3,
-        test_unescape
+        test_unescape,
+        test_numbers
     };
 
     /* run the tests in a locale with a decimal point of '.' */
@@ -17,6 +17,7 @@
 #include "metainfo.h"
 #include "platform.h" /* tr_getTorrentDir() */
 #include "session.h"
+#include "strpool.h"
 #include "tr-assert.h"
 #include "utils.h"
 #include "variant.h"
@@ -163,7 +164,7 @@ char* tr_metainfo_sanitize_path_component(char const* str, size_t len, bool* is_
     return ret;
 }
 
-static bool getfile(char** setme, bool* is_adjusted, char const* root, tr_variant* path, struct evbuffer* buf)
+static bool getfile(char const** setme, bool* is_adjusted, char const* root, tr_variant* path, struct evbuffer* buf)
 {
     bool success = false;
     size_t root_len = 0;
@@ -215,12 +216,15 @@ static bool getfile(char** setme, bool* is_adjusted, char const* root, tr_varian
         char const* const buf_data = (char*)evbuffer_pullup(buf, -1);
         size_t const buf_len = evbuffer_get_length(buf);
 
-        *setme = tr_utf8clean(buf_data, buf_len);
+        char* name = tr_utf8clean(buf_data, buf_len);
 
         if (!*is_adjusted)
         {
-            *is_adjusted = buf_len != strlen(*setme) || strncmp(buf_data, *setme, buf_len) != 0;
+            *is_adjusted = buf_len != strlen(name) || strncmp(buf_data, name, buf_len) != 0;
         }
+
+        *setme = tr_strpoolAcquire(name, TR_BAD_SIZE);
+        tr_free(name);
     }
 
     return success;
@@ -299,7 +303,7 @@ static char const* parseFiles(tr_info* inf, tr_variant* files, tr_variant const*
         inf->isFolder = false;
         inf->fileCount = 1;
         inf->files = tr_new0(tr_file, 1);
-        inf->files[0].name = tr_strdup(root_name);
+        inf->files[0].name = tr_strpoolAcquire(root_name, TR_BAD_SIZE);
         inf->files[0].length = len;
         inf->files[0].is_renamed = is_root_adjusted;
         inf->totalSize += len;
@@ -704,12 +708,10 @@ static char const* tr_metainfoParseImpl(tr_session const* session, tr_info* inf,
         }
 
         inf->pieceCount = len / SHA_DIGEST_LENGTH;
-        inf->pieces = tr_new0(tr_piece, inf->pieceCount);
-
-        for (tr_piece_index_t i = 0; i < inf->pieceCount; i++)
-        {
-            memcpy(inf->pieces[i].hash, &raw[i * SHA_DIGEST_LENGTH], SHA_DIGEST_LENGTH);
-        }
+        inf->pieceHashes = (tr_piece_hash const*)tr_strpoolAcquire((char const*)raw, len);
+        inf->pieceTimeChecked = tr_new0(time_t, inf->pieceCount);
+        inf->piecePriority = tr_new0(tr_priority_t, inf->pieceCount);
+        inf->pieceDND = tr_new0(bool, inf->pieceCount);
     }
 
     /* files */
@@ -772,11 +774,14 @@ void tr_metainfoFree(tr_info* inf)
 
     for (tr_file_index_t ff = 0; ff < inf->fileCount; ff++)
     {
-        tr_free(inf->files[ff].name);
+        tr_strpoolRelease(inf->files[ff].name);
     }
 
     tr_free(inf->webseeds);
-    tr_free(inf->pieces);
+    tr_strpoolRelease((char const*)inf->pieceHashes);
+    tr_free(inf->pieceTimeChecked);
+    tr_free(inf->piecePriority);
+    tr_free(inf->pieceDND);
     tr_free(inf->files);
     tr_free(inf->comment);
     tr_free(inf->creator);
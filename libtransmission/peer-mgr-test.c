@@ -0,0 +1,433 @@
+/*
+ * This file Copyright (C) 2017 Mnemosyne LLC
+ *
+ * It may be used under the GNU GPL versions 2 or 3
+ * or any future license endorsed by Mnemosyne LLC.
+ *
+ */
+
+/* the swarm's bookkeeping is private to peer-mgr.c, so test it from the inside */
+#include "peer-mgr.c"
+
+#include "libtransmission-test.h"
+
+/***
+****  Fake peers that are only added to, and removed from, the swarm
+***/
+
+static void testPeerDestruct(tr_peer* peer)
+{
+    tr_peerDestruct(peer);
+}
+
+static bool testPeerIsTransferringPieces(tr_peer const* peer UNUSED, uint64_t now UNUSED, tr_direction direction UNUSED,
+    unsigned int* setme_Bps)
+{
+    if (setme_Bps != NULL)
+    {
+        *setme_Bps = 0;
+    }
+
+    return false;
+}
+
+static struct tr_peer_virtual_funcs const testPeerFuncs =
+{
+    .destruct = testPeerDestruct,
+    .is_transferring_pieces = testPeerIsTransferringPieces
+};
+
+static tr_peer* addTestPeer(tr_swarm* s, int n)
+{
+    tr_address addr;
+    tr_peer* peer = tr_new0(tr_peer, 1);
+
+    /* 10.0.0.1, 10.0.0.2, ... */
+    addr.type = TR_AF_INET;
+    addr.addr.addr4.s_addr = htonl(0x0a000001 + n);
+    ensureAtomExists(s, &addr, 51413, 0, -1, TR_PEER_FROM_PEX);
+
+    tr_peerConstruct(peer, s->tor);
+    peer->funcs = &testPeerFuncs;
+    addPeer(s, peer, getExistingAtom(s, &addr));
+    return peer;
+}
+
+static void firePeerEvent(tr_swarm* s, tr_peer* peer, PeerEventType type, tr_piece_index_t piece)
+{
+    tr_peer_event e = TR_PEER_EVENT_INIT;
+
+    e.eventType = type;
+    e.pieceIndex = piece;
+    e.bitfield = &peer->have;
+    peerCallbackFunc(peer, &e, s);
+}
+
+/***
+****  desiredAvailable
+***/
+
+/* recount the bytes that connected peers could send us, the slow way */
+static uint64_t countDesiredAvailable(tr_swarm const* s)
+{
+    uint64_t total = 0;
+    tr_torrent const* tor = s->tor;
+
+    for (tr_piece_index_t p = 0; p < tor->info.pieceCount; ++p)
+    {
+        bool isAvailable = false;
+
+        for (int i = 0, n = tr_ptrArraySize(&s->peers); i < n && !isAvailable; ++i)
+        {
+            isAvailable = tr_bitfieldHas(&((tr_peer const*)tr_ptrArrayNth((tr_ptrArray*)&s->peers, i))->have, p);
+        }
+
+        if (isAvailable && !tor->info.pieceDND[p])
+        {
+            total += tr_torrentMissingBytesInPiece(tor, p);
+        }
+    }
+
+    return total;
+}
+
+static int test_desired_available(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_swarm* s;
+    int nextPeer = 0;
+
+    session = libttest_session_init(NULL);
+    tor = libttest_zero_torrent_init(session);
+    libttest_zero_torrent_populate(tor, false);
+    s = tor->swarm;
+
+    tr_sessionLock(session);
+
+    for (tr_piece_index_t p = 0; p < tor->info.pieceCount; ++p)
+    {
+        tr_torrentSetHasPiece(tor, p, false);
+    }
+
+    /* what tr_peerMgrStartTorrent() does, without starting the timers */
+    s->isRunning = true;
+    replicationNew(s);
+    check_uint(s->desiredAvailable, ==, 0);
+
+    for (int step = 0; step < 2000; ++step)
+    {
+        int const peerCount = tr_ptrArraySize(&s->peers);
+        tr_peer* peer = peerCount > 0 ? tr_ptrArrayNth(&s->peers, tr_rand_int_weak(peerCount)) : NULL;
+        tr_piece_index_t const piece = tr_rand_int_weak(tor->info.pieceCount);
+
+        switch (peer == NULL ? 0 : tr_rand_int_weak(8))
+        {
+        case 0: /* a new peer says which pieces it has */
+            peer = addTestPeer(s, nextPeer++);
+
+            for (tr_piece_index_t p = 0; p < tor->info.pieceCount; ++p)
+            {
+                if (tr_rand_int_weak(4) == 0)
+                {
+                    tr_bitfieldAdd(&peer->have, p);
+                }
+            }
+
+            firePeerEvent(s, peer, TR_PEER_CLIENT_GOT_BITFIELD, 0);
+            break;
+
+        case 1: /* a seed connects */
+            peer = addTestPeer(s, nextPeer++);
+            tr_bitfieldSetHasAll(&peer->have);
+            firePeerEvent(s, peer, TR_PEER_CLIENT_GOT_HAVE_ALL, 0);
+            break;
+
+        case 2:
+            removePeer(s, peer);
+            break;
+
+        case 3:
+        case 4:
+            if (!tr_bitfieldHas(&peer->have, piece))
+            {
+                tr_bitfieldAdd(&peer->have, piece);
+                firePeerEvent(s, peer, TR_PEER_CLIENT_GOT_HAVE, piece);
+            }
+
+            break;
+
+        case 5: /* a block arrives, which may complete its piece */
+            {
+                tr_block_index_t first;
+                tr_block_index_t last;
+                tr_torGetPieceBlockRange(tor, piece, &first, &last);
+                tr_cpBlockAdd(&tor->completion, first + tr_rand_int_weak(last + 1 - first));
+                break;
+            }
+
+        case 6: /* a piece fails its checksum */
+            tr_torrentSetHasPiece(tor, piece, false);
+            break;
+
+        case 7:
+            {
+                tr_file_index_t const file = tr_rand_int_weak(tor->info.fileCount);
+                tr_torrentSetFileDLs(tor, &file, 1, tor->info.files[file].dnd);
+                break;
+            }
+        }
+
+        check_uint(s->desiredAvailable, ==, countDesiredAvailable(s));
+    }
+
+    removeAllPeers(s);
+    check_uint(s->desiredAvailable, ==, 0);
+
+    s->isRunning = false;
+    replicationFree(s);
+    tr_sessionUnlock(session);
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****  The atom index
+***/
+
+#define TEST_ATOM_COUNT 500
+
+static void getTestAtomAddress(tr_address* addr, int n)
+{
+    memset(addr, 0, sizeof(tr_address));
+
+    if (n % 2 == 0)
+    {
+        /* 192.168.0.0, 192.168.0.2, ... */
+        addr->type = TR_AF_INET;
+        addr->addr.addr4.s_addr = htonl(0xc0a80000 + n);
+    }
+    else
+    {
+        /* 2001:db8::1, 2001:db8::3, ... */
+        addr->type = TR_AF_INET6;
+        addr->addr.addr6.s6_addr[0] = 0x20;
+        addr->addr.addr6.s6_addr[1] = 0x01;
+        addr->addr.addr6.s6_addr[2] = 0x0d;
+        addr->addr.addr6.s6_addr[3] = 0xb8;
+        addr->addr.addr6.s6_addr[14] = (n >> 8) & 0xff;
+        addr->addr.addr6.s6_addr[15] = n & 0xff;
+    }
+}
+
+/* every atom in the pool can be found by its address, and nothing else can */
+static int checkAtomIndex(tr_swarm const* s, int addressCount)
+{
+    int found = 0;
+
+    for (int i = 0, n = tr_ptrArraySize(&s->pool); i < n; ++i)
+    {
+        struct peer_atom* atom = tr_ptrArrayNth((tr_ptrArray*)&s->pool, i);
+        check_ptr(getExistingAtom(s, &atom->addr), ==, atom);
+    }
+
+    for (int i = 0; i < addressCount; ++i)
+    {
+        tr_address addr;
+        struct peer_atom const* atom;
+
+        getTestAtomAddress(&addr, i);
+        atom = getExistingAtom(s, &addr);
+
+        if (atom != NULL)
+        {
+            check_int(tr_address_compare(&atom->addr, &addr), ==, 0);
+            ++found;
+        }
+    }
+
+    check_int(found, ==, tr_ptrArraySize(&s->pool) - tr_ptrArraySize(&s->peers));
+    return 0;
+}
+
+static int test_atom_index(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_swarm* s;
+    tr_address addr;
+    tr_peer* connected[5];
+
+    session = libttest_session_init(NULL);
+    tor = libttest_zero_torrent_init(session);
+    s = tor->swarm;
+
+    tr_sessionLock(session);
+    check_ptr(getExistingAtom(s, &tr_inaddr_any), ==, NULL);
+
+    /* some peers we're connected to, whose atoms have to survive pruning */
+    for (int i = 0; i < 5; ++i)
+    {
+        connected[i] = addTestPeer(s, i);
+    }
+
+    for (int i = 0; i < TEST_ATOM_COUNT; ++i)
+    {
+        getTestAtomAddress(&addr, i);
+        ensureAtomExists(s, &addr, 51413, 0, -1, TR_PEER_FROM_TRACKER);
+        ensureAtomExists(s, &addr, 51413, 0, -1, TR_PEER_FROM_PEX);
+    }
+
+    check_int(tr_ptrArraySize(&s->pool), ==, TEST_ATOM_COUNT + 5);
+    check_int(checkAtomIndex(s, TEST_ATOM_COUNT), ==, 0);
+
+    /* prune down to getMaxAtomCount() and rebuild the index */
+    tor->maxConnectedPeers = 10;
+    pruneAtoms(s);
+    check_int(tr_ptrArraySize(&s->pool), ==, getMaxAtomCount(tor));
+    check_int(checkAtomIndex(s, TEST_ATOM_COUNT), ==, 0);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        check_ptr(getExistingAtom(s, &connected[i]->atom->addr), ==, connected[i]->atom);
+    }
+
+    /* the rebuilt index takes new atoms, and pruned ones can come back */
+    for (int i = 0; i < TEST_ATOM_COUNT; ++i)
+    {
+        getTestAtomAddress(&addr, i);
+        ensureAtomExists(s, &addr, 51413, 0, -1, TR_PEER_FROM_DHT);
+    }
+
+    check_int(tr_ptrArraySize(&s->pool), ==, TEST_ATOM_COUNT + 5);
+    check_int(checkAtomIndex(s, TEST_ATOM_COUNT), ==, 0);
+
+    removeAllPeers(s);
+    tr_sessionUnlock(session);
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****  Upload choking
+***/
+
+#define RANKED_PEERS 40
+
+/* which candidates get unchoked, and which are up for an optimistic unchoke,
+ * the way rechokeUploads() decided before it kept a ranking: sort everyone
+ * from scratch and walk the list until enough interested peers are unchoked */
+static void chooseUnchokesBySorting(struct ChokeData const* ranking, int n, int slots, bool isMaxedOut,
+    bool* unchoked, bool* optimistic, tr_peer const* peers)
+{
+    int size = 0;
+    int i;
+    int unchokedInterested = 0;
+    struct ChokeData choke[RANKED_PEERS];
+
+    for (i = 0; i < n; ++i)
+    {
+        if (ranking[i].isCandidate)
+        {
+            choke[size++] = ranking[i];
+        }
+    }
+
+    qsort(choke, size, sizeof(struct ChokeData), compareChoke);
+
+    for (i = 0; i < size && unchokedInterested < slots; ++i)
+    {
+        unchoked[choke[i].peer - peers] = !(isMaxedOut ? choke[i].wasChoked : false);
+
+        if (choke[i].isInterested)
+        {
+            ++unchokedInterested;
+        }
+    }
+
+    for (; i < size; ++i)
+    {
+        optimistic[choke[i].peer - peers] = choke[i].isInterested;
+    }
+}
+
+static int test_upload_ranking(void)
+{
+    tr_peer peers[RANKED_PEERS];
+    struct ChokeData ranking[RANKED_PEERS];
+
+    for (int i = 0; i < RANKED_PEERS; ++i)
+    {
+        memset(&ranking[i], 0, sizeof(struct ChokeData));
+        ranking[i].salt = tr_rand_int_weak(INT_MAX);
+        ranking[i].peer = &peers[i];
+    }
+
+    /* rechoke the same peers over and over, shuffling a few of their rates
+     * and states each time, and check that keeping the ranking up to date
+     * picks the same peers as sorting everyone each time */
+    for (int round = 0; round < 10000; ++round)
+    {
+        int const n = tr_rand_int_weak(RANKED_PEERS + 1);
+        int const slots = tr_rand_int_weak(8);
+        bool const isMaxedOut = tr_rand_int_weak(8) == 0;
+        bool expectedUnchoked[RANKED_PEERS] = { false };
+        bool expectedOptimistic[RANKED_PEERS] = { false };
+        int checkedCount;
+
+        for (int i = 0; i < n; ++i)
+        {
+            struct ChokeData* c = &ranking[i];
+
+            if (tr_rand_int_weak(4) == 0)
+            {
+                c->rate = tr_rand_int_weak(4) == 0 ? 0 : tr_rand_int_weak(100);
+                c->isInterested = tr_rand_int_weak(3) != 0;
+                c->wasChoked = tr_rand_int_weak(2) == 0;
+                c->isCandidate = tr_rand_int_weak(10) != 0;
+            }
+
+            c->isChoked = true;
+        }
+
+        chooseUnchokesBySorting(ranking, n, slots, isMaxedOut, expectedUnchoked, expectedOptimistic, peers);
+
+        uploadRankingRepair(ranking, n);
+
+        for (int i = 1; i < n; ++i)
+        {
+            check_int(compareChoke(&ranking[i - 1], &ranking[i]), <=, 0);
+        }
+
+        checkedCount = uploadRankingUnchoke(ranking, n, slots, isMaxedOut);
+
+        for (int i = 0; i < n; ++i)
+        {
+            int const peer = ranking[i].peer - peers;
+            check_bool(!ranking[i].isChoked, ==, expectedUnchoked[peer]);
+            check_bool(i >= checkedCount && ranking[i].isCandidate && ranking[i].isInterested, ==, expectedOptimistic[peer]);
+        }
+    }
+
+    return 0;
+}
+
+/***
+****
+***/
+
+int main(void)
+{
+    testFunc const tests[] =
+    {
+        test_desired_available,
+        test_atom_index,
+        test_upload_ranking
+    };
+
+    return runTests(tests, NUM_TESTS(tests));
+}
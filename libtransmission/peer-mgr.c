@@ -117,16 +117,6 @@ tr_swarm_stats const TR_SWARM_STATS_INIT =
  */
 struct peer_atom
 {
-    uint8_t fromFirst; /* where the peer was first found */
-    uint8_t fromBest; /* the "best" value of where the peer has been found */
-    uint8_t flags; /* these match the added_f flags */
-    uint8_t flags2; /* flags that aren't defined in added_f */
-    int8_t seedProbability; /* how likely is this to be a seed... [0..100] or -1 for unknown */
-    int8_t blocklisted; /* -1 for unknown, true for blocklisted, false for not blocklisted */
-
-    tr_port port;
-    bool utp_failed; /* We recently failed to connect over uTP */
-    uint16_t numFails;
     time_t time; /* when the peer's connection status last changed */
     time_t piece_data_time;
 
@@ -138,6 +128,18 @@ struct peer_atom
     time_t shelf_date;
     tr_peer* peer; /* will be NULL if not connected */
     tr_address addr;
+
+    /* the small fields go last. tr_address is 20 bytes, so they fill the
+     * space after it that would otherwise be padding at the end of the struct */
+    tr_port port;
+    uint16_t numFails;
+    uint8_t fromFirst; /* where the peer was first found */
+    uint8_t fromBest; /* the "best" value of where the peer has been found */
+    uint8_t flags; /* these match the added_f flags */
+    uint8_t flags2; /* flags that aren't defined in added_f */
+    int8_t seedProbability; /* how likely is this to be a seed... [0..100] or -1 for unknown */
+    int8_t blocklisted; /* -1 for unknown, true for blocklisted, false for not blocklisted */
+    bool utp_failed; /* We recently failed to connect over uTP */
 };
 
 #ifndef TR_ENABLE_ASSERTS
@@ -186,16 +188,31 @@ typedef struct tr_swarm
     tr_swarm_stats stats;
 
     tr_ptrArray outgoingHandshakes; /* tr_handshake */
-    tr_ptrArray pool; /* struct peer_atom */
+    tr_ptrArray pool; /* struct peer_atom, unsorted */
     tr_ptrArray peers; /* tr_peerMsgs */
     tr_ptrArray webseeds; /* tr_webseed */
 
+    /* an open-addressing hash table of the atoms in pool, keyed by address.
+       Each slot holds an atom's position in pool plus one, or zero if the
+       slot is empty, and the table is never more than 7/8 full. atoms are
+       only ever removed by pruneAtoms(), which rebuilds it, so there are
+       no tombstones to worry about. */
+    uint32_t* atomIndex;
+    size_t atomIndexSize;
+
     tr_torrent* tor;
     struct tr_peerMgr* manager;
 
     tr_peerMsgs* optimistic; /* the optimistic peer, or NULL if none */
     int optimisticUnchokeTimeScaler;
 
+    /* one entry per peer, best upload candidates first as of the last
+       rechoke. Peers' rates don't change much from one rechoke to the
+       next, so rechokeUploads() only has to repair this order */
+    struct ChokeData* uploadRanking;
+    int uploadRankingCount;
+    int uploadRankingAlloc;
+
     bool isRunning;
     bool needsCompletenessCheck;
 
@@ -208,12 +225,16 @@ typedef struct tr_swarm
     enum piece_sort_state pieceSortState;
 
     /* An array of pieceCount items stating how many peers have each piece.
-       This is used to help us for downloading pieces "rarest first."
-       This may be NULL if we don't have metainfo yet, or if we're not
-       downloading and don't care about rarity */
+       This is used to help us for downloading pieces "rarest first,"
+       and to keep desiredAvailable current.
+       This may be NULL if we don't have metainfo yet, or if we're not running */
     uint16_t* pieceReplication;
     size_t pieceReplicationSize;
 
+    /* the missing bytes of wanted pieces that at least one peer has.
+       kept current whenever pieceReplication exists */
+    uint64_t desiredAvailable;
+
     int interestedCount;
     int maxPeers;
     time_t lastCancel;
@@ -361,22 +382,6 @@ static inline tr_handshake* getExistingHandshake(tr_ptrArray* handshakes, tr_add
     return tr_ptrArrayFindSorted(handshakes, addr, handshakeCompareToAddr);
 }
 
-static int comparePeerAtomToAddress(void const* va, void const* vb)
-{
-    struct peer_atom const* a = va;
-
-    return tr_address_compare(&a->addr, vb);
-}
-
-static int compareAtomsByAddress(void const* va, void const* vb)
-{
-    struct peer_atom const* b = vb;
-
-    TR_ASSERT(tr_isAtom(b));
-
-    return comparePeerAtomToAddress(va, &b->addr);
-}
-
 /**
 ***
 **/
@@ -398,10 +403,109 @@ static int peerCompare(void const* a, void const* b)
     return tr_address_compare(tr_peerAddress(a), tr_peerAddress(b));
 }
 
-static struct peer_atom* getExistingAtom(tr_swarm const* cswarm, tr_address const* addr)
+/***
+****  The atom index
+***/
+
+/* FNV-1a over the address bytes */
+static size_t atomHash(tr_address const* addr)
+{
+    uint8_t const* bytes;
+    size_t len;
+    uint32_t h = 2166136261U;
+
+    if (addr->type == TR_AF_INET)
+    {
+        bytes = (uint8_t const*)&addr->addr.addr4;
+        len = sizeof(addr->addr.addr4);
+    }
+    else
+    {
+        bytes = addr->addr.addr6.s6_addr;
+        len = sizeof(addr->addr.addr6.s6_addr);
+    }
+
+    h ^= (uint8_t)addr->type;
+    h *= 16777619U;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= bytes[i];
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+static void atomIndexInsert(uint32_t* index, size_t indexSize, struct peer_atom const* atom, size_t pos)
+{
+    size_t i = atomHash(&atom->addr) % indexSize;
+
+    while (index[i] != 0)
+    {
+        i = i + 1 < indexSize ? i + 1 : 0;
+    }
+
+    index[i] = pos + 1;
+}
+
+/* rebuild the index from the pool, leaving room for the pool to grow by half */
+static void atomIndexRebuild(tr_swarm* s)
+{
+    int n;
+    struct peer_atom** atoms = (struct peer_atom**)tr_ptrArrayPeek(&s->pool, &n);
+    size_t const size = n == 0 ? 0 : (size_t)n + n / 2 + 1;
+
+    tr_free(s->atomIndex);
+    s->atomIndex = tr_new0(uint32_t, size);
+    s->atomIndexSize = size;
+
+    for (int i = 0; i < n; ++i)
+    {
+        atomIndexInsert(s->atomIndex, size, atoms[i], i);
+    }
+}
+
+static struct peer_atom* getExistingAtom(tr_swarm const* s, tr_address const* addr)
+{
+    if (s->atomIndexSize == 0)
+    {
+        return NULL;
+    }
+
+    struct peer_atom** atoms = (struct peer_atom**)tr_ptrArrayBase(&s->pool);
+
+    for (size_t i = atomHash(addr) % s->atomIndexSize;; i = i + 1 < s->atomIndexSize ? i + 1 : 0)
+    {
+        uint32_t const pos = s->atomIndex[i];
+
+        if (pos == 0)
+        {
+            return NULL;
+        }
+
+        if (tr_address_compare(&atoms[pos - 1]->addr, addr) == 0)
+        {
+            return atoms[pos - 1];
+        }
+    }
+}
+
+static void atomAdd(tr_swarm* s, struct peer_atom* atom)
 {
-    tr_swarm* swarm = (tr_swarm*)cswarm;
-    return tr_ptrArrayFindSorted(&swarm->pool, addr, comparePeerAtomToAddress);
+    size_t const pos = (size_t)tr_ptrArraySize(&s->pool);
+
+    tr_ptrArrayAppend(&s->pool, atom);
+
+    /* past 7/8 full, linear probing starts to slow down */
+    if ((pos + 1) * 8 > s->atomIndexSize * 7)
+    {
+        atomIndexRebuild(s);
+    }
+    else
+    {
+        atomIndexInsert(s->atomIndex, s->atomIndexSize, atom, pos);
+    }
 }
 
 static bool peerIsInUse(tr_swarm const* cs, struct peer_atom const* atom)
@@ -424,6 +528,26 @@ static void replicationFree(tr_swarm* s)
     tr_free(s->pieceReplication);
     s->pieceReplication = NULL;
     s->pieceReplicationSize = 0;
+    s->desiredAvailable = 0;
+}
+
+/* how many of this piece's bytes count toward desiredAvailable if a peer has it */
+static inline uint64_t pieceDesiredBytes(tr_torrent const* tor, tr_piece_index_t piece)
+{
+    return tor->info.pieceDND[piece] ? 0 : tr_torrentMissingBytesInPiece(tor, piece);
+}
+
+static void replicationRecountDesired(tr_swarm* s)
+{
+    s->desiredAvailable = 0;
+
+    for (size_t i = 0; i < s->pieceReplicationSize; ++i)
+    {
+        if (s->pieceReplication[i] > 0)
+        {
+            s->desiredAvailable += pieceDesiredBytes(s->tor, i);
+        }
+    }
 }
 
 static void replicationNew(tr_swarm* s)
@@ -436,21 +560,22 @@ static void replicationNew(tr_swarm* s)
     s->pieceReplicationSize = piece_count;
     s->pieceReplication = tr_new0(uint16_t, piece_count);
 
-    for (tr_piece_index_t piece_i = 0; piece_i < piece_count; ++piece_i)
+    for (int peer_i = 0; peer_i < n; ++peer_i)
     {
-        uint16_t r = 0;
+        tr_peer const* peer = tr_ptrArrayNth(&s->peers, peer_i);
 
-        for (int peer_i = 0; peer_i < n; ++peer_i)
-        {
-            tr_peer* peer = tr_ptrArrayNth(&s->peers, peer_i);
+        tr_bitfieldIncrCounts(&peer->have, s->pieceReplication, piece_count);
+    }
 
-            if (tr_bitfieldHas(&peer->have, piece_i))
-            {
-                ++r;
-            }
-        }
+    replicationRecountDesired(s);
+}
 
-        s->pieceReplication[piece_i] = r;
+/* one more peer has this piece */
+static inline void replicationAdd(tr_swarm* s, tr_piece_index_t piece)
+{
+    if (s->pieceReplication[piece]++ == 0)
+    {
+        s->desiredAvailable += pieceDesiredBytes(s->tor, piece);
     }
 }
 
@@ -466,6 +591,8 @@ static void swarmFree(void* vs)
 
     tr_ptrArrayDestruct(&s->webseeds, (PtrArrayForeachFunc)tr_peerFree);
     tr_ptrArrayDestruct(&s->pool, (PtrArrayForeachFunc)tr_free);
+    tr_free(s->atomIndex);
+    tr_free(s->uploadRanking);
     tr_ptrArrayDestruct(&s->outgoingHandshakes, NULL);
     tr_ptrArrayDestruct(&s->peers, NULL);
     s->stats = TR_SWARM_STATS_INIT;
@@ -933,8 +1060,8 @@ static int comparePieceByWeight(void const* va, void const* vb)
     }
 
     /* secondary key: higher priorities go first */
-    ia = tor->info.pieces[a->index].priority;
-    ib = tor->info.pieces[b->index].priority;
+    ia = tor->info.piecePriority[a->index];
+    ib = tor->info.piecePriority[b->index];
 
     if (ia > ib)
     {
@@ -1018,6 +1145,7 @@ static void pieceListSort(tr_swarm* s, enum piece_sort_state state)
 
 #define assertWeightedPiecesAreSorted(t)
 #define assertReplicationCountIsExact(t)
+#define assertDesiredAvailableIsExact(t)
 
 #else
 
@@ -1064,6 +1192,21 @@ static void assertReplicationCountIsExact(Torrent* t)
     }
 }
 
+static void assertDesiredAvailableIsExact(Torrent const* t)
+{
+    uint64_t desiredAvailable = 0;
+
+    for (size_t i = 0; i < t->pieceReplicationSize; ++i)
+    {
+        if (t->pieceReplication[i] > 0)
+        {
+            desiredAvailable += pieceDesiredBytes(t->tor, i);
+        }
+    }
+
+    TR_ASSERT(t->desiredAvailable == desiredAvailable);
+}
+
 #endif
 
 static struct weighted_piece* pieceListLookup(tr_swarm* s, tr_piece_index_t index)
@@ -1095,7 +1238,7 @@ static void pieceListRebuild(tr_swarm* s)
 
         for (tr_piece_index_t i = 0; i < inf->pieceCount; ++i)
         {
-            if (!inf->pieces[i].dnd)
+            if (!inf->pieceDND[i])
             {
                 if (!tr_torrentPieceIsComplete(tor, i))
                 {
@@ -1252,7 +1395,7 @@ static void tr_incrReplicationOfPiece(tr_swarm* s, size_t const index)
     TR_ASSERT(s->pieceReplicationSize == s->tor->info.pieceCount);
 
     /* One more replication of this piece is present in the swarm */
-    ++s->pieceReplication[index];
+    replicationAdd(s, index);
 
     /* we only resort the piece if the list is already sorted */
     if (s->pieceSortState == PIECES_SORTED_BY_WEIGHT)
@@ -1267,17 +1410,21 @@ static void tr_incrReplicationOfPiece(tr_swarm* s, size_t const index)
 static void tr_incrReplicationFromBitfield(tr_swarm* s, tr_bitfield const* b)
 {
     TR_ASSERT(replicationExists(s));
+    TR_ASSERT(s->pieceReplicationSize == s->tor->info.pieceCount);
 
-    uint16_t* rep = s->pieceReplication;
+    tr_bitfieldIncrCounts(b, s->pieceReplication, s->pieceReplicationSize);
 
-    for (size_t i = 0, n = s->tor->info.pieceCount; i < n; ++i)
+    /* the pieces that only this peer has were missing from the total */
+    for (size_t i = 0; i < s->pieceReplicationSize; ++i)
     {
-        if (tr_bitfieldHas(b, i))
+        if (s->pieceReplication[i] == 1 && tr_bitfieldHas(b, i))
         {
-            ++rep[i];
+            s->desiredAvailable += pieceDesiredBytes(s->tor, i);
         }
     }
 
+    /* don't resort piece-by-piece; the whole list is resorted
+     * the next time it's needed */
     if (s->pieceSortState == PIECES_SORTED_BY_WEIGHT)
     {
         invalidatePieceSorting(s);
@@ -1294,7 +1441,7 @@ static void tr_incrReplication(tr_swarm* s)
 
     for (size_t i = 0; i < s->pieceReplicationSize; ++i)
     {
-        ++s->pieceReplication[i];
+        replicationAdd(s, i);
     }
 }
 
@@ -1306,27 +1453,29 @@ static void tr_decrReplicationFromBitfield(tr_swarm* s, tr_bitfield const* b)
     TR_ASSERT(replicationExists(s));
     TR_ASSERT(s->pieceReplicationSize == s->tor->info.pieceCount);
 
-    if (tr_bitfieldHasAll(b))
-    {
-        for (size_t i = 0; i < s->pieceReplicationSize; ++i)
-        {
-            --s->pieceReplication[i];
-        }
-    }
-    else if (!tr_bitfieldHasNone(b))
+    tr_bitfieldDecrCounts(b, s->pieceReplication, s->pieceReplicationSize);
+
+    /* take out the pieces that only this peer had */
+    for (size_t i = 0; i < s->pieceReplicationSize; ++i)
     {
-        for (size_t i = 0; i < s->pieceReplicationSize; ++i)
+        uint16_t const r = s->pieceReplication[i];
+
+        if ((r == 0 || r == UINT16_MAX) && tr_bitfieldHas(b, i))
         {
-            if (tr_bitfieldHas(b, i))
+            if (r == 0)
+            {
+                s->desiredAvailable -= pieceDesiredBytes(s->tor, i);
+            }
+            else /* buggy clients that send duplicate bitfields can make this wrap around */
             {
-                --s->pieceReplication[i];
+                s->pieceReplication[i] = 0;
             }
         }
+    }
 
-        if (s->pieceSortState == PIECES_SORTED_BY_WEIGHT)
-        {
-            invalidatePieceSorting(s);
-        }
+    if (!tr_bitfieldHasAll(b) && !tr_bitfieldHasNone(b) && s->pieceSortState == PIECES_SORTED_BY_WEIGHT)
+    {
+        invalidatePieceSorting(s);
     }
 }
 
@@ -1952,7 +2101,7 @@ static void ensureAtomExists(tr_swarm* s, tr_address const* addr, tr_port const
         a->shelf_date = tr_time() + getDefaultShelfLife(from) + jitter;
         a->blocklisted = -1;
         atomSetSeedProbability(a, seedProbability);
-        tr_ptrArrayInsertSorted(&s->pool, a, compareAtomsByAddress);
+        atomAdd(s, a);
 
         tordbg(s, "got a new atom: %s", tr_atomAddrStr(a));
     }
@@ -1982,25 +2131,38 @@ static int getPeerCount(tr_swarm const* s)
     return tr_ptrArraySize(&s->peers); /* + tr_ptrArraySize(&t->outgoingHandshakes); */
 }
 
-static void createBitTorrentPeer(tr_torrent* tor, struct tr_peerIo* io, struct peer_atom* atom, tr_quark client)
+static void uploadRankingAdd(tr_swarm*, tr_peer*);
+static void uploadRankingRemove(tr_swarm*, tr_peer const*);
+
+static void addPeer(tr_swarm* swarm, tr_peer* peer, struct peer_atom* atom)
 {
+    TR_ASSERT(swarmIsLocked(swarm));
     TR_ASSERT(atom != NULL);
-    TR_ASSERT(tr_isTorrent(tor));
-    TR_ASSERT(tor->swarm != NULL);
 
-    tr_swarm* swarm = tor->swarm;
-
-    tr_peer* peer = (tr_peer*)tr_peerMsgsNew(tor, io, peerCallbackFunc, swarm);
     peer->atom = atom;
-    peer->client = client;
     atom->peer = peer;
 
     tr_ptrArrayInsertSorted(&swarm->peers, peer, peerCompare);
     ++swarm->stats.peerCount;
     ++swarm->stats.peerFromCount[atom->fromFirst];
+    uploadRankingAdd(swarm, peer);
 
     TR_ASSERT(swarm->stats.peerCount == tr_ptrArraySize(&swarm->peers));
     TR_ASSERT(swarm->stats.peerFromCount[atom->fromFirst] <= swarm->stats.peerCount);
+    TR_ASSERT(swarm->uploadRankingCount == swarm->stats.peerCount);
+}
+
+static void createBitTorrentPeer(tr_torrent* tor, struct tr_peerIo* io, struct peer_atom* atom, tr_quark client)
+{
+    TR_ASSERT(atom != NULL);
+    TR_ASSERT(tr_isTorrent(tor));
+    TR_ASSERT(tor->swarm != NULL);
+
+    tr_swarm* swarm = tor->swarm;
+
+    tr_peer* peer = (tr_peer*)tr_peerMsgsNew(tor, io, peerCallbackFunc, swarm);
+    peer->client = client;
+    addPeer(swarm, peer, atom);
 
     tr_peerMsgs* msgs = PEER_MSGS(peer);
     tr_peerMsgsUpdateActive(msgs, TR_UP);
@@ -2515,6 +2677,12 @@ void tr_peerMgrStartTorrent(tr_torrent* tor)
     s->maxPeers = tor->maxConnectedPeers;
     s->pieceSortState = PIECES_UNSORTED;
 
+    /* the replication counts also keep desiredAvailable current */
+    if (!replicationExists(s) && tr_torrentHasMetadata(tor))
+    {
+        replicationNew(s);
+    }
+
     rechokePulse(0, 0, s->manager);
 }
 
@@ -2630,6 +2798,13 @@ void tr_peerMgrOnTorrentGotMetainfo(tr_torrent* tor)
         tr_peerMsgsUpdateActive(tr_peerMsgsCast(peers[i]), TR_UP);
         tr_peerMsgsUpdateActive(tr_peerMsgsCast(peers[i]), TR_DOWN);
     }
+
+    /* now that we know the piece count, start counting replication */
+    if (tor->swarm->isRunning)
+    {
+        replicationFree(tor->swarm);
+        replicationNew(tor->swarm);
+    }
 }
 
 void tr_peerMgrTorrentAvailability(tr_torrent const* tor, int8_t* tab, unsigned int tabCount)
@@ -2642,10 +2817,12 @@ void tr_peerMgrTorrentAvailability(tr_torrent const* tor, int8_t* tab, unsigned
 
     if (tr_torrentHasMetadata(tor))
     {
-        int const peerCount = tr_ptrArraySize(&tor->swarm->peers);
-        tr_peer const** peers = (tr_peer const**)tr_ptrArrayBase(&tor->swarm->peers);
+        tr_swarm const* s = tor->swarm;
+        int const peerCount = tr_ptrArraySize(&s->peers);
+        tr_peer const** peers = (tr_peer const**)tr_ptrArrayBase(&s->peers);
         float const interval = tor->info.pieceCount / (float)tabCount;
         bool const isSeed = tr_torrentGetCompleteness(tor) == TR_SEED;
+        bool const hasReplication = replicationExists(s) && s->pieceReplicationSize == tor->info.pieceCount;
 
         for (tr_piece_index_t i = 0; i < tabCount; ++i)
         {
@@ -2655,6 +2832,11 @@ void tr_peerMgrTorrentAvailability(tr_torrent const* tor, int8_t* tab, unsigned
             {
                 tab[i] = -1;
             }
+            else if (hasReplication)
+            {
+                /* the replication counts are already maintained for rarest-first */
+                tab[i] = MIN(s->pieceReplication[piece], INT8_MAX);
+            }
             else if (peerCount != 0)
             {
                 for (int j = 0; j < peerCount; ++j)
@@ -2725,49 +2907,36 @@ uint64_t tr_peerMgrGetDesiredAvailable(tr_torrent const* tor)
 
     tr_swarm const* s = tor->swarm;
 
-    if (s == NULL || !s->isRunning)
+    if (s == NULL || !s->isRunning || !replicationExists(s))
     {
         return 0;
     }
 
-    size_t const n = tr_ptrArraySize(&s->peers);
+    assertDesiredAvailableIsExact(s);
 
-    if (n == 0)
-    {
-        return 0;
-    }
-    else
-    {
-        tr_peer const** peers = (tr_peer const**)tr_ptrArrayBase(&s->peers);
+    TR_ASSERT(s->desiredAvailable <= tor->info.totalSize);
+    return s->desiredAvailable;
+}
 
-        for (size_t i = 0; i < n; ++i)
-        {
-            if (peers[i]->atom != NULL && atomIsSeed(peers[i]->atom))
-            {
-                return tr_torrentGetLeftUntilDone(tor);
-            }
-        }
-    }
+void tr_peerMgrUpdateDesiredAvailable(tr_torrent* tor, tr_piece_index_t piece, int64_t delta)
+{
+    tr_swarm* s = tor->swarm;
 
-    if (s->pieceReplication == NULL || s->pieceReplicationSize == 0)
+    if (s != NULL && replicationExists(s) && piece < s->pieceReplicationSize && s->pieceReplication[piece] > 0)
     {
-        return 0;
+        s->desiredAvailable += delta;
     }
+}
 
-    /* do it the hard way */
-
-    uint64_t desiredAvailable = 0;
+void tr_peerMgrRecountDesiredAvailable(tr_torrent* tor)
+{
+    tr_swarm* s = tor->swarm;
 
-    for (size_t i = 0, n = MIN(tor->info.pieceCount, s->pieceReplicationSize); i < n; ++i)
+    /* a magnet link's replication is rebuilt when it gets its metainfo */
+    if (s != NULL && replicationExists(s) && s->pieceReplicationSize == tor->info.pieceCount)
     {
-        if (!tor->info.pieces[i].dnd && s->pieceReplication[i] > 0)
-        {
-            desiredAvailable += tr_torrentMissingBytesInPiece(tor, i);
-        }
+        replicationRecountDesired(s);
     }
-
-    TR_ASSERT(desiredAvailable <= tor->info.totalSize);
-    return desiredAvailable;
 }
 
 double* tr_peerMgrWebSpeeds_KBps(tr_torrent const* tor)
@@ -3090,7 +3259,7 @@ static void rechokeDownloads(tr_swarm* s)
 
         for (int i = 0; i < n; ++i)
         {
-            piece_is_interesting[i] = !tor->info.pieces[i].dnd && !tr_torrentPieceIsComplete(tor, i);
+            piece_is_interesting[i] = !tor->info.pieceDND[i] && !tr_torrentPieceIsComplete(tor, i);
         }
 
         /* decide WHICH peers to be interested in (based on their cancel-to-block ratio) */
@@ -3144,10 +3313,16 @@ static void rechokeDownloads(tr_swarm* s)
         tr_free(piece_is_interesting);
     }
 
-    /* now that we know which & how many peers to be interested in... update the peer interest */
-    qsort(rechoke, rechoke_count, sizeof(struct tr_rechoke_info), compare_rechoke_info);
+    /* now that we know which & how many peers to be interested in... update the peer interest.
+     * only the set of best peers matters, not their order, so there's no need to sort them all */
     s->interestedCount = MIN(maxPeers, rechoke_count);
 
+    if (0 < s->interestedCount && s->interestedCount < rechoke_count)
+    {
+        tr_quickfindFirstK(rechoke, rechoke_count, sizeof(struct tr_rechoke_info), compare_rechoke_info,
+            s->interestedCount);
+    }
+
     for (int i = 0; i < rechoke_count; ++i)
     {
         tr_peerMsgsSetInterested(PEER_MSGS(rechoke[i].peer), i < s->interestedCount);
@@ -3163,12 +3338,13 @@ static void rechokeDownloads(tr_swarm* s)
 
 struct ChokeData
 {
+    bool isCandidate; /* false for seeds, the optimistic unchoke, and everyone if we aren't uploading */
     bool isInterested;
     bool wasChoked;
     bool isChoked;
     int rate;
-    int salt;
-    tr_peerMsgs* msgs;
+    int salt; /* chosen when the peer connects, to break ties */
+    tr_peer* peer;
 };
 
 static int compareChoke(void const* va, void const* vb)
@@ -3188,12 +3364,114 @@ static int compareChoke(void const* va, void const* vb)
 
     if (a->salt != b->salt) /* random order */
     {
-        return a->salt - b->salt;
+        return a->salt < b->salt ? -1 : 1;
     }
 
     return 0;
 }
 
+/* new peers start at the bottom, since they haven't sent us anything yet */
+static void uploadRankingAdd(tr_swarm* s, tr_peer* peer)
+{
+    if (s->uploadRankingCount + 1 >= s->uploadRankingAlloc)
+    {
+        int const CHUNK_SIZE = 16;
+        s->uploadRankingAlloc += CHUNK_SIZE;
+        s->uploadRanking = tr_renew(struct ChokeData, s->uploadRanking, s->uploadRankingAlloc);
+    }
+
+    struct ChokeData* c = &s->uploadRanking[s->uploadRankingCount++];
+    memset(c, 0, sizeof(struct ChokeData));
+    c->wasChoked = true;
+    c->isChoked = true;
+    c->salt = tr_rand_int_weak(INT_MAX);
+    c->peer = peer;
+}
+
+static void uploadRankingRemove(tr_swarm* s, tr_peer const* peer)
+{
+    for (int i = 0; i < s->uploadRankingCount; ++i)
+    {
+        if (s->uploadRanking[i].peer == peer)
+        {
+            tr_removeElementFromArray(s->uploadRanking, i, sizeof(struct ChokeData), s->uploadRankingCount);
+            --s->uploadRankingCount;
+            break;
+        }
+    }
+}
+
+/* bring the ranking up to date after its entries' rates have changed.
+ * This is an insertion sort, so it's linear when only a few peers have
+ * moved since the last rechoke; if too many have, start over with qsort() */
+static void uploadRankingRepair(struct ChokeData* ranking, int n)
+{
+    int moves = 0;
+    int const maxMoves = n * 4;
+
+    for (int i = 1; i < n; ++i)
+    {
+        struct ChokeData const tmp = ranking[i];
+        int j = i;
+
+        while (j > 0 && compareChoke(&ranking[j - 1], &tmp) > 0)
+        {
+            ranking[j] = ranking[j - 1];
+            --j;
+
+            if (++moves > maxMoves)
+            {
+                ranking[j] = tmp;
+                qsort(ranking, n, sizeof(struct ChokeData), compareChoke);
+                return;
+            }
+        }
+
+        ranking[j] = tmp;
+    }
+}
+
+/**
+ * Reciprocation and number of uploads capping is managed by unchoking
+ * the N peers which have the best upload rate and are interested.
+ * This maximizes the client's download rate. These N peers are
+ * referred to as downloaders, because they are interested in downloading
+ * from the client.
+ *
+ * Peers which have a better upload rate (as compared to the downloaders)
+ * but aren't interested get unchoked. If they become interested, the
+ * downloader with the worst upload rate gets choked. If a client has
+ * a complete file, it uses its upload rate rather than its download
+ * rate to decide which peers to unchoke.
+ *
+ * If our bandwidth is maxed out, don't unchoke any more peers.
+ *
+ * Returns the position in the ranking after the last downloader;
+ * the interested candidates past it are eligible for an optimistic unchoke.
+ */
+static int uploadRankingUnchoke(struct ChokeData* ranking, int n, int slots, bool isMaxedOut)
+{
+    int i;
+    int unchokedInterested = 0;
+
+    for (i = 0; i < n && unchokedInterested < slots; ++i)
+    {
+        struct ChokeData* c = &ranking[i];
+
+        if (c->isCandidate)
+        {
+            c->isChoked = isMaxedOut ? c->wasChoked : false;
+
+            if (c->isInterested)
+            {
+                ++unchokedInterested;
+            }
+        }
+    }
+
+    return i;
+}
+
 /* is this a new connection? */
 static bool isNew(tr_peerMsgs const* msgs)
 {
@@ -3243,10 +3521,10 @@ static inline bool isBandwidthMaxedOut(tr_bandwidth const* b, uint64_t const now
 static void rechokeUploads(tr_swarm* s, uint64_t const now)
 {
     TR_ASSERT(swarmIsLocked(s));
+    TR_ASSERT(s->uploadRankingCount == tr_ptrArraySize(&s->peers));
 
-    int const peerCount = tr_ptrArraySize(&s->peers);
-    tr_peer** peers = (tr_peer**)tr_ptrArrayBase(&s->peers);
-    struct ChokeData* choke = tr_new0(struct ChokeData, peerCount);
+    int const n = s->uploadRankingCount;
+    struct ChokeData* ranking = s->uploadRanking;
     tr_session const* session = s->manager->session;
     bool const chokeAll = !tr_torrentIsPieceTransferAllowed(s->tor, TR_CLIENT_TO_PEER);
     bool const isMaxedOut = isBandwidthMaxedOut(&s->tor->bandwidth, now, TR_UP);
@@ -3262,107 +3540,71 @@ static void rechokeUploads(tr_swarm* s, uint64_t const now)
         s->optimistic = NULL;
     }
 
-    int size = 0;
-
-    /* sort the peers by preference and rate */
-    for (int i = 0; i < peerCount; ++i)
+    for (int i = 0; i < n; ++i)
     {
-        tr_peer* peer = peers[i];
-        tr_peerMsgs* msgs = PEER_MSGS(peer);
+        struct ChokeData* c = &ranking[i];
+        tr_peerMsgs* msgs = PEER_MSGS(c->peer);
 
-        struct peer_atom* atom = peer->atom;
-
-        if (tr_peerIsSeed(peer))
+        if (tr_peerIsSeed(c->peer) || chokeAll)
         {
-            /* choke seeds and partial seeds */
-            tr_peerMsgsSetChoke(PEER_MSGS(peer), true);
+            /* choke seeds and partial seeds, and everyone if we're not uploading */
+            tr_peerMsgsSetChoke(msgs, true);
+            c->isCandidate = false;
         }
-        else if (chokeAll)
-        {
-            /* choke everyone if we're not uploading */
-            tr_peerMsgsSetChoke(PEER_MSGS(peer), true);
-        }
-        else if (msgs != s->optimistic)
+        else
         {
-            struct ChokeData* n = &choke[size++];
-            n->msgs = msgs;
-            n->isInterested = tr_peerMsgsIsPeerInterested(msgs);
-            n->wasChoked = tr_peerMsgsIsPeerChoked(msgs);
-            n->rate = getRate(s->tor, atom, now);
-            n->salt = tr_rand_int_weak(INT_MAX);
-            n->isChoked = true;
+            c->isCandidate = msgs != s->optimistic;
         }
-    }
 
-    qsort(choke, size, sizeof(struct ChokeData), compareChoke);
-
-    /**
-     * Reciprocation and number of uploads capping is managed by unchoking
-     * the N peers which have the best upload rate and are interested.
-     * This maximizes the client's download rate. These N peers are
-     * referred to as downloaders, because they are interested in downloading
-     * from the client.
-     *
-     * Peers which have a better upload rate (as compared to the downloaders)
-     * but aren't interested get unchoked. If they become interested, the
-     * downloader with the worst upload rate gets choked. If a client has
-     * a complete file, it uses its upload rate rather than its download
-     * rate to decide which peers to unchoke.
-     *
-     * If our bandwidth is maxed out, don't unchoke any more peers.
-     */
-    int unchokedInterested = 0;
-    int checkedChokeCount = 0;
+        c->isInterested = tr_peerMsgsIsPeerInterested(msgs);
+        c->wasChoked = tr_peerMsgsIsPeerChoked(msgs);
+        c->rate = getRate(s->tor, c->peer->atom, now);
+        c->isChoked = true;
+    }
 
-    for (int i = 0; i < size && unchokedInterested < session->uploadSlotsPerTorrent; ++i, ++checkedChokeCount)
-    {
-        choke[i].isChoked = isMaxedOut ? choke[i].wasChoked : false;
+    uploadRankingRepair(ranking, n);
 
-        if (choke[i].isInterested)
-        {
-            ++unchokedInterested;
-        }
-    }
+    int const checkedCount = uploadRankingUnchoke(ranking, n, session->uploadSlotsPerTorrent, isMaxedOut);
 
     /* optimistic unchoke */
-    if (s->optimistic == NULL && !isMaxedOut && checkedChokeCount < size)
+    if (s->optimistic == NULL && !isMaxedOut && checkedCount < n)
     {
-        int n;
+        int pool_n;
         struct ChokeData* c;
         tr_ptrArray randPool = TR_PTR_ARRAY_INIT;
 
-        for (int i = checkedChokeCount; i < size; ++i)
+        for (int i = checkedCount; i < n; ++i)
         {
-            if (choke[i].isInterested)
+            if (ranking[i].isCandidate && ranking[i].isInterested)
             {
-                tr_peerMsgs const* msgs = choke[i].msgs;
+                tr_peerMsgs const* msgs = PEER_MSGS(ranking[i].peer);
                 int const x = isNew(msgs) ? 3 : 1;
 
                 for (int y = 0; y < x; ++y)
                 {
-                    tr_ptrArrayAppend(&randPool, &choke[i]);
+                    tr_ptrArrayAppend(&randPool, &ranking[i]);
                 }
             }
         }
 
-        if ((n = tr_ptrArraySize(&randPool)) != 0)
+        if ((pool_n = tr_ptrArraySize(&randPool)) != 0)
         {
-            c = tr_ptrArrayNth(&randPool, tr_rand_int_weak(n));
+            c = tr_ptrArrayNth(&randPool, tr_rand_int_weak(pool_n));
             c->isChoked = false;
-            s->optimistic = c->msgs;
+            s->optimistic = PEER_MSGS(c->peer);
             s->optimisticUnchokeTimeScaler = OPTIMISTIC_UNCHOKE_MULTIPLIER;
         }
 
         tr_ptrArrayDestruct(&randPool, NULL);
     }
 
-    for (int i = 0; i < size; ++i)
+    for (int i = 0; i < n; ++i)
     {
-        tr_peerMsgsSetChoke(choke[i].msgs, choke[i].isChoked);
+        if (ranking[i].isCandidate)
+        {
+            tr_peerMsgsSetChoke(PEER_MSGS(ranking[i].peer), ranking[i].isChoked);
+        }
     }
-
-    /* cleanup */
-    tr_free(choke);
 }
 
 static void rechokePulse(evutil_socket_t foo UNUSED, short bar UNUSED, void* vmgr)
@@ -3542,6 +3784,7 @@ static void removePeer(tr_swarm* s, tr_peer* peer)
     tr_ptrArrayRemoveSortedPointer(&s->peers, peer, peerCompare);
     --s->stats.peerCount;
     --s->stats.peerFromCount[atom->fromFirst];
+    uploadRankingRemove(s, peer);
 
     if (replicationExists(s))
     {
@@ -3917,17 +4160,6 @@ static void bandwidthPulse(evutil_socket_t foo UNUSED, short bar UNUSED, void* v
 ****
 ***/
 
-static int compareAtomPtrsByAddress(void const* va, void const* vb)
-{
-    struct peer_atom const* a = *(struct peer_atom const* const*)va;
-    struct peer_atom const* b = *(struct peer_atom const* const*)vb;
-
-    TR_ASSERT(tr_isAtom(a));
-    TR_ASSERT(tr_isAtom(b));
-
-    return tr_address_compare(&a->addr, &b->addr);
-}
-
 /* best come first, worst go last */
 static int compareAtomPtrsByShelfDate(void const* va, void const* vb)
 {
@@ -3974,76 +4206,86 @@ static int getMaxAtomCount(tr_torrent const* tor)
     return MIN(50, tor->maxConnectedPeers * 3);
 }
 
-static void atomPulse(evutil_socket_t foo UNUSED, short bar UNUSED, void* vmgr)
+static void pruneAtoms(tr_swarm* s)
 {
-    tr_torrent* tor = NULL;
-    tr_peerMgr* mgr = vmgr;
-    managerLock(mgr);
+    TR_ASSERT(swarmIsLocked(s));
 
-    while ((tor = tr_torrentNext(mgr->session, tor)) != NULL)
+    int atomCount;
+    int const maxAtomCount = getMaxAtomCount(s->tor);
+    struct peer_atom** atoms = (struct peer_atom**)tr_ptrArrayPeek(&s->pool, &atomCount);
+
+    if (atomCount > maxAtomCount) /* we've got too many atoms... time to prune */
     {
-        int atomCount;
-        tr_swarm* s = tor->swarm;
-        int const maxAtomCount = getMaxAtomCount(tor);
-        struct peer_atom** atoms = (struct peer_atom**)tr_ptrArrayPeek(&s->pool, &atomCount);
+        int keepCount = 0;
+        int testCount = 0;
+        struct peer_atom** keep = tr_new(struct peer_atom*, atomCount);
+        struct peer_atom** test = tr_new(struct peer_atom*, atomCount);
 
-        if (atomCount > maxAtomCount) /* we've got too many atoms... time to prune */
+        /* keep the ones that are in use */
+        for (int i = 0; i < atomCount; ++i)
         {
-            int keepCount = 0;
-            int testCount = 0;
-            struct peer_atom** keep = tr_new(struct peer_atom*, atomCount);
-            struct peer_atom** test = tr_new(struct peer_atom*, atomCount);
+            struct peer_atom* atom = atoms[i];
 
-            /* keep the ones that are in use */
-            for (int i = 0; i < atomCount; ++i)
+            if (peerIsInUse(s, atom))
             {
-                struct peer_atom* atom = atoms[i];
-
-                if (peerIsInUse(s, atom))
-                {
-                    keep[keepCount++] = atom;
-                }
-                else
-                {
-                    test[testCount++] = atom;
-                }
+                keep[keepCount++] = atom;
             }
-
-            /* if there's room, keep the best of what's left */
-            int i = 0;
-
-            if (keepCount < maxAtomCount)
+            else
             {
-                qsort(test, testCount, sizeof(struct peer_atom*), compareAtomPtrsByShelfDate);
-
-                while (i < testCount && keepCount < maxAtomCount)
-                {
-                    keep[keepCount++] = test[i++];
-                }
+                test[testCount++] = atom;
             }
+        }
 
-            /* free the culled atoms */
-            while (i < testCount)
-            {
-                tr_free(test[i++]);
-            }
+        /* if there's room, keep the best of what's left.
+           which ones those are matters, but not their order */
+        int i = 0;
+
+        if (keepCount < maxAtomCount)
+        {
+            int const room = maxAtomCount - keepCount;
 
-            /* rebuild Torrent.pool with what's left */
-            tr_ptrArrayDestruct(&s->pool, NULL);
-            s->pool = TR_PTR_ARRAY_INIT;
-            qsort(keep, keepCount, sizeof(struct peer_atom*), compareAtomPtrsByAddress);
+            tr_quickfindFirstK(test, testCount, sizeof(struct peer_atom*), compareAtomPtrsByShelfDate, room);
 
-            for (int i = 0; i < keepCount; ++i)
+            while (i < testCount && keepCount < maxAtomCount)
             {
-                tr_ptrArrayAppend(&s->pool, keep[i]);
+                keep[keepCount++] = test[i++];
             }
+        }
 
-            tordbg(s, "max atom count is %d... pruned from %d to %d\n", maxAtomCount, atomCount, keepCount);
+        /* free the culled atoms */
+        while (i < testCount)
+        {
+            tr_free(test[i++]);
+        }
 
-            /* cleanup */
-            tr_free(test);
-            tr_free(keep);
+        /* rebuild Torrent.pool and its index with what's left */
+        tr_ptrArrayDestruct(&s->pool, NULL);
+        s->pool = TR_PTR_ARRAY_INIT;
+
+        for (int i = 0; i < keepCount; ++i)
+        {
+            tr_ptrArrayAppend(&s->pool, keep[i]);
         }
+
+        atomIndexRebuild(s);
+
+        tordbg(s, "max atom count is %d... pruned from %d to %d\n", maxAtomCount, atomCount, keepCount);
+
+        /* cleanup */
+        tr_free(test);
+        tr_free(keep);
+    }
+}
+
+static void atomPulse(evutil_socket_t foo UNUSED, short bar UNUSED, void* vmgr)
+{
+    tr_torrent* tor = NULL;
+    tr_peerMgr* mgr = vmgr;
+    managerLock(mgr);
+
+    while ((tor = tr_torrentNext(mgr->session, tor)) != NULL)
+    {
+        pruneAtoms(tor->swarm);
     }
 
     tr_timerAddMsec(mgr->atomTimer, ATOM_PERIOD_MSEC);
@@ -124,6 +124,13 @@ void tr_peerMgrTorrentAvailability(tr_torrent const* tor, int8_t* tab, unsigned
 
 uint64_t tr_peerMgrGetDesiredAvailable(tr_torrent const* tor);
 
+/* keep the swarm's desired-available total in sync with the torrent's completion.
+ * delta is the change in a wanted piece's missing bytes, or the piece's missing
+ * bytes when it becomes wanted or unwanted */
+void tr_peerMgrUpdateDesiredAvailable(tr_torrent* tor, tr_piece_index_t piece, int64_t delta);
+
+void tr_peerMgrRecountDesiredAvailable(tr_torrent* tor);
+
 void tr_peerMgrOnTorrentGotMetainfo(tr_torrent* tor);
 
 void tr_peerMgrOnBlocklistChanged(tr_peerMgr* manager);
@@ -1073,27 +1073,82 @@ static void parseLtepHandshake(tr_peerMsgs* msgs, uint32_t len, struct evbuffer*
     tr_free(tmp);
 }
 
+/* the handful of ints at the front of a ut_metadata message */
+struct ut_metadata_header
+{
+    int depth;
+    int64_t msg_type;
+    int64_t piece;
+    int64_t total_size;
+};
+
+static int onUtMetadataInt(char const* key, size_t key_len, int64_t val, void* vheader)
+{
+    tr_quark q;
+    struct ut_metadata_header* header = vheader;
+
+    if (header->depth == 1 && key != NULL && tr_quark_lookup(key, key_len, &q))
+    {
+        if (q == TR_KEY_msg_type)
+        {
+            header->msg_type = val;
+        }
+        else if (q == TR_KEY_piece)
+        {
+            header->piece = val;
+        }
+        else if (q == TR_KEY_total_size)
+        {
+            header->total_size = val;
+        }
+    }
+
+    return 0;
+}
+
+static int onUtMetadataContainerBegin(char const* key UNUSED, size_t key_len UNUSED, void* vheader)
+{
+    ++((struct ut_metadata_header*)vheader)->depth;
+    return 0;
+}
+
+static int onUtMetadataContainerEnd(void* vheader)
+{
+    --((struct ut_metadata_header*)vheader)->depth;
+    return 0;
+}
+
+static tr_variant_benc_funcs const ut_metadata_funcs =
+{
+    onUtMetadataInt,
+    NULL,
+    onUtMetadataContainerBegin,
+    onUtMetadataContainerBegin,
+    onUtMetadataContainerEnd
+};
+
 static void parseUtMetadata(tr_peerMsgs* msgs, uint32_t msglen, struct evbuffer* inbuf)
 {
-    tr_variant dict;
     char* msg_end;
-    char const* benc_end;
-    int64_t msg_type = -1;
-    int64_t piece = -1;
-    int64_t total_size = 0;
+    char const* benc_end = NULL;
+    struct ut_metadata_header header = { 0, -1, -1, 0 };
     uint8_t* tmp = tr_new(uint8_t, msglen);
 
     tr_peerIoReadBytes(msgs->io, inbuf, tmp, msglen);
     msg_end = (char*)tmp + msglen;
 
-    if (tr_variantFromBencFull(&dict, tmp, msglen, NULL, &benc_end) == 0)
+    /* walk the header instead of building a dict just to read three ints from it */
+    if (tr_variantWalkBenc(tmp, msglen, &ut_metadata_funcs, &header, &benc_end) != 0)
     {
-        (void)tr_variantDictFindInt(&dict, TR_KEY_msg_type, &msg_type);
-        (void)tr_variantDictFindInt(&dict, TR_KEY_piece, &piece);
-        (void)tr_variantDictFindInt(&dict, TR_KEY_total_size, &total_size);
-        tr_variantFree(&dict);
+        header.msg_type = -1;
+        header.piece = -1;
+        header.total_size = 0;
     }
 
+    int64_t const msg_type = header.msg_type;
+    int64_t const piece = header.piece;
+    int64_t const total_size = header.total_size;
+
     dbgmsg(msgs, "got ut_metadata msg: type %d, piece %d, total_size %d", (int)msg_type, (int)piece, (int)total_size);
 
     if (msg_type == METADATA_MSG_TYPE_REJECT)
@@ -1155,13 +1210,16 @@ static void parseUtPex(tr_peerMsgs* msgs, uint32_t msglen, struct evbuffer* inbu
     uint8_t* tmp = tr_new(uint8_t, msglen);
     tr_peerIoReadBytes(msgs->io, inbuf, tmp, msglen);
 
+    /* the compact peer strings are only read with their lengths, so they
+       can be referenced in place from `tmp' rather than copied */
     tr_variant val;
-    bool const loaded = tr_variantFromBenc(&val, tmp, msglen) == 0;
-
-    tr_free(tmp);
+    tr_variant_arena* arena = tr_variantArenaNew();
+    bool const loaded = tr_variantFromBencArena(&val, arena, tmp, msglen, true, NULL) == 0;
 
     if (!loaded)
     {
+        tr_variantArenaFree(arena);
+        tr_free(tmp);
         return;
     }
 
@@ -1232,7 +1290,8 @@ static void parseUtPex(tr_peerMsgs* msgs, uint32_t msglen, struct evbuffer* inbu
         tr_free(pex);
     }
 
-    tr_variantFree(&val);
+    tr_variantArenaFree(arena);
+    tr_free(tmp);
 }
 
 static void sendPex(tr_peerMsgs* msgs);
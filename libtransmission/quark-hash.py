@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#
+# This file Copyright (C) 2017 Mnemosyne LLC
+#
+# It may be used under the GNU GPL versions 2 or 3
+# or any future license endorsed by Mnemosyne LLC.
+#
+# Regenerates the minimal perfect hash of quark.c's static quarks.
+# Run it from anywhere after adding or removing a key in my_static:
+#
+#     python3 libtransmission/quark-hash.py
+#
+# The tables are rewritten in place, between the "BEGIN/END GENERATED"
+# markers. quark-test fails if they're out of date.
+
+import os
+import re
+import sys
+
+LOAD_FACTOR = 2  # keys per bucket
+
+path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "quark.c")
+source = open(path, encoding="utf-8").read()
+
+static = re.search(r"my_static\[\] =\n\{\n(.*?)\n\};", source, re.S).group(1)
+keys = [m.encode() for m in re.findall(r'Q\("(.*)"\)', static)]
+
+
+def quark_mix(h):
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & 0xffffffff
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & 0xffffffff
+    h ^= h >> 16
+    return h
+
+
+# keep in sync with quark_hash() in quark.c
+def quark_hash(key):
+    h = 2166136261
+
+    for ch in key:
+        h ^= ch
+        h = (h * 16777619) & 0xffffffff
+
+    return quark_mix(h)
+
+
+def quark_slot(h, seed, n_keys):
+    return quark_mix(h ^ ((seed * 0x9e3779b9) & 0xffffffff)) % n_keys
+
+
+n_keys = len(keys)
+n_buckets = (n_keys + LOAD_FACTOR - 1) // LOAD_FACTOR
+buckets = [[] for _ in range(n_buckets)]
+
+hashes = [quark_hash(key) for key in keys]
+
+for q, h in enumerate(hashes):
+    buckets[h % n_buckets].append(q)
+
+seeds = [0] * n_buckets
+slots = [None] * n_keys
+
+# place the biggest buckets first, while there's the most room
+for b in sorted(range(n_buckets), key=lambda b: -len(buckets[b])):
+    if not buckets[b]:
+        continue
+
+    for seed in range(1, 0x10000):
+        wanted = [quark_slot(hashes[q], seed, n_keys) for q in buckets[b]]
+
+        if len(set(wanted)) == len(wanted) and all(slots[s] is None for s in wanted):
+            break
+    else:
+        sys.exit("couldn't find a seed for bucket %d" % b)
+
+    seeds[b] = seed
+
+    for q, s in zip(buckets[b], wanted):
+        slots[s] = q
+
+
+def format_array(decl, values):
+    lines = []
+    line = "   "
+
+    for v in values:
+        item = " %d," % v
+
+        if len(line) + len(item) > 120:
+            lines.append(line)
+            line = "   "
+
+        line += item
+
+    lines.append(line[:-1])
+    return "static %s[] =\n{\n%s\n};\n" % (decl, "\n".join(lines))
+
+
+generated = "".join([
+    "/* BEGIN GENERATED by quark-hash.py */\n",
+    "\n",
+    "#define QUARK_HASH_BUCKETS %d\n" % n_buckets,
+    "\n",
+    format_array("uint16_t const my_static_seeds", seeds),
+    "\n",
+    format_array("uint16_t const my_static_slots", slots),
+    "\n",
+    "/* END GENERATED */",
+])
+
+source = re.sub(r"/\* BEGIN GENERATED by quark-hash\.py \*/.*?/\* END GENERATED \*/", lambda m: generated, source,
+    flags=re.S)
+open(path, "w", encoding="utf-8").write(source)
@@ -10,6 +10,7 @@
 
 #include "transmission.h"
 #include "quark.h"
+#include "utils.h" /* tr_strdup_printf() */
 #include "libtransmission-test.h"
 
 static int test_static_quarks(void)
@@ -46,4 +47,57 @@ static int test_static_quarks(void)
     return 0;
 }
 
-MAIN_SINGLE_TEST(test_static_quarks)
+static int test_runtime_quarks(void)
+{
+    tr_quark q;
+    tr_quark first = TR_KEY_NONE;
+
+    check(!tr_quark_lookup("not a static quark", 18, &q));
+
+    /* enough to make the runtime index grow a few times */
+    for (int i = 0; i < 1000; ++i)
+    {
+        char* str = tr_strdup_printf("runtime-quark-%d", i);
+
+        q = tr_quark_new(str, TR_BAD_SIZE);
+        check_int((int)q, >=, TR_N_KEYS);
+        check_str(tr_quark_get_string(q, NULL), ==, str);
+
+        if (i == 0)
+        {
+            first = q;
+        }
+
+        tr_free(str);
+    }
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        char* str = tr_strdup_printf("runtime-quark-%d", i);
+
+        check(tr_quark_lookup(str, strlen(str), &q));
+        check_int((int)q, ==, (int)first + i);
+        check_int((int)tr_quark_new(str, TR_BAD_SIZE), ==, (int)q);
+
+        tr_free(str);
+    }
+
+    /* prefixes and static quarks aren't confused with them */
+    check(!tr_quark_lookup("runtime-quark-", 14, &q));
+    check(tr_quark_lookup("version", 7, &q));
+    check_int((int)q, ==, TR_KEY_version);
+    check(!tr_quark_lookup("versio", 6, &q));
+
+    return 0;
+}
+
+int main(void)
+{
+    testFunc const tests[] =
+    {
+        test_static_quarks,
+        test_runtime_quarks
+    };
+
+    return runTests(tests, NUM_TESTS(tests));
+}
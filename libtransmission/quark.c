@@ -6,7 +6,6 @@
  *
  */
 
-#include <stdlib.h> /* bsearch() */
 #include <string.h> /* memcmp() */
 
 #include "transmission.h"
@@ -120,6 +119,7 @@ static struct tr_key_struct const my_static[] =
     Q("files-unwanted"),
     Q("files-wanted"),
     Q("filesAdded"),
+    Q("filter-label"),
     Q("filter-mode"),
     Q("filter-text"),
     Q("filter-trackers"),
@@ -180,6 +180,7 @@ static struct tr_key_struct const my_static[] =
     Q("leecherCount"),
     Q("leftUntilDone"),
     Q("length"),
+    Q("limit"),
     Q("location"),
     Q("lpd-enabled"),
     Q("m"),
@@ -212,6 +213,7 @@ static struct tr_key_struct const my_static[] =
     Q("nextScrapeTime"),
     Q("nodes"),
     Q("nodes6"),
+    Q("offset"),
     Q("open-dialog-dir"),
     Q("p"),
     Q("path"),
@@ -293,6 +295,7 @@ static struct tr_key_struct const my_static[] =
     Q("rpc-enabled"),
     Q("rpc-host-whitelist"),
     Q("rpc-host-whitelist-enabled"),
+    Q("rpc-idle-timeout"),
     Q("rpc-password"),
     Q("rpc-port"),
     Q("rpc-url"),
@@ -365,6 +368,7 @@ static struct tr_key_struct const my_static[] =
     Q("torrentCount"),
     Q("torrentFile"),
     Q("torrents"),
+    Q("total"),
     Q("totalSize"),
     Q("total_size"),
     Q("tracker id"),
@@ -409,64 +413,166 @@ static struct tr_key_struct const my_static[] =
 
 #undef Q
 
-static int compareKeys(void const* va, void const* vb)
+/***
+****  The static quarks are found with a minimal perfect hash ("hash and
+****  displace"): a key's hash picks a bucket, whose seed displaces the
+****  hash to the key's own slot, so a lookup is one pass over the string
+****  and a single memcmp().
+****  The tables are generated by quark-hash.py from my_static.
+***/
+
+/* BEGIN GENERATED by quark-hash.py */
+
+#define QUARK_HASH_BUCKETS 193
+
+static uint16_t const my_static_seeds[] =
 {
-    int ret;
-    struct tr_key_struct const* a = va;
-    struct tr_key_struct const* b = vb;
+    8, 2, 4, 9, 9, 5, 1, 5, 1, 12, 2, 8, 1, 4, 9, 12, 1, 0, 0, 9, 1, 3, 3, 8, 5, 0, 1, 1, 2, 1, 1, 13, 5, 5, 6, 1, 6, 2,
+    2, 1, 2, 5, 6, 0, 9, 20, 6, 10, 1, 0, 14, 3, 0, 11, 0, 1, 9, 0, 2, 2, 0, 1, 4, 1, 15, 0, 17, 0, 12, 6, 9, 0, 17, 0,
+    3, 7, 4, 8, 3, 6, 5, 9, 12, 18, 2, 4, 1, 8, 4, 5, 6, 0, 7, 22, 0, 3, 1, 0, 1, 9, 0, 7, 3, 1, 14, 1, 47, 22, 5, 10,
+    0, 4, 2, 61, 4, 7, 7, 0, 7, 10, 8, 1, 1, 2, 4, 57, 6, 4, 0, 21, 1, 18, 1, 79, 9, 5, 8, 1, 2, 6, 0, 7, 4, 39, 15, 4,
+    3, 2, 2, 2, 4, 35, 6, 0, 0, 4, 103, 53, 0, 44, 20, 46, 63, 3, 46, 2, 9, 9, 62, 2, 44, 19, 1, 64, 9, 1, 13, 8, 1, 44,
+    0, 9, 3, 30, 44, 2, 192, 87, 4, 45, 6, 573, 29
+};
 
-    ret = memcmp(a->str, b->str, MIN(a->len, b->len));
+static uint16_t const my_static_slots[] =
+{
+    367, 275, 148, 102, 267, 112, 199, 159, 356, 178, 328, 182, 359, 307, 284, 271, 249, 353, 253, 155, 165, 160, 78,
+    57, 135, 83, 354, 190, 314, 357, 280, 220, 358, 18, 79, 63, 243, 137, 107, 52, 217, 2, 341, 109, 381, 86, 115, 33,
+    167, 20, 216, 58, 39, 5, 49, 71, 87, 161, 132, 296, 149, 110, 245, 34, 25, 100, 69, 185, 237, 225, 55, 158, 378,
+    111, 350, 236, 270, 32, 268, 181, 200, 368, 261, 263, 1, 363, 131, 144, 176, 15, 282, 228, 84, 265, 229, 43, 246, 9,
+    65, 278, 334, 153, 117, 156, 23, 343, 138, 94, 93, 373, 50, 352, 76, 164, 75, 364, 288, 70, 214, 203, 233, 255, 192,
+    286, 221, 327, 329, 339, 313, 316, 351, 123, 152, 366, 311, 60, 139, 294, 197, 374, 174, 264, 186, 204, 133, 62,
+    326, 90, 380, 338, 372, 184, 219, 128, 321, 312, 269, 88, 297, 82, 193, 231, 209, 287, 298, 342, 97, 113, 81, 29,
+    92, 309, 179, 259, 345, 323, 257, 22, 310, 277, 336, 104, 136, 332, 208, 371, 173, 340, 41, 17, 274, 180, 251, 168,
+    240, 266, 276, 27, 281, 89, 375, 40, 206, 147, 30, 61, 362, 7, 241, 218, 213, 348, 67, 37, 74, 127, 143, 31, 101,
+    134, 21, 201, 48, 11, 177, 141, 306, 370, 317, 337, 72, 384, 224, 140, 300, 120, 365, 77, 222, 3, 320, 151, 118,
+    207, 126, 289, 227, 80, 172, 360, 122, 346, 379, 349, 198, 145, 66, 247, 130, 26, 106, 16, 36, 303, 105, 8, 114,
+    210, 119, 56, 376, 53, 232, 330, 382, 238, 170, 73, 166, 175, 234, 98, 19, 54, 325, 0, 377, 295, 42, 146, 188, 13,
+    260, 121, 99, 202, 125, 163, 226, 191, 262, 35, 45, 256, 85, 205, 95, 116, 194, 51, 169, 64, 331, 211, 242, 171,
+    239, 252, 91, 47, 162, 195, 187, 369, 38, 315, 124, 223, 248, 212, 254, 283, 335, 304, 59, 10, 108, 157, 319, 383,
+    103, 46, 129, 154, 215, 344, 142, 14, 293, 28, 347, 189, 361, 44, 68, 244, 279, 322, 273, 318, 196, 150, 302, 230,
+    24, 290, 235, 4, 308, 305, 285, 301, 299, 324, 6, 355, 272, 291, 258, 183, 250, 12, 96, 333, 292
+};
 
-    if (ret == 0 && a->len != b->len)
+/* END GENERATED */
+
+/* MurmurHash3's finalizer */
+static inline uint32_t quark_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/* FNV-1a. Keep in sync with quark_hash() in quark-hash.py */
+static uint32_t quark_hash(void const* str, size_t len)
+{
+    uint8_t const* walk = str;
+    uint32_t h = 2166136261U;
+
+    for (size_t i = 0; i < len; ++i)
     {
-        ret = a->len < b->len ? -1 : 1;
+        h ^= walk[i];
+        h *= 16777619U;
     }
 
-    return ret;
+    return quark_mix(h);
+}
+
+static inline bool keyEquals(struct tr_key_struct const* key, void const* str, size_t len)
+{
+    return key->len == len && memcmp(key->str, str, len) == 0;
+}
+
+static bool static_quark_lookup(void const* str, size_t len, tr_quark* setme)
+{
+    uint32_t const h = quark_hash(str, len);
+    uint32_t const seed = my_static_seeds[h % QUARK_HASH_BUCKETS];
+    tr_quark const q = my_static_slots[quark_mix(h ^ seed * 0x9e3779b9U) % TR_N_KEYS];
+
+    if (!keyEquals(&my_static[q], str, len))
+    {
+        return false;
+    }
+
+    *setme = q;
+    return true;
 }
 
+/***
+****  Runtime quarks are indexed by an open-addressed hash table
+****  of quarks, where 0 (TR_KEY_NONE, a static quark) means an empty slot
+***/
+
 static tr_ptrArray my_runtime = TR_PTR_ARRAY_INIT_STATIC;
+static tr_quark* my_runtime_index = NULL;
+static size_t my_runtime_index_size = 0; /* a power of two */
 
-bool tr_quark_lookup(void const* str, size_t len, tr_quark* setme)
+static size_t runtime_index_find(void const* str, size_t len)
 {
-    static size_t const n_static = TR_N_ELEMENTS(my_static);
+    size_t const mask = my_runtime_index_size - 1;
+    size_t i = quark_hash(str, len) & mask;
 
-    TR_ASSERT(n_static == TR_N_KEYS);
+    while (my_runtime_index[i] != TR_KEY_NONE &&
+        !keyEquals(tr_ptrArrayNth(&my_runtime, my_runtime_index[i] - TR_N_KEYS), str, len))
+    {
+        i = (i + 1) & mask;
+    }
 
-    struct tr_key_struct tmp;
-    struct tr_key_struct* match;
-    bool success = false;
+    return i;
+}
 
-    tmp.str = str;
-    tmp.len = len;
+static void runtime_index_add(tr_quark q)
+{
+    struct tr_key_struct const* key = tr_ptrArrayNth(&my_runtime, q - TR_N_KEYS);
 
-    /* is it in our static array? */
-    match = bsearch(&tmp, my_static, n_static, sizeof(struct tr_key_struct), compareKeys);
+    /* keep it at most half full */
+    if ((size_t)tr_ptrArraySize(&my_runtime) * 2 > my_runtime_index_size)
+    {
+        size_t const n = tr_ptrArraySize(&my_runtime) - 1;
+
+        my_runtime_index_size = my_runtime_index_size == 0 ? 64 : my_runtime_index_size * 2;
+        tr_free(my_runtime_index);
+        my_runtime_index = tr_new0(tr_quark, my_runtime_index_size);
 
-    if (match != NULL)
+        for (size_t i = 0; i < n; ++i)
+        {
+            struct tr_key_struct const* old = tr_ptrArrayNth(&my_runtime, i);
+            my_runtime_index[runtime_index_find(old->str, old->len)] = TR_N_KEYS + i;
+        }
+    }
+
+    my_runtime_index[runtime_index_find(key->str, key->len)] = q;
+}
+
+bool tr_quark_lookup(void const* str, size_t len, tr_quark* setme)
+{
+    TR_ASSERT(TR_N_ELEMENTS(my_static) == TR_N_KEYS);
+    TR_ASSERT(TR_N_ELEMENTS(my_static_slots) == TR_N_KEYS); /* run quark-hash.py */
+
+    /* is it in our static array? */
+    if (static_quark_lookup(str, len, setme))
     {
-        *setme = match - my_static;
-        success = true;
+        return true;
     }
 
     /* was it added during runtime? */
-    if (!success && !tr_ptrArrayEmpty(&my_runtime))
+    if (my_runtime_index != NULL)
     {
-        struct tr_key_struct** runtime = (struct tr_key_struct**)tr_ptrArrayBase(&my_runtime);
-        size_t const n_runtime = tr_ptrArraySize(&my_runtime);
+        tr_quark const q = my_runtime_index[runtime_index_find(str, len)];
 
-        for (size_t i = 0; i < n_runtime; ++i)
+        if (q != TR_KEY_NONE)
         {
-            if (compareKeys(&tmp, runtime[i]) == 0)
-            {
-                *setme = TR_N_KEYS + i;
-                success = true;
-                break;
-            }
+            *setme = q;
+            return true;
         }
     }
 
-    return success;
+    return false;
 }
 
 static tr_quark append_new_quark(void const* str, size_t len)
@@ -478,6 +584,7 @@ static tr_quark append_new_quark(void const* str, size_t len)
     tmp->len = len;
     ret = TR_N_KEYS + tr_ptrArraySize(&my_runtime);
     tr_ptrArrayAppend(&my_runtime, tmp);
+    runtime_index_add(ret);
     return ret;
 }
 
@@ -120,6 +120,7 @@ enum
     TR_KEY_files_unwanted,
     TR_KEY_files_wanted,
     TR_KEY_filesAdded,
+    TR_KEY_filter_label,
     TR_KEY_filter_mode,
     TR_KEY_filter_text,
     TR_KEY_filter_trackers,
@@ -180,6 +181,7 @@ enum
     TR_KEY_leecherCount,
     TR_KEY_leftUntilDone,
     TR_KEY_length,
+    TR_KEY_limit,
     TR_KEY_location,
     TR_KEY_lpd_enabled,
     TR_KEY_m,
@@ -212,6 +214,7 @@ enum
     TR_KEY_nextScrapeTime,
     TR_KEY_nodes,
     TR_KEY_nodes6,
+    TR_KEY_offset,
     TR_KEY_open_dialog_dir,
     TR_KEY_p,
     TR_KEY_path,
@@ -293,6 +296,7 @@ enum
     TR_KEY_rpc_enabled,
     TR_KEY_rpc_host_whitelist,
     TR_KEY_rpc_host_whitelist_enabled,
+    TR_KEY_rpc_idle_timeout,
     TR_KEY_rpc_password,
     TR_KEY_rpc_port,
     TR_KEY_rpc_url,
@@ -365,6 +369,7 @@ enum
     TR_KEY_torrentCount,
     TR_KEY_torrentFile,
     TR_KEY_torrents,
+    TR_KEY_total,
     TR_KEY_totalSize,
     TR_KEY_total_size,
     TR_KEY_tracker_id,
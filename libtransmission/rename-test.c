@@ -14,6 +14,7 @@
 #include "crypto-utils.h"
 #include "file.h"
 #include "resume.h"
+#include "strpool.h"
 #include "torrent.h" /* tr_isTorrent() */
 #include "tr-assert.h"
 #include "variant.h"
@@ -357,8 +358,8 @@ static int test_multifile_torrent(void)
     /* (while the branch is renamed: confirm that the .resume file remembers the changes) */
     tr_torrentSaveResume(tor);
     /* this is a bit dodgy code-wise, but let's make sure the .resume file got the name */
-    tr_free(files[1].name);
-    tor->info.files[1].name = tr_strdup("gabba gabba hey");
+    tr_strpoolRelease(files[1].name);
+    tor->info.files[1].name = tr_strpoolAcquire("gabba gabba hey", TR_BAD_SIZE);
     loaded = tr_torrentLoadResume(tor, ~0, ctor, NULL);
     check_uint((loaded & TR_FR_FILENAMES), !=, 0);
     check_str(files[0].name, ==, expected_files[0]);
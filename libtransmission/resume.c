@@ -18,6 +18,7 @@
 #include "platform.h" /* tr_getResumeDir() */
 #include "resume.h"
 #include "session.h"
+#include "strpool.h"
 #include "torrent.h"
 #include "tr-assert.h"
 #include "utils.h" /* tr_buildPath */
@@ -241,15 +242,25 @@ static uint64_t loadFilePriorities(tr_variant* dict, tr_torrent* tor)
     if (tr_variantDictFindList(dict, TR_KEY_priority, &list) && tr_variantListSize(list) == n)
     {
         int64_t priority;
+        tr_file_index_t* files = tr_new(tr_file_index_t, n);
 
-        for (tr_file_index_t i = 0; i < n; ++i)
+        /* set them a priority at a time, so shared pieces are only recalculated once */
+        for (tr_priority_t p = TR_PRI_LOW; p <= TR_PRI_HIGH; ++p)
         {
-            if (tr_variantGetInt(tr_variantListChild(list, i), &priority))
+            tr_file_index_t fileCount = 0;
+
+            for (tr_file_index_t i = 0; i < n; ++i)
             {
-                tr_torrentInitFilePriority(tor, i, priority);
+                if (tr_variantGetInt(tr_variantListChild(list, i), &priority) && priority == p)
+                {
+                    files[fileCount++] = i;
+                }
             }
+
+            tr_torrentInitFilePriorities(tor, files, fileCount, p);
         }
 
+        tr_free(files);
         ret = TR_FR_FILE_PRIORITIES;
     }
 
@@ -458,8 +469,8 @@ static uint64_t loadFilenames(tr_variant* dict, tr_torrent* tor)
 
             if (tr_variantGetStr(tr_variantListChild(list, i), &str, &str_len) && str != NULL && str_len != 0)
             {
-                tr_free(files[i].name);
-                files[i].name = tr_strndup(str, str_len);
+                tr_strpoolRelease(files[i].name);
+                files[i].name = tr_strpoolAcquire(str, str_len);
                 files[i].is_renamed = true;
             }
         }
@@ -516,20 +527,20 @@ static void saveProgress(tr_variant* dict, tr_torrent* tor)
         /* get the oldest and newest nonzero timestamps for pieces in this file */
         for (tr_piece_index_t i = f->firstPiece; i <= f->lastPiece; ++i)
         {
-            tr_piece const* const p = &inf->pieces[i];
+            time_t const timeChecked = inf->pieceTimeChecked[i];
 
-            if (p->timeChecked == 0)
+            if (timeChecked == 0)
             {
                 has_zero = true;
             }
-            else if (oldest_nonzero > p->timeChecked)
+            else if (oldest_nonzero > timeChecked)
             {
-                oldest_nonzero = p->timeChecked;
+                oldest_nonzero = timeChecked;
             }
 
-            if (newest < p->timeChecked)
+            if (newest < timeChecked)
             {
-                newest = p->timeChecked;
+                newest = timeChecked;
             }
         }
 
@@ -558,9 +569,9 @@ static void saveProgress(tr_variant* dict, tr_torrent* tor)
 
             for (tr_piece_index_t i = f->firstPiece; i <= f->lastPiece; ++i)
             {
-                tr_piece const* const p = &inf->pieces[i];
+                time_t const timeChecked = inf->pieceTimeChecked[i];
 
-                tr_variantListAddInt(ll, p->timeChecked != 0 ? p->timeChecked - offset : 0);
+                tr_variantListAddInt(ll, timeChecked != 0 ? timeChecked - offset : 0);
             }
         }
     }
@@ -581,10 +592,7 @@ static uint64_t loadProgress(tr_variant* dict, tr_torrent* tor)
     tr_variant* prog;
     tr_info const* inf = tr_torrentInfo(tor);
 
-    for (size_t i = 0; i < inf->pieceCount; ++i)
-    {
-        inf->pieces[i].timeChecked = 0;
-    }
+    memset(inf->pieceTimeChecked, 0, sizeof(time_t) * inf->pieceCount);
 
     if (tr_variantDictFindDict(dict, TR_KEY_progress, &prog))
     {
@@ -621,7 +629,7 @@ static uint64_t loadProgress(tr_variant* dict, tr_torrent* tor)
 
                     for (tr_piece_index_t i = f->firstPiece; i <= f->lastPiece; ++i)
                     {
-                        inf->pieces[i].timeChecked = (time_t)t;
+                        inf->pieceTimeChecked[i] = (time_t)t;
                     }
                 }
                 else if (tr_variantIsList(b))
@@ -635,7 +643,7 @@ static uint64_t loadProgress(tr_variant* dict, tr_torrent* tor)
                     {
                         int64_t t = 0;
                         tr_variantGetInt(tr_variantListChild(b, i + 1), &t);
-                        inf->pieces[f->firstPiece + i].timeChecked = (time_t)(t != 0 ? t + offset : 0);
+                        inf->pieceTimeChecked[f->firstPiece + i] = (time_t)(t != 0 ? t + offset : 0);
                     }
                 }
             }
@@ -658,7 +666,7 @@ static uint64_t loadProgress(tr_variant* dict, tr_torrent* tor)
 
                     for (tr_piece_index_t i = f->firstPiece; i <= f->lastPiece; ++i)
                     {
-                        inf->pieces[i].timeChecked = timeChecked;
+                        inf->pieceTimeChecked[i] = timeChecked;
                     }
                 }
             }
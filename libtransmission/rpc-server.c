@@ -7,6 +7,7 @@
  */
 
 #include <errno.h>
+#include <stdlib.h> /* qsort() */
 #include <string.h> /* memcpy */
 
 #include <zlib.h>
@@ -15,6 +16,7 @@
 #include <event2/event.h>
 #include <event2/http.h>
 #include <event2/http_struct.h> /* TODO: eventually remove this */
+#include <event2/keyvalq_struct.h>
 
 #include "transmission.h"
 #include "crypto.h" /* tr_ssha1_matches() */
@@ -30,6 +32,7 @@
 #include "rpc-server.h"
 #include "session.h"
 #include "session-id.h"
+#include "torrent.h"
 #include "tr-assert.h"
 #include "trevent.h"
 #include "utils.h"
@@ -52,6 +55,7 @@ struct tr_rpc_server
     bool isPasswordEnabled;
     bool isWhitelistEnabled;
     bool isHostWhitelistEnabled;
+    int idleTimeoutSecs; /* how long a kept-alive connection may sit idle; 0 for libevent's default */
     tr_port port;
     char* url;
     struct tr_address bindAddress;
@@ -68,6 +72,16 @@ struct tr_rpc_server
 
     bool isStreamInitialized;
     z_stream stream;
+
+    tr_ptrArray webAssets; /* struct web_asset*, sorted by filename */
+
+    tr_ptrArray eventClients; /* struct event_client* */
+    struct event* eventTimer;
+    struct torrent_snapshot* snapshots; /* sorted by id */
+    size_t snapshotCount;
+    int eventDownloadSpeed;
+    int eventUploadSpeed;
+    time_t eventLastSent;
 };
 
 #define dbgmsg(...) tr_logAddDeepNamed(MY_NAME, __VA_ARGS__)
@@ -294,12 +308,98 @@ static char const* mimetype_guess(char const* path)
     return "application/octet-stream";
 }
 
+/* responses smaller than this go out as-is; the gzip framing and
+ * the deflate() call cost more than the few bytes it could save */
+#define RPC_COMPRESS_MIN_SIZE 1024
+
+/* deflate() output is written into `out' in pieces of this size */
+#define RPC_COMPRESS_CHUNK_SIZE (16 * 1024)
+
+/* Pick a compression level for a response of `content_len' bytes.
+ * Small responses are cheap enough to squeeze hard, but a torrent-get
+ * on a big session can run to megabytes of very repetitive JSON, which
+ * the faster levels already shrink nearly as well at a fraction of
+ * the CPU time that the daemon would otherwise spend on it. */
+static int get_compression_level(size_t content_len)
+{
+#ifdef TR_LIGHTWEIGHT
+
+    (void)content_len;
+
+    return Z_BEST_SPEED;
+
+#else
+
+    if (content_len >= 1024 * 1024)
+    {
+        return Z_BEST_SPEED;
+    }
+
+    if (content_len >= 64 * 1024)
+    {
+        return 4;
+    }
+
+    return Z_BEST_COMPRESSION;
+
+#endif
+}
+
+/* Run `content' through deflate() chain by chain, straight from the
+ * evbuffer's own memory, appending the output to `out' as it's made.
+ * Returns true if the whole stream was written. */
+static bool compress_response(z_stream* stream, struct evbuffer* out, struct evbuffer* content)
+{
+    int const n_vec = evbuffer_peek(content, -1, NULL, NULL, 0);
+    struct evbuffer_iovec* vec = tr_new(struct evbuffer_iovec, n_vec);
+    int state = Z_OK;
+
+    evbuffer_peek(content, -1, NULL, vec, n_vec);
+
+    for (int i = 0; i <= n_vec && state == Z_OK; ++i)
+    {
+        bool const is_last = i == n_vec;
+        int const flush = is_last ? Z_FINISH : Z_NO_FLUSH;
+
+        stream->next_in = is_last ? NULL : vec[i].iov_base;
+        stream->avail_in = is_last ? 0 : vec[i].iov_len;
+
+        /* with Z_NO_FLUSH, deflate() has consumed all its input once it
+         * stops filling the output buffer; with Z_FINISH, it's done when
+         * it says so */
+        do
+        {
+            struct evbuffer_iovec iovec[1];
+
+            evbuffer_reserve_space(out, RPC_COMPRESS_CHUNK_SIZE, iovec, 1);
+            stream->next_out = iovec[0].iov_base;
+            stream->avail_out = iovec[0].iov_len;
+            state = deflate(stream, flush);
+            iovec[0].iov_len -= stream->avail_out;
+            evbuffer_commit_space(out, iovec, 1);
+
+            /* Z_BUF_ERROR isn't fatal: it only means no progress was possible,
+             * e.g. on an empty chunk, so move on and feed it more input */
+            if (state == Z_BUF_ERROR && !is_last)
+            {
+                state = Z_OK;
+                break;
+            }
+        }
+        while (state == Z_OK && (is_last || stream->avail_out == 0));
+    }
+
+    tr_free(vec);
+    return state == Z_STREAM_END;
+}
+
 static void add_response(struct evhttp_request* req, struct tr_rpc_server* server, struct evbuffer* out,
     struct evbuffer* content)
 {
     char const* key = "Accept-Encoding";
     char const* encoding = evhttp_find_header(req->input_headers, key);
-    bool const do_compress = encoding != NULL && strstr(encoding, "gzip") != NULL;
+    size_t const content_len = evbuffer_get_length(content);
+    bool const do_compress = content_len >= RPC_COMPRESS_MIN_SIZE && encoding != NULL && strstr(encoding, "gzip") != NULL;
 
     if (!do_compress)
     {
@@ -307,15 +407,12 @@ static void add_response(struct evhttp_request* req, struct tr_rpc_server* serve
     }
     else
     {
-        int state;
-        struct evbuffer_iovec iovec[1];
-        void* content_ptr = evbuffer_pullup(content, -1);
-        size_t const content_len = evbuffer_get_length(content);
+        int const level = get_compression_level(content_len);
+        struct evbuffer* gz = evbuffer_new();
+        bool compressed;
 
         if (!server->isStreamInitialized)
         {
-            int compressionLevel;
-
             server->isStreamInitialized = true;
             server->stream.zalloc = (alloc_func)Z_NULL;
             server->stream.zfree = (free_func)Z_NULL;
@@ -323,46 +420,36 @@ static void add_response(struct evhttp_request* req, struct tr_rpc_server* serve
 
             /* zlib's manual says: "Add 16 to windowBits to write a simple gzip header
              * and trailer around the compressed data instead of a zlib wrapper." */
-#ifdef TR_LIGHTWEIGHT
-            compressionLevel = Z_DEFAULT_COMPRESSION;
-#else
-            compressionLevel = Z_BEST_COMPRESSION;
-#endif
-            deflateInit2(&server->stream, compressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            deflateInit2(&server->stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
         }
-
-        server->stream.next_in = content_ptr;
-        server->stream.avail_in = content_len;
-
-        /* allocate space for the raw data and call deflate() just once --
-         * we won't use the deflated data if it's longer than the raw data,
-         * so it's okay to let deflate() run out of output buffer space */
-        evbuffer_reserve_space(out, content_len, iovec, 1);
-        server->stream.next_out = iovec[0].iov_base;
-        server->stream.avail_out = iovec[0].iov_len;
-        state = deflate(&server->stream, Z_FINISH);
-
-        if (state == Z_STREAM_END)
+        else
         {
-            iovec[0].iov_len -= server->stream.avail_out;
+            /* the stream was reset after its last use, so nothing's pending */
+            deflateParams(&server->stream, level, Z_DEFAULT_STRATEGY);
+        }
+
+        compressed = compress_response(&server->stream, gz, content);
+        deflateReset(&server->stream);
 
 #if 0
 
-            fprintf(stderr, "compressed response is %.2f of original (raw==%zu bytes; compressed==%zu)\n",
-                (double)evbuffer_get_length(out) / content_len, content_len, evbuffer_get_length(out));
+        fprintf(stderr, "compressed response is %.2f of original (raw==%zu bytes; compressed==%zu; level==%d)\n",
+            (double)evbuffer_get_length(gz) / content_len, content_len, evbuffer_get_length(gz), level);
 
 #endif
 
+        /* we won't use the deflated data if it's no smaller than the raw data */
+        if (compressed && evbuffer_get_length(gz) < content_len)
+        {
             evhttp_add_header(req->output_headers, "Content-Encoding", "gzip");
+            evbuffer_add_buffer(out, gz);
         }
         else
         {
-            memcpy(iovec[0].iov_base, content_ptr, content_len);
-            iovec[0].iov_len = content_len;
+            evbuffer_add_buffer(out, content);
         }
 
-        evbuffer_commit_space(out, iovec, 1);
-        deflateReset(&server->stream);
+        evbuffer_free(gz);
     }
 }
 
@@ -376,9 +463,188 @@ static void add_time_header(struct evkeyvalq* headers, char const* key, time_t v
     evhttp_add_header(headers, key, buf);
 }
 
-static void evbuffer_ref_cleanup_tr_free(void const* data UNUSED, size_t datalen UNUSED, void* extra)
+/***
+****  The web client's files are kept in memory, both as-is and gzipped,
+****  so that page loads don't hit the disk or run deflate() every time.
+****  A file is reloaded when its mtime or size changes.
+***/
+
+/* the web client is a handful of small files; don't pin anything big */
+#define MAX_CACHED_WEB_ASSET_SIZE (4 * 1024 * 1024)
+
+struct web_asset
+{
+    char* filename;
+    char const* mimetype;
+    time_t mtime;
+    uint64_t size;
+    char etag[64];
+
+    void* raw;
+    size_t raw_len;
+    void* gzip; /* NULL if compressing didn't make it smaller */
+    size_t gzip_len;
+
+    /* one for the cache, plus one per response still being sent */
+    int refcount;
+};
+
+static void web_asset_unref(struct web_asset* asset)
+{
+    if (--asset->refcount == 0)
+    {
+        tr_free(asset->gzip);
+        tr_free(asset->raw);
+        tr_free(asset->filename);
+        tr_free(asset);
+    }
+}
+
+static void web_asset_ref_cleanup(void const* data UNUSED, size_t datalen UNUSED, void* vasset)
+{
+    web_asset_unref(vasset);
+}
+
+static int compare_web_asset_to_filename(void const* va, void const* vb)
+{
+    struct web_asset const* a = va;
+    char const* filename = vb;
+
+    return strcmp(a->filename, filename);
+}
+
+static int compare_web_assets(void const* va, void const* vb)
+{
+    struct web_asset const* b = vb;
+
+    return compare_web_asset_to_filename(va, b->filename);
+}
+
+/* compress once, at the best ratio, since the result is reused until the file changes */
+static void web_asset_compress(struct web_asset* asset)
+{
+    z_stream stream;
+    uLong const bound = compressBound(asset->raw_len) + 32; /* gzip's header and trailer */
+
+    memset(&stream, 0, sizeof(stream));
+
+    /* zlib's manual says: "Add 16 to windowBits to write a simple gzip header
+     * and trailer around the compressed data instead of a zlib wrapper." */
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return;
+    }
+
+    asset->gzip = tr_malloc(bound);
+    stream.next_in = asset->raw;
+    stream.avail_in = asset->raw_len;
+    stream.next_out = asset->gzip;
+    stream.avail_out = bound;
+
+    if (deflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out < asset->raw_len)
+    {
+        asset->gzip_len = stream.total_out;
+    }
+    else
+    {
+        tr_free(asset->gzip);
+        asset->gzip = NULL;
+    }
+
+    deflateEnd(&stream);
+}
+
+static struct web_asset* web_asset_new(char const* filename, tr_sys_path_info const* info, tr_error** error)
+{
+    size_t len = 0;
+    void* raw = tr_loadFile(filename, &len, error);
+
+    if (raw == NULL)
+    {
+        return NULL;
+    }
+
+    struct web_asset* asset = tr_new0(struct web_asset, 1);
+    asset->filename = tr_strdup(filename);
+    asset->mimetype = mimetype_guess(filename);
+    asset->mtime = info->last_modified_at;
+    asset->size = info->size;
+    asset->raw = raw;
+    asset->raw_len = len;
+    asset->refcount = 1;
+    tr_snprintf(asset->etag, sizeof(asset->etag), "\"%" PRIx64 "-%zx\"", (uint64_t)asset->mtime, len);
+    web_asset_compress(asset);
+    return asset;
+}
+
+/* returns a new reference to the up-to-date asset, or NULL if it couldn't be loaded */
+static struct web_asset* get_web_asset(struct tr_rpc_server* server, char const* filename, tr_error** error)
+{
+    tr_sys_path_info info;
+    struct web_asset* asset;
+
+    if (!tr_sys_path_get_info(filename, 0, &info, error))
+    {
+        return NULL;
+    }
+
+    asset = tr_ptrArrayFindSorted(&server->webAssets, filename, compare_web_asset_to_filename);
+
+    if (asset != NULL && (asset->mtime != info.last_modified_at || asset->size != info.size))
+    {
+        dbgmsg("reloading changed file \"%s\"", filename);
+        tr_ptrArrayRemoveSortedPointer(&server->webAssets, asset, compare_web_assets);
+        web_asset_unref(asset);
+        asset = NULL;
+    }
+
+    if (asset == NULL)
+    {
+        if ((asset = web_asset_new(filename, &info, error)) == NULL)
+        {
+            return NULL;
+        }
+
+        if (asset->raw_len <= MAX_CACHED_WEB_ASSET_SIZE)
+        {
+            tr_ptrArrayInsertSorted(&server->webAssets, asset, compare_web_assets);
+            ++asset->refcount;
+        }
+    }
+    else
+    {
+        ++asset->refcount;
+    }
+
+    return asset;
+}
+
+static bool etag_matches(char const* if_none_match, char const* etag)
 {
-    tr_free(extra);
+    size_t const etag_len = strlen(etag);
+
+    if (if_none_match == NULL)
+    {
+        return false;
+    }
+
+    if (strcmp(if_none_match, "*") == 0)
+    {
+        return true;
+    }
+
+    /* a comma-separated list of tags, any of which may be weak ("W/") */
+    for (char const* walk = if_none_match; (walk = strstr(walk, etag)) != NULL; walk += etag_len)
+    {
+        char const end = walk[etag_len];
+
+        if (end == '\0' || end == ',' || end == ' ')
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 static void serve_file(struct evhttp_request* req, struct tr_rpc_server* server, char const* filename)
@@ -390,38 +656,52 @@ static void serve_file(struct evhttp_request* req, struct tr_rpc_server* server,
     }
     else
     {
-        void* file;
-        size_t file_len;
         tr_error* error = NULL;
+        struct web_asset* asset = get_web_asset(server, filename, &error);
 
-        file_len = 0;
-        file = tr_loadFile(filename, &file_len, &error);
-
-        if (file == NULL)
+        if (asset == NULL)
         {
-            char* tmp = tr_strdup_printf("%s (%s)", filename, error->message);
+            char* tmp = tr_strdup_printf("%s (%s)", filename, error != NULL ? error->message : "");
             send_simple_response(req, HTTP_NOTFOUND, tmp);
             tr_free(tmp);
             tr_error_free(error);
         }
         else
         {
-            struct evbuffer* content;
-            struct evbuffer* out;
             time_t const now = tr_time();
+            char const* encoding = evhttp_find_header(req->input_headers, "Accept-Encoding");
+            bool const do_compress = asset->gzip != NULL && encoding != NULL && strstr(encoding, "gzip") != NULL;
 
-            content = evbuffer_new();
-            evbuffer_add_reference(content, file, file_len, evbuffer_ref_cleanup_tr_free, file);
-
-            out = evbuffer_new();
-            evhttp_add_header(req->output_headers, "Content-Type", mimetype_guess(filename));
+            evhttp_add_header(req->output_headers, "ETag", asset->etag);
+            evhttp_add_header(req->output_headers, "Vary", "Accept-Encoding");
             add_time_header(req->output_headers, "Date", now);
             add_time_header(req->output_headers, "Expires", now + (24 * 60 * 60));
-            add_response(req, server, out, content);
-            evhttp_send_reply(req, HTTP_OK, "OK", out);
 
-            evbuffer_free(out);
-            evbuffer_free(content);
+            if (etag_matches(evhttp_find_header(req->input_headers, "If-None-Match"), asset->etag))
+            {
+                evhttp_send_reply(req, HTTP_NOTMODIFIED, "Not Modified", NULL);
+                web_asset_unref(asset);
+            }
+            else
+            {
+                struct evbuffer* out = evbuffer_new();
+
+                evhttp_add_header(req->output_headers, "Content-Type", asset->mimetype);
+
+                /* the body refers to the cached bytes; the reference is dropped once they're sent */
+                if (do_compress)
+                {
+                    evhttp_add_header(req->output_headers, "Content-Encoding", "gzip");
+                    evbuffer_add_reference(out, asset->gzip, asset->gzip_len, web_asset_ref_cleanup, asset);
+                }
+                else
+                {
+                    evbuffer_add_reference(out, asset->raw, asset->raw_len, web_asset_ref_cleanup, asset);
+                }
+
+                evhttp_send_reply(req, HTTP_OK, "OK", out);
+                evbuffer_free(out);
+            }
         }
     }
 }
@@ -474,16 +754,19 @@ struct rpc_response_data
 {
     struct evhttp_request* req;
     struct tr_rpc_server* server;
+    bool benc;
 };
 
 static void rpc_response_func(tr_session* session UNUSED, tr_variant* response, void* user_data)
 {
     struct rpc_response_data* data = user_data;
-    struct evbuffer* response_buf = tr_variantToBuf(response, TR_VARIANT_FMT_JSON_LEAN);
+    struct evbuffer* response_buf = tr_variantToBuf(response, data->benc ? TR_VARIANT_FMT_BENC : TR_VARIANT_FMT_JSON_LEAN);
     struct evbuffer* buf = evbuffer_new();
 
     add_response(data->req, data->server, buf, response_buf);
-    evhttp_add_header(data->req->output_headers, "Content-Type", "application/json; charset=UTF-8");
+    evhttp_add_header(data->req->output_headers, "Content-Type",
+        data->benc ? TR_RPC_BENC_CONTENT_TYPE : "application/json; charset=UTF-8");
+    evhttp_add_header(data->req->output_headers, "Vary", "Accept, Accept-Encoding");
     evhttp_send_reply(data->req, HTTP_OK, "OK", buf);
 
     evbuffer_free(buf);
@@ -491,15 +774,37 @@ static void rpc_response_func(tr_session* session UNUSED, tr_variant* response,
     tr_free(data);
 }
 
-static void handle_rpc_from_json(struct evhttp_request* req, struct tr_rpc_server* server, char const* json, size_t json_len)
+/* Bencoded responses skip the JSON writer's escaping and number
+ * formatting, which is most of the cost of a big torrent-get.
+ * Clients opt in by listing TR_RPC_BENC_CONTENT_TYPE in their Accept
+ * header, and may also send their requests bencoded. */
+static bool header_has_benc(struct evhttp_request* req, char const* key)
 {
-    tr_variant top;
-    bool have_content = tr_variantFromJson(&top, json, json_len) == 0;
-    struct rpc_response_data* data;
+    char const* val = evhttp_find_header(req->input_headers, key);
+
+    return val != NULL && strstr(val, TR_RPC_BENC_CONTENT_TYPE) != NULL;
+}
+
+static struct rpc_response_data* rpc_response_data_new(struct evhttp_request* req, struct tr_rpc_server* server)
+{
+    struct rpc_response_data* data = tr_new0(struct rpc_response_data, 1);
 
-    data = tr_new0(struct rpc_response_data, 1);
     data->req = req;
     data->server = server;
+    data->benc = header_has_benc(req, "Accept");
+
+    return data;
+}
+
+static void handle_rpc_from_body(struct evhttp_request* req, struct tr_rpc_server* server)
+{
+    tr_variant top;
+    struct evbuffer* const body = req->input_buffer;
+    size_t const body_len = evbuffer_get_length(body);
+    void const* const body_ptr = evbuffer_pullup(body, -1);
+    bool const have_content = header_has_benc(req, "Content-Type") ?
+        tr_variantFromBenc(&top, body_ptr, body_len) == 0 : tr_variantFromJson(&top, body_ptr, body_len) == 0;
+    struct rpc_response_data* data = rpc_response_data_new(req, server);
 
     tr_rpc_request_exec_json(server->session, have_content ? &top : NULL, rpc_response_func, data);
 
@@ -513,8 +818,7 @@ static void handle_rpc(struct evhttp_request* req, struct tr_rpc_server* server)
 {
     if (req->type == EVHTTP_REQ_POST)
     {
-        handle_rpc_from_json(req, server, (char const*)evbuffer_pullup(req->input_buffer, -1),
-            evbuffer_get_length(req->input_buffer));
+        handle_rpc_from_body(req, server);
         return;
     }
 
@@ -524,9 +828,7 @@ static void handle_rpc(struct evhttp_request* req, struct tr_rpc_server* server)
 
         if (q != NULL)
         {
-            struct rpc_response_data* data = tr_new0(struct rpc_response_data, 1);
-            data->req = req;
-            data->server = server;
+            struct rpc_response_data* data = rpc_response_data_new(req, server);
             tr_rpc_request_exec_uri(server->session, q + 1, TR_BAD_SIZE, rpc_response_func, data);
             return;
         }
@@ -535,6 +837,522 @@ static void handle_rpc(struct evhttp_request* req, struct tr_rpc_server* server)
     send_simple_response(req, 405, NULL);
 }
 
+/***
+****  Event stream.
+****
+****  A GET on <url>events is answered with a never-ending text/event-stream
+****  response. Clients get a message for every notification that rpcimpl.c
+****  sends through tr_rpcNotify(), and once a second the torrents whose
+****  status or stats changed since the last tick, so they don't need to
+****  keep polling torrent-get and session-stats.
+***/
+
+/* how often the torrents are checked for changes */
+#define EVENT_STREAM_INTERVAL_MSEC 1000
+
+/* an idle stream gets a comment line this often, so that dead
+ * connections get noticed and proxies don't time out */
+#define EVENT_STREAM_HEARTBEAT_SECS 15
+
+struct event_client
+{
+    struct tr_rpc_server* server;
+    struct evhttp_request* req;
+};
+
+/* what we last told the clients about a torrent */
+struct torrent_snapshot
+{
+    int id;
+    int status;
+    int error;
+    bool is_complete;
+    bool is_removing; /* "torrent-removed" was already sent */
+    int percent_done; /* in hundredths of a percent */
+    int rate_download;
+    int rate_upload;
+    int eta;
+    int peers_connected;
+    uint64_t downloaded_ever;
+    uint64_t uploaded_ever;
+};
+
+static int compare_torrent_snapshots(void const* va, void const* vb)
+{
+    struct torrent_snapshot const* a = va;
+    struct torrent_snapshot const* b = vb;
+
+    return a->id - b->id;
+}
+
+static void torrent_snapshot_init(struct torrent_snapshot* snap, tr_torrent* tor)
+{
+    tr_stat const* st = tr_torrentStatCached(tor);
+
+    snap->id = st->id;
+    snap->is_removing = false;
+    snap->status = st->activity;
+    snap->error = st->error;
+    snap->is_complete = tr_torrentHasMetadata(tor) && tr_torrentIsSeed(tor);
+    snap->percent_done = (int)(st->percentDone * 10000);
+    snap->rate_download = toSpeedBytes(st->pieceDownloadSpeed_KBps);
+    snap->rate_upload = toSpeedBytes(st->pieceUploadSpeed_KBps);
+    snap->eta = st->eta;
+    snap->peers_connected = st->peersConnected;
+    snap->downloaded_ever = st->downloadedEver;
+    snap->uploaded_ever = st->uploadedEver;
+}
+
+static struct torrent_snapshot* take_torrent_snapshots(tr_session* session, size_t* setme_count)
+{
+    size_t n = 0;
+    tr_torrent* tor = NULL;
+    struct torrent_snapshot* snaps = tr_new(struct torrent_snapshot, tr_sessionCountTorrents(session));
+
+    while ((tor = tr_torrentNext(session, tor)) != NULL)
+    {
+        torrent_snapshot_init(&snaps[n++], tor);
+    }
+
+    if (n > 1)
+    {
+        qsort(snaps, n, sizeof(struct torrent_snapshot), compare_torrent_snapshots);
+    }
+
+    *setme_count = n;
+    return snaps;
+}
+
+static void event_stream_send(struct tr_rpc_server* server, char const* type, tr_variant const* data)
+{
+    size_t json_len;
+    char* json = tr_variantToStr(data, TR_VARIANT_FMT_JSON_LEAN, &json_len);
+    struct evbuffer* buf = evbuffer_new();
+
+    /* an event's data can't span lines */
+    while (json_len > 0 && json[json_len - 1] == '\n')
+    {
+        --json_len;
+    }
+
+    for (int i = 0, n = tr_ptrArraySize(&server->eventClients); i < n; ++i)
+    {
+        struct event_client* client = tr_ptrArrayNth(&server->eventClients, i);
+
+        evbuffer_add_printf(buf, "event: %s\ndata: %.*s\n\n", type, (int)json_len, json);
+        evhttp_send_reply_chunk(client->req, buf);
+    }
+
+    server->eventLastSent = tr_time();
+
+    evbuffer_free(buf);
+    tr_free(json);
+}
+
+static void event_stream_send_torrent(struct tr_rpc_server* server, char const* type, int id)
+{
+    tr_variant data;
+
+    tr_variantInitDict(&data, 1);
+    tr_variantDictAddInt(&data, TR_KEY_id, id);
+    event_stream_send(server, type, &data);
+    tr_variantFree(&data);
+}
+
+/* add to `d' the stats that differ between `old' and `snap'.
+ * Returns true if there were any */
+static bool add_torrent_snapshot_changes(tr_variant* d, struct torrent_snapshot const* old,
+    struct torrent_snapshot const* snap)
+{
+    bool changed = false;
+
+    if (old->error != snap->error)
+    {
+        tr_variantDictAddInt(d, TR_KEY_error, snap->error);
+        changed = true;
+    }
+
+    if (old->percent_done != snap->percent_done)
+    {
+        tr_variantDictAddReal(d, TR_KEY_percentDone, snap->percent_done / 10000.0);
+        changed = true;
+    }
+
+    if (old->rate_download != snap->rate_download)
+    {
+        tr_variantDictAddInt(d, TR_KEY_rateDownload, snap->rate_download);
+        changed = true;
+    }
+
+    if (old->rate_upload != snap->rate_upload)
+    {
+        tr_variantDictAddInt(d, TR_KEY_rateUpload, snap->rate_upload);
+        changed = true;
+    }
+
+    if (old->eta != snap->eta)
+    {
+        tr_variantDictAddInt(d, TR_KEY_eta, snap->eta);
+        changed = true;
+    }
+
+    if (old->peers_connected != snap->peers_connected)
+    {
+        tr_variantDictAddInt(d, TR_KEY_peersConnected, snap->peers_connected);
+        changed = true;
+    }
+
+    if (old->downloaded_ever != snap->downloaded_ever)
+    {
+        tr_variantDictAddInt(d, TR_KEY_downloadedEver, snap->downloaded_ever);
+        changed = true;
+    }
+
+    if (old->uploaded_ever != snap->uploaded_ever)
+    {
+        tr_variantDictAddInt(d, TR_KEY_uploadedEver, snap->uploaded_ever);
+        changed = true;
+    }
+
+    return changed;
+}
+
+static void event_stream_tick(struct tr_rpc_server* server)
+{
+    size_t n;
+    size_t i = 0;
+    size_t j = 0;
+    tr_variant stats;
+    tr_variant* torrents;
+    struct torrent_snapshot* snaps = take_torrent_snapshots(server->session, &n);
+    struct torrent_snapshot const* const old = server->snapshots;
+    size_t const old_n = server->snapshotCount;
+    bool speed_changed = false;
+    int speed;
+
+    tr_variantInitDict(&stats, 1);
+    torrents = tr_variantDictAddList(&stats, TR_KEY_torrents, 0);
+
+    /* both lists are sorted by id, so walk them side by side */
+    while (i < old_n || j < n)
+    {
+        if (j == n || (i < old_n && old[i].id < snaps[j].id))
+        {
+            if (!old[i].is_removing)
+            {
+                event_stream_send_torrent(server, "torrent-removed", old[i].id);
+            }
+
+            ++i;
+        }
+        else if (i == old_n || snaps[j].id < old[i].id)
+        {
+            event_stream_send_torrent(server, "torrent-added", snaps[j].id);
+            ++j;
+        }
+        else if (old[i].is_removing)
+        {
+            /* still waiting for the removal to finish */
+            snaps[j].is_removing = true;
+            ++i;
+            ++j;
+        }
+        else
+        {
+            tr_variant* d;
+
+            if (old[i].status != snaps[j].status)
+            {
+                tr_variant data;
+
+                tr_variantInitDict(&data, 2);
+                tr_variantDictAddInt(&data, TR_KEY_id, snaps[j].id);
+                tr_variantDictAddInt(&data, TR_KEY_status, snaps[j].status);
+                event_stream_send(server, "torrent-status", &data);
+                tr_variantFree(&data);
+            }
+
+            if (!old[i].is_complete && snaps[j].is_complete)
+            {
+                event_stream_send_torrent(server, "torrent-completed", snaps[j].id);
+            }
+
+            d = tr_variantListAddDict(torrents, 9);
+            tr_variantDictAddInt(d, TR_KEY_id, snaps[j].id);
+
+            if (!add_torrent_snapshot_changes(d, &old[i], &snaps[j]))
+            {
+                tr_variantListRemove(torrents, tr_variantListSize(torrents) - 1);
+            }
+
+            ++i;
+            ++j;
+        }
+    }
+
+    if (tr_variantListSize(torrents) > 0)
+    {
+        event_stream_send(server, "torrent-stats", &stats);
+    }
+
+    tr_variantFree(&stats);
+
+    /* the session's speeds */
+    tr_variantInitDict(&stats, 2);
+
+    speed = (int)tr_sessionGetPieceSpeed_Bps(server->session, TR_DOWN);
+
+    if (speed != server->eventDownloadSpeed)
+    {
+        tr_variantDictAddInt(&stats, TR_KEY_downloadSpeed, speed);
+        server->eventDownloadSpeed = speed;
+        speed_changed = true;
+    }
+
+    speed = (int)tr_sessionGetPieceSpeed_Bps(server->session, TR_UP);
+
+    if (speed != server->eventUploadSpeed)
+    {
+        tr_variantDictAddInt(&stats, TR_KEY_uploadSpeed, speed);
+        server->eventUploadSpeed = speed;
+        speed_changed = true;
+    }
+
+    if (speed_changed)
+    {
+        event_stream_send(server, "session-stats", &stats);
+    }
+
+    tr_variantFree(&stats);
+
+    tr_free(server->snapshots);
+    server->snapshots = snaps;
+    server->snapshotCount = n;
+
+    if (server->eventLastSent + EVENT_STREAM_HEARTBEAT_SECS <= tr_time())
+    {
+        struct evbuffer* buf = evbuffer_new();
+
+        for (int k = 0, k_n = tr_ptrArraySize(&server->eventClients); k < k_n; ++k)
+        {
+            struct event_client* client = tr_ptrArrayNth(&server->eventClients, k);
+
+            evbuffer_add(buf, ":\n\n", 3);
+            evhttp_send_reply_chunk(client->req, buf);
+        }
+
+        evbuffer_free(buf);
+        server->eventLastSent = tr_time();
+    }
+}
+
+static void on_event_stream_timer(evutil_socket_t fd UNUSED, short what UNUSED, void* vserver)
+{
+    struct tr_rpc_server* server = vserver;
+
+    event_stream_tick(server);
+
+    tr_timerAddMsec(server->eventTimer, EVENT_STREAM_INTERVAL_MSEC);
+}
+
+/* The first client makes us start keeping track of the torrents;
+ * the last one to leave makes us stop. */
+static void event_stream_start(struct tr_rpc_server* server)
+{
+    server->snapshots = take_torrent_snapshots(server->session, &server->snapshotCount);
+    server->eventDownloadSpeed = (int)tr_sessionGetPieceSpeed_Bps(server->session, TR_DOWN);
+    server->eventUploadSpeed = (int)tr_sessionGetPieceSpeed_Bps(server->session, TR_UP);
+    server->eventLastSent = tr_time();
+
+    if (server->eventTimer == NULL)
+    {
+        server->eventTimer = evtimer_new(server->session->event_base, on_event_stream_timer, server);
+    }
+
+    tr_timerAddMsec(server->eventTimer, EVENT_STREAM_INTERVAL_MSEC);
+}
+
+static void event_stream_stop(struct tr_rpc_server* server)
+{
+    if (server->eventTimer != NULL)
+    {
+        event_free(server->eventTimer);
+        server->eventTimer = NULL;
+    }
+
+    tr_free(server->snapshots);
+    server->snapshots = NULL;
+    server->snapshotCount = 0;
+}
+
+static void on_event_client_closed(struct evhttp_connection* con UNUSED, void* vclient)
+{
+    struct event_client* client = vclient;
+    struct tr_rpc_server* server = client->server;
+
+    for (int i = 0, n = tr_ptrArraySize(&server->eventClients); i < n; ++i)
+    {
+        if (tr_ptrArrayNth(&server->eventClients, i) == client)
+        {
+            tr_ptrArrayRemove(&server->eventClients, i);
+            break;
+        }
+    }
+
+    tr_free(client);
+
+    if (tr_ptrArrayEmpty(&server->eventClients))
+    {
+        event_stream_stop(server);
+    }
+}
+
+static void close_event_clients(struct tr_rpc_server* server)
+{
+    struct event_client* client;
+
+    while ((client = tr_ptrArrayPop(&server->eventClients)) != NULL)
+    {
+        struct evhttp_connection* con = evhttp_request_get_connection(client->req);
+
+        /* the stream never ends on its own, so just hang up */
+        evhttp_connection_set_closecb(con, NULL, NULL);
+        evhttp_connection_free(con);
+        tr_free(client);
+    }
+
+    event_stream_stop(server);
+}
+
+static void handle_events(struct evhttp_request* req, struct tr_rpc_server* server)
+{
+    struct event_client* client;
+
+    if (req->type != EVHTTP_REQ_GET)
+    {
+        send_simple_response(req, 405, NULL);
+        return;
+    }
+
+    client = tr_new0(struct event_client, 1);
+    client->server = server;
+    client->req = req;
+
+    if (tr_ptrArrayEmpty(&server->eventClients))
+    {
+        event_stream_start(server);
+    }
+
+    tr_ptrArrayAppend(&server->eventClients, client);
+
+    evhttp_add_header(req->output_headers, "Content-Type", "text/event-stream");
+    evhttp_add_header(req->output_headers, "Cache-Control", "no-cache");
+    evhttp_send_reply_start(req, HTTP_OK, "OK");
+    evhttp_connection_set_closecb(evhttp_request_get_connection(req), on_event_client_closed, client);
+}
+
+void tr_rpcNotify(tr_rpc_server* server, tr_rpc_callback_type type, tr_torrent* tor)
+{
+    char const* name = NULL;
+    tr_variant data;
+
+    if (server == NULL || tr_ptrArrayEmpty(&server->eventClients))
+    {
+        return;
+    }
+
+    switch (type)
+    {
+    case TR_RPC_TORRENT_ADDED:
+        name = "torrent-added";
+        break;
+
+    case TR_RPC_TORRENT_STARTED:
+        name = "torrent-started";
+        break;
+
+    case TR_RPC_TORRENT_STOPPED:
+        name = "torrent-stopped";
+        break;
+
+    case TR_RPC_TORRENT_REMOVING:
+    case TR_RPC_TORRENT_TRASHING:
+        name = "torrent-removed";
+        break;
+
+    case TR_RPC_TORRENT_CHANGED:
+        name = "torrent-changed";
+        break;
+
+    case TR_RPC_TORRENT_MOVED:
+        name = "torrent-moved";
+        break;
+
+    case TR_RPC_SESSION_CHANGED:
+        name = "session-changed";
+        break;
+
+    case TR_RPC_SESSION_QUEUE_POSITIONS_CHANGED:
+        name = "queue-changed";
+        break;
+
+    case TR_RPC_SESSION_CLOSE:
+        name = "session-close";
+        break;
+    }
+
+    if (name == NULL)
+    {
+        return;
+    }
+
+    tr_variantInitDict(&data, 2);
+
+    if (tor != NULL)
+    {
+        tr_variantDictAddInt(&data, TR_KEY_id, tr_torrentId(tor));
+
+        if (type == TR_RPC_TORRENT_TRASHING)
+        {
+            tr_variantDictAddBool(&data, TR_KEY_delete_local_data, true);
+        }
+    }
+
+    event_stream_send(server, name, &data);
+    tr_variantFree(&data);
+
+    /* keep the next tick from announcing these a second time */
+    if (tor != NULL && (type == TR_RPC_TORRENT_ADDED || type == TR_RPC_TORRENT_REMOVING || type == TR_RPC_TORRENT_TRASHING))
+    {
+        int const id = tr_torrentId(tor);
+        struct torrent_snapshot* snaps = server->snapshots;
+        size_t n = server->snapshotCount;
+        size_t pos = 0;
+
+        while (pos < n && snaps[pos].id < id)
+        {
+            ++pos;
+        }
+
+        if (type == TR_RPC_TORRENT_ADDED && (pos == n || snaps[pos].id != id))
+        {
+            snaps = tr_renew(struct torrent_snapshot, snaps, n + 1);
+            memmove(snaps + pos + 1, snaps + pos, sizeof(struct torrent_snapshot) * (n - pos));
+            torrent_snapshot_init(&snaps[pos], tor);
+            ++n;
+        }
+        else if (type != TR_RPC_TORRENT_ADDED && pos < n && snaps[pos].id == id)
+        {
+            /* the torrent is only removed later, in the libtransmission
+               thread, so keep its entry until it's really gone */
+            snaps[pos].is_removing = true;
+        }
+
+        server->snapshots = snaps;
+        server->snapshotCount = n;
+    }
+}
+
 static bool isAddressAllowed(tr_rpc_server const* server, char const* address)
 {
     if (!server->isWhitelistEnabled)
@@ -614,11 +1432,34 @@ static bool isHostnameAllowed(tr_rpc_server const* server, struct evhttp_request
     return false;
 }
 
+static bool is_event_stream_request(struct tr_rpc_server const* server, struct evhttp_request const* req)
+{
+    char const* path = req->uri + strlen(server->url);
+
+    return strncmp(path, "events", 6) == 0 && (path[6] == '\0' || path[6] == '?');
+}
+
 static bool test_session_id(struct tr_rpc_server* server, struct evhttp_request* req)
 {
     char const* ours = get_current_session_id(server);
     char const* theirs = evhttp_find_header(req->input_headers, TR_RPC_SESSION_ID_HEADER);
-    bool const success = theirs != NULL && strcmp(theirs, ours) == 0;
+    bool success = theirs != NULL && strcmp(theirs, ours) == 0;
+
+    /* browsers' EventSource can't add headers,
+       so the event stream also takes the id as a query argument */
+    if (!success && theirs == NULL && is_event_stream_request(server, req))
+    {
+        char const* query = strchr(req->uri, '?');
+        struct evkeyvalq args;
+
+        if (query != NULL && evhttp_parse_query_str(query + 1, &args) == 0)
+        {
+            theirs = evhttp_find_header(&args, "session-id");
+            success = theirs != NULL && strcmp(theirs, ours) == 0;
+            evhttp_clear_headers(&args);
+        }
+    }
+
     return success;
 }
 
@@ -745,6 +1586,10 @@ static void handle_request(struct evhttp_request* req, void* arg)
         {
             handle_rpc(req, server);
         }
+        else if (is_event_stream_request(server, req))
+        {
+            handle_events(req, server);
+        }
         else
         {
             send_simple_response(req, HTTP_NOTFOUND, req->uri);
@@ -829,6 +1674,12 @@ static void startServer(void* vserver)
     else
     {
         evhttp_set_gencb(httpd, handle_request, server);
+
+        if (server->idleTimeoutSecs > 0)
+        {
+            evhttp_set_timeout(httpd, server->idleTimeoutSecs);
+        }
+
         server->httpd = httpd;
 
         tr_logAddNamedDbg(MY_NAME, "Started listening on %s:%d", address, port);
@@ -851,6 +1702,8 @@ static void stopServer(tr_rpc_server* server)
     char const* address = tr_rpcGetBindAddress(server);
     int const port = server->port;
 
+    close_event_clients(server);
+
     server->httpd = NULL;
     evhttp_free(httpd);
 
@@ -1077,6 +1930,9 @@ static void closeServer(void* vserver)
         deflateEnd(&s->stream);
     }
 
+    tr_ptrArrayDestruct(&s->webAssets, (PtrArrayForeachFunc)web_asset_unref);
+    tr_ptrArrayDestruct(&s->eventClients, NULL);
+
     tr_free(s->url);
     tr_free(s->whitelistStr);
     tr_free(s->username);
@@ -1107,6 +1963,8 @@ tr_rpc_server* tr_rpcInit(tr_session* session, tr_variant* settings)
 
     s = tr_new0(tr_rpc_server, 1);
     s->session = session;
+    s->webAssets = TR_PTR_ARRAY_INIT;
+    s->eventClients = TR_PTR_ARRAY_INIT;
 
     key = TR_KEY_rpc_enabled;
 
@@ -1163,6 +2021,17 @@ tr_rpc_server* tr_rpcInit(tr_session* session, tr_variant* settings)
         tr_rpcSetHostWhitelistEnabled(s, boolVal);
     }
 
+    key = TR_KEY_rpc_idle_timeout;
+
+    if (!tr_variantDictFindInt(settings, key, &i))
+    {
+        missing_settings_key(key);
+    }
+    else
+    {
+        s->idleTimeoutSecs = MAX(i, 0);
+    }
+
     key = TR_KEY_rpc_host_whitelist;
 
     if (!tr_variantDictFindStr(settings, key, &str, NULL) && str != NULL)
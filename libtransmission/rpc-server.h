@@ -59,3 +59,6 @@ void tr_rpcSetPasswordEnabled(tr_rpc_server* server, bool isEnabled);
 bool tr_rpcIsPasswordEnabled(tr_rpc_server const* session);
 
 char const* tr_rpcGetBindAddress(tr_rpc_server const* server);
+
+/* tell the event stream's clients about something done over RPC */
+void tr_rpcNotify(tr_rpc_server* server, tr_rpc_callback_type type, struct tr_torrent* tor);
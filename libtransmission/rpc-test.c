@@ -6,8 +6,12 @@
  *
  */
 
+#include <event2/buffer.h>
+
 #include "transmission.h"
+#include "ptrarray.h"
 #include "rpcimpl.h"
+#include "torrent.h" /* tr_torrentSetLabels() */
 #include "utils.h"
 #include "variant.h"
 
@@ -150,6 +154,256 @@ static int test_session_get_and_set(void)
     return 0;
 }
 
+static int test_batch(void)
+{
+    tr_session* session;
+    tr_variant request;
+    tr_variant response;
+    tr_variant* req;
+    tr_variant* child;
+    tr_variant* args;
+    char const* str;
+    int64_t i;
+
+    session = libttest_session_init(NULL);
+
+    tr_variantInitList(&request, 4);
+    req = tr_variantListAddDict(&request, 2);
+    tr_variantDictAddStr(req, TR_KEY_method, "session-get");
+    tr_variantDictAddInt(req, TR_KEY_tag, 1);
+    tr_variantListAddInt(&request, 2);
+    req = tr_variantListAddDict(&request, 2);
+    tr_variantDictAddStr(req, TR_KEY_method, "no-such-method");
+    tr_variantDictAddInt(req, TR_KEY_tag, 3);
+    req = tr_variantListAddDict(&request, 2);
+    tr_variantDictAddStr(req, TR_KEY_method, "session-stats");
+    tr_variantDictAddInt(req, TR_KEY_tag, 4);
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    tr_variantFree(&request);
+
+    /* one response per request, in order */
+    check(tr_variantIsList(&response));
+    check_uint(tr_variantListSize(&response), ==, 4);
+
+    child = tr_variantListChild(&response, 0);
+    check(tr_variantDictFindStr(child, TR_KEY_result, &str, NULL));
+    check_str(str, ==, "success");
+    check(tr_variantDictFindInt(child, TR_KEY_tag, &i));
+    check_int(i, ==, 1);
+    check(tr_variantDictFindDict(child, TR_KEY_arguments, &args));
+    check_ptr(tr_variantDictFind(args, TR_KEY_rpc_version), !=, NULL);
+
+    child = tr_variantListChild(&response, 1);
+    check(tr_variantDictFindStr(child, TR_KEY_result, &str, NULL));
+    check_str(str, !=, "success");
+
+    child = tr_variantListChild(&response, 2);
+    check(tr_variantDictFindStr(child, TR_KEY_result, &str, NULL));
+    check_str(str, ==, "method name not recognized");
+    check(tr_variantDictFindInt(child, TR_KEY_tag, &i));
+    check_int(i, ==, 3);
+
+    child = tr_variantListChild(&response, 3);
+    check(tr_variantDictFindStr(child, TR_KEY_result, &str, NULL));
+    check_str(str, ==, "success");
+    check(tr_variantDictFindInt(child, TR_KEY_tag, &i));
+    check_int(i, ==, 4);
+    tr_variantFree(&response);
+
+    /* an empty batch gets an empty list back */
+    tr_variantInitList(&request, 0);
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    tr_variantFree(&request);
+    check(tr_variantIsList(&response));
+    check_uint(tr_variantListSize(&response), ==, 0);
+    tr_variantFree(&response);
+
+    /* cleanup */
+    libttest_session_close(session);
+    return 0;
+}
+
+static tr_torrent* add_magnet(tr_session* session, int i, char const* name)
+{
+    tr_torrent* tor;
+    tr_ctor* ctor = tr_ctorNew(session);
+    char* magnet = tr_strdup_printf("magnet:?xt=urn:btih:%040d&dn=%s", i, name);
+
+    tr_ctorSetMetainfoFromMagnetLink(ctor, magnet);
+    tr_ctorSetPaused(ctor, TR_FORCE, true);
+    tor = tr_torrentNew(ctor, NULL, NULL);
+
+    tr_ctorFree(ctor);
+    tr_free(magnet);
+    return tor;
+}
+
+static char const* torrent_get_page(tr_session* session, tr_variant* response, char const* sort_mode, bool reversed,
+    int64_t offset, int64_t limit)
+{
+    char const* result = NULL;
+    tr_variant request;
+    tr_variant* args;
+
+    tr_variantInitDict(&request, 2);
+    tr_variantDictAddStr(&request, TR_KEY_method, "torrent-get");
+    args = tr_variantDictAddDict(&request, TR_KEY_arguments, 5);
+    tr_variantListAddQuark(tr_variantDictAddList(args, TR_KEY_fields, 1), TR_KEY_name);
+    tr_variantDictAddStr(args, TR_KEY_sort_mode, sort_mode);
+    tr_variantDictAddBool(args, TR_KEY_sort_reversed, reversed);
+    tr_variantDictAddInt(args, TR_KEY_offset, offset);
+    tr_variantDictAddInt(args, TR_KEY_limit, limit);
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, response);
+    tr_variantFree(&request);
+
+    tr_variantDictFindStr(response, TR_KEY_result, &result, NULL);
+    return result;
+}
+
+/* the names of the torrents in a torrent-get response, joined with spaces */
+static char* get_torrent_names(tr_variant* response, int64_t* setme_total)
+{
+    tr_variant* args;
+    tr_variant* torrents;
+    struct evbuffer* buf = evbuffer_new();
+
+    *setme_total = -1;
+
+    if (tr_variantDictFindDict(response, TR_KEY_arguments, &args) &&
+        tr_variantDictFindList(args, TR_KEY_torrents, &torrents))
+    {
+        tr_variantDictFindInt(args, TR_KEY_total, setme_total);
+
+        for (size_t i = 0, n = tr_variantListSize(torrents); i < n; ++i)
+        {
+            char const* name = "";
+            tr_variantDictFindStr(tr_variantListChild(torrents, i), TR_KEY_name, &name, NULL);
+            evbuffer_add_printf(buf, "%s%s", i == 0 ? "" : " ", name);
+        }
+    }
+
+    return evbuffer_free_to_str(buf, NULL);
+}
+
+static int test_torrent_get_paging(void)
+{
+    tr_session* session;
+    tr_variant request;
+    tr_variant response;
+    tr_variant* args;
+    tr_ptrArray labels = TR_PTR_ARRAY_INIT;
+    tr_torrent* torrents[5];
+    char const* names[] = { "charlie", "alpha", "echo", "Bravo", "delta" };
+    char const* result;
+    char* str;
+    int64_t total;
+
+    session = libttest_session_init(NULL);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        torrents[i] = add_magnet(session, i + 1, names[i]);
+        check_ptr(torrents[i], !=, NULL);
+    }
+
+    /* wait for them to leave the verify queue */
+    for (int i = 0; i < 5; ++i)
+    {
+        while (tr_torrentStat(torrents[i])->activity != TR_STATUS_STOPPED)
+        {
+            tr_wait_msec(10);
+        }
+    }
+
+    tr_ptrArrayAppend(&labels, tr_strdup("work"));
+    tr_torrentSetLabels(torrents[0], &labels);
+    tr_torrentSetLabels(torrents[4], &labels);
+    tr_ptrArrayDestruct(&labels, tr_free);
+
+    /* paging through the sorted list */
+    check_str(torrent_get_page(session, &response, "sort-by-name", false, 1, 2), ==, "success");
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "Bravo charlie");
+    check_int(total, ==, 5);
+    tr_free(str);
+    tr_variantFree(&response);
+
+    check_str(torrent_get_page(session, &response, "sort-by-name", true, 0, 1), ==, "success");
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "echo");
+    tr_free(str);
+    tr_variantFree(&response);
+
+    check_str(torrent_get_page(session, &response, "sort-by-id", false, 3, 100), ==, "success");
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "Bravo delta");
+    check_int(total, ==, 5);
+    tr_free(str);
+    tr_variantFree(&response);
+
+    check_str(torrent_get_page(session, &response, "sort-by-id", false, 10, 1), ==, "success");
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "");
+    check_int(total, ==, 5);
+    tr_free(str);
+    tr_variantFree(&response);
+
+    check_str(torrent_get_page(session, &response, "sort-by-nothing", false, 0, 1), ==, "invalid sort-mode");
+    tr_variantFree(&response);
+
+    /* filters */
+    tr_variantInitDict(&request, 2);
+    tr_variantDictAddStr(&request, TR_KEY_method, "torrent-get");
+    args = tr_variantDictAddDict(&request, TR_KEY_arguments, 4);
+    tr_variantListAddQuark(tr_variantDictAddList(args, TR_KEY_fields, 1), TR_KEY_name);
+    tr_variantDictAddStr(args, TR_KEY_filter_text, "A");
+    tr_variantDictAddStr(args, TR_KEY_sort_mode, "sort-by-name");
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "alpha Bravo charlie delta");
+    check_int(total, ==, 4);
+    tr_free(str);
+    tr_variantFree(&response);
+
+    tr_variantDictAddStr(args, TR_KEY_filter_label, "work");
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "charlie delta");
+    tr_free(str);
+    tr_variantFree(&response);
+
+    tr_variantDictAddStr(args, TR_KEY_filter_mode, "show-paused");
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "charlie delta");
+    tr_free(str);
+    tr_variantFree(&response);
+
+    tr_variantDictAddStr(args, TR_KEY_filter_mode, "show-seeding");
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    str = get_torrent_names(&response, &total);
+    check_str(str, ==, "");
+    check_int(total, ==, 0);
+    tr_free(str);
+    tr_variantFree(&response);
+
+    tr_variantDictAddStr(args, TR_KEY_filter_mode, "show-nothing");
+    tr_rpc_request_exec_json(session, &request, rpc_response_func, &response);
+    check(tr_variantDictFindStr(&response, TR_KEY_result, &result, NULL));
+    check_str(result, ==, "invalid filter-mode");
+    tr_variantFree(&response);
+    tr_variantFree(&request);
+
+    /* cleanup */
+    for (int i = 0; i < 5; ++i)
+    {
+        tr_torrentRemove(torrents[i], false, NULL);
+    }
+
+    libttest_session_close(session);
+    return 0;
+}
+
 /***
 ****
 ***/
@@ -159,7 +413,9 @@ int main(void)
     testFunc const tests[] =
     {
         test_list,
-        test_session_get_and_set
+        test_session_get_and_set,
+        test_batch,
+        test_torrent_get_paging
     };
 
     return runTests(tests, NUM_TESTS(tests));
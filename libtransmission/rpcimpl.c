@@ -8,12 +8,12 @@
 
 #include <ctype.h> /* isdigit */
 #include <errno.h>
+#include <limits.h> /* INT_MAX */
 #include <stdlib.h> /* strtol */
 #include <string.h> /* strcmp */
 
-#include <zlib.h>
-
 #include <event2/buffer.h>
+#include <event2/util.h> /* evutil_ascii_strcasecmp() */
 
 #include "transmission.h"
 #include "completion.h"
@@ -24,6 +24,7 @@
 #include "log.h"
 #include "platform-quota.h" /* tr_device_info_get_free_space() */
 #include "rpcimpl.h"
+#include "rpc-server.h"
 #include "session.h"
 #include "session-id.h"
 #include "stats.h"
@@ -34,7 +35,7 @@
 #include "version.h"
 #include "web.h"
 
-#define RPC_VERSION 16
+#define RPC_VERSION 17
 #define RPC_VERSION_MIN 1
 
 #define RECENTLY_ACTIVE_SECONDS 60
@@ -53,6 +54,8 @@ static tr_rpc_callback_status notify(tr_session* session, int type, tr_torrent*
 {
     tr_rpc_callback_status status = 0;
 
+    tr_rpcNotify(session->rpcServer, type, tor);
+
     if (session->rpc_func != NULL)
     {
         status = (*session->rpc_func)(session, type, tor, session->rpc_func_user_data);
@@ -866,7 +869,7 @@ static void addField(tr_torrent* const tor, tr_info const* const inf, tr_stat co
     }
 }
 
-static void addInfo(tr_torrent* tor, tr_variant* d, tr_variant* fields)
+static void addInfo(tr_torrent* tor, tr_stat const* st, tr_variant* d, tr_variant* fields)
 {
     int const n = tr_variantListSize(fields);
 
@@ -875,7 +878,6 @@ static void addInfo(tr_torrent* tor, tr_variant* d, tr_variant* fields)
     if (n > 0)
     {
         tr_info const* const inf = tr_torrentInfo(tor);
-        tr_stat const* const st = tr_torrentStat((tr_torrent*)tor);
 
         for (int i = 0; i < n; ++i)
         {
@@ -890,18 +892,468 @@ static void addInfo(tr_torrent* tor, tr_variant* d, tr_variant* fields)
     }
 }
 
+/***
+****  torrent-get's filters, sort modes, and paging. They're evaluated
+****  against every torrent's tr_brief_stat, fetched in a single pass, so
+****  that a big session only builds full stats and variants for the page
+****  that was asked for.
+****  The names match the clients' "filter-mode" and "sort-mode" settings.
+***/
+
+struct torrent_get_entry
+{
+    tr_torrent* tor;
+    char const* name;
+    uint64_t sizeWhenDone;
+    time_t addedDate;
+    double percentDone;
+    double ratio;
+    double speed;
+    int peers;
+    int eta;
+    int queuePosition;
+    int id;
+    tr_torrent_activity activity;
+    bool hasError;
+    bool hasMetadata;
+};
+
+enum
+{
+    FILTER_SHOW_ALL,
+    FILTER_SHOW_ACTIVE,
+    FILTER_SHOW_DOWNLOADING,
+    FILTER_SHOW_SEEDING,
+    FILTER_SHOW_PAUSED,
+    FILTER_SHOW_FINISHED,
+    FILTER_SHOW_VERIFYING,
+    FILTER_SHOW_ERROR
+};
+
+static char const* const filterModeNames[] =
+{
+    "show-all",
+    "show-active",
+    "show-downloading",
+    "show-seeding",
+    "show-paused",
+    "show-finished",
+    "show-verifying",
+    "show-error"
+};
+
+static bool statMatchesFilterMode(tr_brief_stat const* st, int mode)
+{
+    switch (mode)
+    {
+    case FILTER_SHOW_ACTIVE:
+        return st->peersSendingToUs > 0 || st->peersGettingFromUs > 0 || st->webseedsSendingToUs > 0 ||
+            st->activity == TR_STATUS_CHECK;
+
+    case FILTER_SHOW_DOWNLOADING:
+        return st->activity == TR_STATUS_DOWNLOAD || st->activity == TR_STATUS_DOWNLOAD_WAIT;
+
+    case FILTER_SHOW_SEEDING:
+        return st->activity == TR_STATUS_SEED || st->activity == TR_STATUS_SEED_WAIT;
+
+    case FILTER_SHOW_PAUSED:
+        return st->activity == TR_STATUS_STOPPED;
+
+    case FILTER_SHOW_FINISHED:
+        return st->finished;
+
+    case FILTER_SHOW_VERIFYING:
+        return st->activity == TR_STATUS_CHECK || st->activity == TR_STATUS_CHECK_WAIT;
+
+    case FILTER_SHOW_ERROR:
+        return st->error != TR_STAT_OK;
+
+    default:
+        return true;
+    }
+}
+
+static bool torrentHasTrackerSubstring(tr_torrent const* tor, char const* str)
+{
+    for (unsigned int i = 0; i < tor->info.trackerCount; ++i)
+    {
+        if (tr_strcasestr(tor->info.trackers[i].announce, str) != NULL)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool torrentHasLabel(tr_torrent const* tor, char const* label)
+{
+    for (int i = 0, n = tr_ptrArraySize(&tor->labels); i < n; ++i)
+    {
+        if (strcmp(tr_ptrArrayNth((tr_ptrArray*)&tor->labels, i), label) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline int compareInt64(int64_t a, int64_t b)
+{
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static inline int compareDouble(double a, double b)
+{
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/* unknown ETAs sort after all of the known ones */
+static inline int compareEta(int a, int b)
+{
+    return compareInt64(a < 0 ? INT_MAX : a, b < 0 ? INT_MAX : b);
+}
+
+static int compareEntriesTieBreak(struct torrent_get_entry const* a, struct torrent_get_entry const* b)
+{
+    int val = evutil_ascii_strcasecmp(a->name, b->name);
+
+    return val != 0 ? val : compareInt64(a->id, b->id);
+}
+
+static int compareEntriesByRatio(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareDouble(a->ratio, b->ratio);
+
+    return val != 0 ? val : compareEntriesTieBreak(a, b);
+}
+
+static int compareEntriesByProgress(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareInt64(a->hasMetadata, b->hasMetadata);
+
+    if (val == 0)
+    {
+        val = compareDouble(a->percentDone, b->percentDone);
+    }
+
+    if (val == 0)
+    {
+        val = compareInt64(a->queuePosition, b->queuePosition);
+    }
+
+    return val != 0 ? val : compareEntriesByRatio(a, b);
+}
+
+static int compareEntriesByState(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareInt64(a->activity, b->activity);
+
+    if (val == 0)
+    {
+        val = compareInt64(a->queuePosition, b->queuePosition);
+    }
+
+    if (val == 0)
+    {
+        val = compareInt64(a->hasError, b->hasError);
+    }
+
+    return val != 0 ? val : compareEntriesByProgress(a, b);
+}
+
+static int compareEntriesByActivity(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareDouble(a->speed, b->speed);
+
+    if (val == 0)
+    {
+        val = compareInt64(a->peers, b->peers);
+    }
+
+    return val != 0 ? val : compareEntriesByState(a, b);
+}
+
+static int compareEntriesByAge(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareInt64(a->addedDate, b->addedDate);
+
+    return val != 0 ? val : compareEntriesTieBreak(a, b);
+}
+
+static int compareEntriesByEta(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareEta(a->eta, b->eta);
+
+    return val != 0 ? val : compareEntriesTieBreak(a, b);
+}
+
+static int compareEntriesByName(void const* va, void const* vb)
+{
+    return compareEntriesTieBreak(va, vb);
+}
+
+static int compareEntriesByQueue(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareInt64(a->queuePosition, b->queuePosition);
+
+    return val != 0 ? val : compareEntriesTieBreak(a, b);
+}
+
+static int compareEntriesBySize(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+    int val = compareInt64((int64_t)a->sizeWhenDone, (int64_t)b->sizeWhenDone);
+
+    return val != 0 ? val : compareEntriesTieBreak(a, b);
+}
+
+static int compareEntriesById(void const* va, void const* vb)
+{
+    struct torrent_get_entry const* a = va;
+    struct torrent_get_entry const* b = vb;
+
+    return compareInt64(a->id, b->id);
+}
+
+static struct
+{
+    char const* name;
+    int (* compare)(void const*, void const*);
+}
+const sortModes[] =
+{
+    { "sort-by-activity", compareEntriesByActivity },
+    { "sort-by-age", compareEntriesByAge },
+    { "sort-by-eta", compareEntriesByEta },
+    { "sort-by-name", compareEntriesByName },
+    { "sort-by-progress", compareEntriesByProgress },
+    { "sort-by-queue", compareEntriesByQueue },
+    { "sort-by-ratio", compareEntriesByRatio },
+    { "sort-by-size", compareEntriesBySize },
+    { "sort-by-state", compareEntriesByState },
+    { "sort-by-id", compareEntriesById }
+};
+
+static bool hasTorrentListArgs(tr_variant* args_in)
+{
+    static tr_quark const keys[] =
+    {
+        TR_KEY_filter_label,
+        TR_KEY_filter_mode,
+        TR_KEY_filter_text,
+        TR_KEY_filter_trackers,
+        TR_KEY_limit,
+        TR_KEY_offset,
+        TR_KEY_sort_mode,
+        TR_KEY_sort_reversed
+    };
+
+    for (size_t i = 0; i < TR_N_ELEMENTS(keys); ++i)
+    {
+        if (tr_variantDictFind(args_in, keys[i]) != NULL)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Filter, sort, and page `torrents' in place */
+static char const* applyTorrentListArgs(tr_session* session, tr_variant* args_in, tr_torrent** torrents, int* torrentCount,
+    int64_t* setme_total)
+{
+    int n = 0;
+    int filterMode = FILTER_SHOW_ALL;
+    int (* compare)(void const*, void const*) = NULL;
+    bool reversed = false;
+    int64_t offset = 0;
+    int64_t limit = INT64_MAX;
+    char const* label = NULL;
+    char const* text = NULL;
+    char const* trackers = NULL;
+    char const* str;
+    int* ids;
+    tr_brief_stat* stats;
+    struct torrent_get_entry* entries;
+
+    if (tr_variantDictFindStr(args_in, TR_KEY_filter_mode, &str, NULL))
+    {
+        filterMode = -1;
+
+        for (size_t i = 0; filterMode == -1 && i < TR_N_ELEMENTS(filterModeNames); ++i)
+        {
+            if (strcmp(str, filterModeNames[i]) == 0)
+            {
+                filterMode = i;
+            }
+        }
+
+        if (filterMode == -1)
+        {
+            return "invalid filter-mode";
+        }
+    }
+
+    if (tr_variantDictFindStr(args_in, TR_KEY_sort_mode, &str, NULL))
+    {
+        for (size_t i = 0; compare == NULL && i < TR_N_ELEMENTS(sortModes); ++i)
+        {
+            if (strcmp(str, sortModes[i].name) == 0)
+            {
+                compare = sortModes[i].compare;
+            }
+        }
+
+        if (compare == NULL)
+        {
+            return "invalid sort-mode";
+        }
+    }
+
+    if ((tr_variantDictFindInt(args_in, TR_KEY_offset, &offset) && offset < 0) ||
+        (tr_variantDictFindInt(args_in, TR_KEY_limit, &limit) && limit < 0))
+    {
+        return "invalid offset or limit";
+    }
+
+    tr_variantDictFindBool(args_in, TR_KEY_sort_reversed, &reversed);
+    tr_variantDictFindStr(args_in, TR_KEY_filter_label, &label, NULL);
+    tr_variantDictFindStr(args_in, TR_KEY_filter_text, &text, NULL);
+    tr_variantDictFindStr(args_in, TR_KEY_filter_trackers, &trackers, NULL);
+
+    if (tr_str_is_empty(text))
+    {
+        text = NULL;
+    }
+
+    if (tr_str_is_empty(trackers))
+    {
+        trackers = NULL;
+    }
+
+    ids = tr_new(int, *torrentCount);
+    stats = tr_new(tr_brief_stat, *torrentCount);
+    entries = tr_new(struct torrent_get_entry, *torrentCount);
+
+    for (int i = 0; i < *torrentCount; ++i)
+    {
+        ids[i] = tr_torrentId(torrents[i]);
+    }
+
+    tr_torrentsStat(session, ids, *torrentCount, stats);
+
+    for (int i = 0; i < *torrentCount; ++i)
+    {
+        tr_torrent* tor = torrents[i];
+        tr_brief_stat const* st = &stats[i];
+        struct torrent_get_entry* e;
+
+        if (!statMatchesFilterMode(st, filterMode) ||
+            (label != NULL && !torrentHasLabel(tor, label)) ||
+            (text != NULL && tr_strcasestr(tr_torrentName(tor), text) == NULL) ||
+            (trackers != NULL && !torrentHasTrackerSubstring(tor, trackers)))
+        {
+            continue;
+        }
+
+        e = &entries[n++];
+        e->tor = tor;
+        e->name = tr_torrentName(tor);
+        e->sizeWhenDone = st->sizeWhenDone;
+        e->addedDate = st->addedDate;
+        e->percentDone = st->percentDone;
+        e->ratio = st->ratio;
+        e->speed = st->pieceDownloadSpeed_KBps + st->pieceUploadSpeed_KBps;
+        e->peers = st->peersGettingFromUs + st->webseedsSendingToUs;
+        e->eta = st->eta;
+        e->queuePosition = st->queuePosition;
+        e->id = st->id;
+        e->activity = st->activity;
+        e->hasError = st->error != TR_STAT_OK;
+        e->hasMetadata = tr_torrentHasMetadata(tor);
+    }
+
+    *setme_total = n;
+
+    if (compare != NULL)
+    {
+        qsort(entries, n, sizeof(struct torrent_get_entry), compare);
+    }
+
+    /* the sort modes break ties, so reversing them is well-defined */
+    if (reversed)
+    {
+        for (int i = 0, j = n - 1; i < j; ++i, --j)
+        {
+            struct torrent_get_entry const tmp = entries[i];
+            entries[i] = entries[j];
+            entries[j] = tmp;
+        }
+    }
+
+    offset = MIN(offset, n);
+    limit = MIN(limit, n - offset);
+    *torrentCount = limit;
+
+    for (int64_t i = 0; i < limit; ++i)
+    {
+        torrents[i] = entries[offset + i].tor;
+    }
+
+    tr_free(entries);
+    tr_free(stats);
+    tr_free(ids);
+    return NULL;
+}
+
 static char const* torrentGet(tr_session* session, tr_variant* args_in, tr_variant* args_out,
     struct tr_rpc_idle_data* idle_data UNUSED)
 {
     TR_ASSERT(idle_data == NULL);
 
     int torrentCount;
+    int64_t total;
     tr_torrent** torrents = getTorrents(session, args_in, &torrentCount);
-    tr_variant* list = tr_variantDictAddList(args_out, TR_KEY_torrents, torrentCount);
+    tr_variant* list;
     tr_variant* fields;
     char const* strVal;
     char const* errmsg = NULL;
 
+    /* filtering and sorting only need each torrent's brief stats;
+       the full stats are only looked at for the page that's returned */
+    if (hasTorrentListArgs(args_in))
+    {
+        errmsg = applyTorrentListArgs(session, args_in, torrents, &torrentCount, &total);
+
+        if (errmsg != NULL)
+        {
+            tr_free(torrents);
+            return errmsg;
+        }
+
+        tr_variantDictAddInt(args_out, TR_KEY_total, total);
+    }
+
+    list = tr_variantDictAddList(args_out, TR_KEY_torrents, torrentCount);
+
     if (tr_variantDictFindStr(args_in, TR_KEY_ids, &strVal, NULL) && strcmp(strVal, "recently-active") == 0)
     {
         int n = 0;
@@ -934,7 +1386,7 @@ static char const* torrentGet(tr_session* session, tr_variant* args_in, tr_varia
     {
         for (int i = 0; i < torrentCount; ++i)
         {
-            addInfo(torrents[i], tr_variantListAdd(list), fields);
+            addInfo(torrents[i], tr_torrentStat(torrents[i]), tr_variantListAdd(list), fields);
         }
     }
 
@@ -1560,6 +2012,15 @@ static char const* portTest(tr_session* session, tr_variant* args_in UNUSED, tr_
 ****
 ***/
 
+static void onBlocklistCompiled(tr_session* session UNUSED, char const* contentFilename, int ruleCount, void* user_data)
+{
+    struct tr_rpc_idle_data* data = user_data;
+
+    tr_sys_path_remove(contentFilename, NULL);
+    tr_variantDictAddInt(data->args_out, TR_KEY_blocklist_size, ruleCount);
+    tr_idle_function_done(data, "success");
+}
+
 static void gotNewBlocklist(tr_session* session, bool did_connect UNUSED, bool did_timeout UNUSED, long response_code,
     void const* response, size_t response_byte_count, void* user_data)
 {
@@ -1576,92 +2037,41 @@ static void gotNewBlocklist(tr_session* session, bool did_connect UNUSED, bool d
     else /* successfully fetched the blocklist... */
     {
         tr_sys_file_t fd;
-        int err;
-        char* filename;
-        z_stream stream;
-        char const* configDir = tr_sessionGetConfigDir(session);
-        size_t const buflen = 1024 * 128; /* 128 KiB buffer */
-        uint8_t* buf = tr_valloc(buflen);
         tr_error* error = NULL;
+        char* filename = tr_buildPath(tr_sessionGetConfigDir(session), "blocklist.tmp.XXXXXX", NULL);
 
-        /* this is an odd Magic Number required by zlib to enable gz support.
-           See zlib's inflateInit2() documentation for a full description */
-        int const windowBits = 15 + 32;
-
-        stream.zalloc = (alloc_func)Z_NULL;
-        stream.zfree = (free_func)Z_NULL;
-        stream.opaque = (voidpf)Z_NULL;
-        stream.next_in = (void*)response;
-        stream.avail_in = response_byte_count;
-        inflateInit2(&stream, windowBits);
-
-        filename = tr_buildPath(configDir, "blocklist.tmp.XXXXXX", NULL);
+        /* save it as-is; the blocklist compiler inflates gzip and zip files itself */
         fd = tr_sys_file_open_temp(filename, &error);
 
-        if (fd == TR_BAD_SYS_FILE)
+        if (fd == TR_BAD_SYS_FILE || !tr_sys_file_write(fd, response, response_byte_count, NULL, &error))
         {
             tr_snprintf(result, sizeof(result), _("Couldn't save file \"%1$s\": %2$s"), filename, error->message);
             tr_error_clear(&error);
         }
 
-        for (;;)
+        if (fd != TR_BAD_SYS_FILE)
         {
-            stream.next_out = (void*)buf;
-            stream.avail_out = buflen;
-            err = inflate(&stream, Z_NO_FLUSH);
-
-            if (stream.avail_out < buflen)
-            {
-                if (!tr_sys_file_write(fd, buf, buflen - stream.avail_out, NULL, &error))
-                {
-                    tr_snprintf(result, sizeof(result), _("Couldn't save file \"%1$s\": %2$s"), filename, error->message);
-                    tr_error_clear(&error);
-                    break;
-                }
-            }
-
-            if (err != Z_OK)
-            {
-                if (err != Z_STREAM_END && err != Z_DATA_ERROR)
-                {
-                    tr_snprintf(result, sizeof(result), _("Error uncompressing blocklist: %s (%d)"), zError(err), err);
-                }
-
-                break;
-            }
+            tr_sys_file_close(fd, NULL);
         }
 
-        inflateEnd(&stream);
-
-        if (err == Z_DATA_ERROR) /* couldn't inflate it... it's probably already uncompressed */
-        {
-            if (!tr_sys_file_write(fd, response, response_byte_count, NULL, &error))
-            {
-                tr_snprintf(result, sizeof(result), _("Couldn't save file \"%1$s\": %2$s"), filename, error->message);
-                tr_error_clear(&error);
-            }
-        }
-
-        tr_sys_file_close(fd, NULL);
-
         if (!tr_str_is_empty(result))
         {
             tr_logAddError("%s", result);
+            tr_sys_path_remove(filename, NULL);
         }
         else
         {
-            /* feed it to the session and give the client a response */
-            int const rule_count = tr_blocklistSetContent(session, filename);
-            tr_variantDictAddInt(data->args_out, TR_KEY_blocklist_size, rule_count);
-            tr_snprintf(result, sizeof(result), "success");
+            /* compile it in a worker thread and give the client a response when it's in use */
+            tr_sessionSetBlocklistContentAsync(session, filename, onBlocklistCompiled, data);
         }
 
-        tr_sys_path_remove(filename, NULL);
         tr_free(filename);
-        tr_free(buf);
     }
 
-    tr_idle_function_done(data, result);
+    if (!tr_str_is_empty(result))
+    {
+        tr_idle_function_done(data, result);
+    }
 }
 
 static char const* blocklistUpdate(tr_session* session, tr_variant* args_in UNUSED, tr_variant* args_out UNUSED,
@@ -1712,7 +2122,7 @@ static void addTorrentImpl(struct tr_rpc_idle_data* data, tr_ctor* ctor)
         tr_variantListAddStr(&fields, "id");
         tr_variantListAddStr(&fields, "name");
         tr_variantListAddStr(&fields, "hashString");
-        addInfo(tor, tr_variantDictAdd(data->args_out, key), &fields);
+        addInfo(tor, tr_torrentStat(tor), tr_variantDictAdd(data->args_out, key), &fields);
 
         if (result == NULL)
         {
@@ -2601,7 +3011,7 @@ static void noop_response_callback(tr_session* session UNUSED, tr_variant* respo
 {
 }
 
-void tr_rpc_request_exec_json(tr_session* session, tr_variant const* request, tr_rpc_response_func callback,
+static void rpc_request_exec_one(tr_session* session, tr_variant const* request, tr_rpc_response_func callback,
     void* callback_user_data)
 {
     char const* str;
@@ -2707,6 +3117,118 @@ void tr_rpc_request_exec_json(tr_session* session, tr_variant const* request, tr
     }
 }
 
+/***
+****  Batch requests: a JSON array of requests gets a JSON array of
+****  responses back, in the same order, once the last one is done.
+***/
+
+struct rpc_batch;
+
+struct rpc_batch_item
+{
+    struct rpc_batch* batch;
+    size_t index;
+};
+
+struct rpc_batch
+{
+    tr_variant responses;
+    size_t pending;
+    struct rpc_batch_item* items;
+    tr_rpc_response_func callback;
+    void* callback_user_data;
+};
+
+static void rpc_batch_unref(tr_session* session, struct rpc_batch* batch)
+{
+    TR_ASSERT(batch->pending > 0);
+
+    if (--batch->pending == 0)
+    {
+        (*batch->callback)(session, &batch->responses, batch->callback_user_data);
+
+        tr_variantFree(&batch->responses);
+        tr_free(batch->items);
+        tr_free(batch);
+    }
+}
+
+static void rpc_batch_response_func(tr_session* session, tr_variant* response, void* user_data)
+{
+    struct rpc_batch_item* item = user_data;
+    struct rpc_batch* batch = item->batch;
+
+    /* take ownership of the response instead of copying it */
+    *tr_variantListChild(&batch->responses, item->index) = *response;
+    tr_variantInitBool(response, false);
+
+    rpc_batch_unref(session, batch);
+}
+
+static void rpc_request_exec_batch(tr_session* session, tr_variant const* requests, tr_rpc_response_func callback,
+    void* callback_user_data)
+{
+    size_t const n = tr_variantListSize(requests);
+    struct rpc_batch* batch = tr_new0(struct rpc_batch, 1);
+
+    /* the extra reference keeps `batch' alive while we're still walking
+     * the list, since the immediate methods respond before returning */
+    batch->pending = n + 1;
+    batch->items = tr_new(struct rpc_batch_item, n);
+    batch->callback = callback;
+    batch->callback_user_data = callback_user_data;
+    tr_variantInitList(&batch->responses, n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        tr_variantListAddBool(&batch->responses, false);
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        tr_variant* const request = tr_variantListChild(requests, i);
+        struct rpc_batch_item* const item = &batch->items[i];
+
+        item->batch = batch;
+        item->index = i;
+
+        if (tr_variantIsDict(request))
+        {
+            rpc_request_exec_one(session, request, rpc_batch_response_func, item);
+        }
+        else
+        {
+            tr_variant response;
+
+            tr_variantInitDict(&response, 2);
+            tr_variantDictAddDict(&response, TR_KEY_arguments, 0);
+            tr_variantDictAddStr(&response, TR_KEY_result, "request is not an object");
+            rpc_batch_response_func(session, &response, item);
+            tr_variantFree(&response);
+        }
+    }
+
+    rpc_batch_unref(session, batch);
+}
+
+void tr_rpc_request_exec_json(tr_session* session, tr_variant const* request, tr_rpc_response_func callback,
+    void* callback_user_data)
+{
+    if (callback == NULL)
+    {
+        callback = noop_response_callback;
+    }
+
+    if (request != NULL && tr_variantIsList(request))
+    {
+        rpc_request_exec_batch(session, request, callback, callback_user_data);
+    }
+    else
+    {
+        rpc_request_exec_one(session, request, callback, callback_user_data);
+    }
+}
+
 /**
  * Munge the URI into a usable form.
  *
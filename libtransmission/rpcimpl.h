@@ -22,7 +22,9 @@ extern "C"
 
 typedef void (* tr_rpc_response_func)(tr_session* session, tr_variant* response, void* user_data);
 
-/* http://www.json.org/ */
+/* http://www.json.org/
+ * `request' may also be a list of requests, in which case `callback' is
+ * called once, with a list of their responses in the same order */
 void tr_rpc_request_exec_json(tr_session* session, tr_variant const* request, tr_rpc_response_func callback,
     void* callback_user_data);
 
@@ -373,6 +373,7 @@ void tr_sessionGetDefaultSettings(tr_variant* d)
     tr_variantDictAddBool(d, TR_KEY_rpc_whitelist_enabled, true);
     tr_variantDictAddStr(d, TR_KEY_rpc_host_whitelist, TR_DEFAULT_RPC_HOST_WHITELIST);
     tr_variantDictAddBool(d, TR_KEY_rpc_host_whitelist_enabled, true);
+    tr_variantDictAddInt(d, TR_KEY_rpc_idle_timeout, 60);
     tr_variantDictAddInt(d, TR_KEY_rpc_port, atoi(TR_DEFAULT_RPC_PORT_STR));
     tr_variantDictAddStr(d, TR_KEY_rpc_url, TR_DEFAULT_RPC_URL_STR);
     tr_variantDictAddBool(d, TR_KEY_scrape_paused_torrents_enabled, true);
@@ -1355,6 +1356,7 @@ void tr_sessionSetRatioLimited(tr_session* session, bool isLimited)
     TR_ASSERT(tr_isSession(session));
 
     session->isRatioLimited = isLimited;
+    ++session->statGeneration;
 }
 
 void tr_sessionSetRatioLimit(tr_session* session, double desiredRatio)
@@ -1362,6 +1364,7 @@ void tr_sessionSetRatioLimit(tr_session* session, double desiredRatio)
     TR_ASSERT(tr_isSession(session));
 
     session->desiredRatio = desiredRatio;
+    ++session->statGeneration;
 }
 
 bool tr_sessionIsRatioLimited(tr_session const* session)
@@ -1387,6 +1390,7 @@ void tr_sessionSetIdleLimited(tr_session* session, bool isLimited)
     TR_ASSERT(tr_isSession(session));
 
     session->isIdleLimited = isLimited;
+    ++session->statGeneration;
 }
 
 void tr_sessionSetIdleLimit(tr_session* session, uint16_t idleMinutes)
@@ -1394,6 +1398,7 @@ void tr_sessionSetIdleLimit(tr_session* session, uint16_t idleMinutes)
     TR_ASSERT(tr_isSession(session));
 
     session->idleLimitMinutes = idleMinutes;
+    ++session->statGeneration;
 }
 
 bool tr_sessionIsIdleLimited(tr_session const* session)
@@ -2037,6 +2042,22 @@ void tr_sessionClose(tr_session* session)
     dbgmsg("shutting down transmission session %p... now is %zu, deadline is %zu", (void*)session, (size_t)time(NULL),
         (size_t)deadline);
 
+    /* blocklist compiles report back in the libtransmission thread and use
+     * the session until they do, so they have to finish before it closes,
+     * however long that takes. No new ones start from here on */
+    tr_sessionLock(session);
+    session->isBlocklistCompileStopped = true;
+
+    while (session->blocklistCompileCount > 0)
+    {
+        dbgmsg("waiting for %d blocklist(s) to compile", session->blocklistCompileCount);
+        tr_sessionUnlock(session);
+        tr_wait_msec(50);
+        tr_sessionLock(session);
+    }
+
+    tr_sessionUnlock(session);
+
     /* close the session */
     tr_runInEventThread(session, sessionCloseImpl, session);
 
@@ -2401,6 +2422,24 @@ static bool tr_stringEndsWith(char const* str, char const* end)
     return slen >= elen && memcmp(&str[slen - elen], end, elen) == 0;
 }
 
+static void rebuildBlocklistIndex(tr_session* session)
+{
+    int const n = tr_list_size(session->blocklists);
+    tr_blocklistFile** files = tr_new(tr_blocklistFile*, n);
+    tr_blocklistIndex* old = session->blocklistIndex;
+    int i = 0;
+
+    for (tr_list* l = session->blocklists; l != NULL; l = l->next)
+    {
+        files[i++] = l->data;
+    }
+
+    session->blocklistIndex = tr_blocklistIndexNew(files, n);
+
+    tr_blocklistIndexFree(old);
+    tr_free(files);
+}
+
 static void loadBlocklists(tr_session* session)
 {
     tr_sys_dir_t odir;
@@ -2515,16 +2554,20 @@ static void loadBlocklists(tr_session* session)
     tr_free(dirname);
     tr_ptrArrayDestruct(&loadme, (PtrArrayForeachFunc)tr_free);
     session->blocklists = blocklists;
+    rebuildBlocklistIndex(session);
 }
 
 static void closeBlocklists(tr_session* session)
 {
+    tr_blocklistIndexFree(session->blocklistIndex);
+    session->blocklistIndex = NULL;
     tr_list_free(&session->blocklists, (TrListForeachFunc)tr_blocklistFileFree);
 }
 
 void tr_sessionReloadBlocklists(tr_session* session)
 {
-    closeBlocklists(session);
+    /* keep the old index until loadBlocklists() swaps in the new one */
+    tr_list_free(&session->blocklists, (TrListForeachFunc)tr_blocklistFileFree);
     loadBlocklists(session);
 
     tr_peerMgrOnBlocklistChanged(session->peerMgr);
@@ -2570,47 +2613,196 @@ bool tr_blocklistExists(tr_session const* session)
     return session->blocklists != NULL;
 }
 
-int tr_blocklistSetContent(tr_session* session, char const* contentFilename)
+/* Compiling a big list takes a while, so it's compiled into a temporary
+ * file without holding the session lock. Returns that file's name, or
+ * NULL if the list couldn't be read */
+static char* blocklistCompile(tr_session* session, char const* contentFilename, int* setme_rule_count)
 {
-    int ruleCount;
+    tr_sys_file_t fd;
+    tr_blocklistFile* b;
+    tr_sys_path_info info;
+    char* compiled = tr_buildPath(session->configDir, "blocklist.bin.XXXXXX", NULL);
+
+    *setme_rule_count = 0;
+    fd = tr_sys_file_open_temp(compiled, NULL);
+
+    if (fd == TR_BAD_SYS_FILE)
+    {
+        tr_free(compiled);
+        return NULL;
+    }
+
+    tr_sys_file_close(fd, NULL);
+
+    b = tr_blocklistFileNew(compiled, session->isBlocklistEnabled);
+    *setme_rule_count = tr_blocklistFileSetContent(b, contentFilename);
+    tr_blocklistFileFree(b);
+
+    /* a compiled list is never empty; it has a header */
+    if (!tr_sys_path_get_info(compiled, 0, &info, NULL) || info.size == 0)
+    {
+        tr_sys_path_remove(compiled, NULL);
+        tr_free(compiled);
+        return NULL;
+    }
+
+    return compiled;
+}
+
+/* Replace the default blocklist with `compiled', or remove it if that's NULL.
+ * Lookups keep using the old index until the new one is swapped in */
+static void blocklistInstall(tr_session* session, char const* compiled)
+{
+    char* path = NULL;
     tr_blocklistFile* b = NULL;
-    char const* defaultName = DEFAULT_BLOCKLIST_FILENAME;
-    tr_sessionLock(session);
+
+    TR_ASSERT(tr_sessionIsLocked(session));
 
     for (tr_list* l = session->blocklists; b == NULL && l != NULL; l = l->next)
     {
-        if (tr_stringEndsWith(tr_blocklistFileGetFilename(l->data), defaultName))
+        if (tr_stringEndsWith(tr_blocklistFileGetFilename(l->data), DEFAULT_BLOCKLIST_FILENAME))
         {
             b = l->data;
         }
     }
 
-    if (b == NULL)
+    if (b != NULL)
     {
-        char* path = tr_buildPath(session->configDir, "blocklists", defaultName, NULL);
-        b = tr_blocklistFileNew(path, session->isBlocklistEnabled);
-        tr_list_append(&session->blocklists, b);
-        tr_free(path);
+        path = tr_strdup(tr_blocklistFileGetFilename(b));
+        tr_list_remove_data(&session->blocklists, b);
+        tr_blocklistFileFree(b);
+    }
+    else
+    {
+        path = tr_buildPath(session->configDir, "blocklists", DEFAULT_BLOCKLIST_FILENAME, NULL);
+    }
+
+    if (compiled == NULL)
+    {
+        tr_sys_path_remove(path, NULL);
+    }
+    else if (tr_sys_path_rename(compiled, path, NULL))
+    {
+        tr_list_append(&session->blocklists, tr_blocklistFileNew(path, session->isBlocklistEnabled));
+    }
+    else
+    {
+        tr_sys_path_remove(compiled, NULL);
+    }
+
+    rebuildBlocklistIndex(session);
+    tr_free(path);
+}
+
+int tr_blocklistSetContent(tr_session* session, char const* contentFilename)
+{
+    int ruleCount = 0;
+    char* compiled = NULL;
+
+    if (contentFilename != NULL)
+    {
+        compiled = blocklistCompile(session, contentFilename, &ruleCount);
+    }
+
+    tr_sessionLock(session);
+
+    if (contentFilename == NULL || compiled != NULL)
+    {
+        blocklistInstall(session, compiled);
     }
 
-    ruleCount = tr_blocklistFileSetContent(b, contentFilename);
     tr_sessionUnlock(session);
+    tr_free(compiled);
     return ruleCount;
 }
 
-bool tr_sessionIsAddressBlocked(tr_session const* session, tr_address const* addr)
+struct blocklist_compile_data
+{
+    tr_session* session;
+    char* contentFilename;
+    char* compiled;
+    int ruleCount;
+    tr_blocklist_done_func callback;
+    void* callback_user_data;
+};
+
+static void onBlocklistCompiled(void* vdata)
+{
+    struct blocklist_compile_data* data = vdata;
+    tr_session* session = data->session;
+
+    tr_sessionLock(session);
+
+    if (data->compiled != NULL)
+    {
+        blocklistInstall(session, data->compiled);
+    }
+
+    --session->blocklistCompileCount;
+    tr_sessionUnlock(session);
+
+    if (data->callback != NULL)
+    {
+        (*data->callback)(session, data->contentFilename, data->ruleCount, data->callback_user_data);
+    }
+
+    tr_free(data->compiled);
+    tr_free(data->contentFilename);
+    tr_free(data);
+}
+
+static void blocklistCompileThreadFunc(void* vdata)
+{
+    struct blocklist_compile_data* data = vdata;
+
+    data->compiled = blocklistCompile(data->session, data->contentFilename, &data->ruleCount);
+    tr_runInEventThread(data->session, onBlocklistCompiled, data);
+}
+
+void tr_sessionSetBlocklistContentAsync(tr_session* session, char const* contentFilename, tr_blocklist_done_func callback,
+    void* callback_user_data)
 {
     TR_ASSERT(tr_isSession(session));
+    TR_ASSERT(contentFilename != NULL);
 
-    for (tr_list* l = session->blocklists; l != NULL; l = l->next)
+    struct blocklist_compile_data* data = tr_new0(struct blocklist_compile_data, 1);
+    data->session = session;
+    data->contentFilename = tr_strdup(contentFilename);
+    data->callback = callback;
+    data->callback_user_data = callback_user_data;
+
+    tr_sessionLock(session);
+
+    if (session->isBlocklistCompileStopped)
     {
-        if (tr_blocklistFileHasAddress(l->data, addr))
+        tr_sessionUnlock(session);
+
+        if (callback != NULL)
         {
-            return true;
+            (*callback)(session, contentFilename, 0, callback_user_data);
         }
+
+        tr_free(data->contentFilename);
+        tr_free(data);
+        return;
     }
 
-    return false;
+    ++session->blocklistCompileCount;
+    tr_sessionUnlock(session);
+
+    tr_threadNew(blocklistCompileThreadFunc, data);
+}
+
+bool tr_sessionIsAddressBlocked(tr_session const* session, tr_address const* addr)
+{
+    TR_ASSERT(tr_isSession(session));
+
+    if (!session->isBlocklistEnabled || session->blocklistIndex == NULL)
+    {
+        return false;
+    }
+
+    return tr_blocklistIndexHasAddress(session->blocklistIndex, addr);
 }
 
 void tr_blocklistSetURL(tr_session* session, char const* url)
@@ -2898,6 +3090,7 @@ void tr_sessionSetQueueEnabled(tr_session* session, tr_direction dir, bool is_en
     TR_ASSERT(tr_isDirection(dir));
 
     session->queueEnabled[dir] = is_enabled;
+    ++session->statGeneration;
 }
 
 bool tr_sessionGetQueueEnabled(tr_session const* session, tr_direction dir)
@@ -2914,6 +3107,7 @@ void tr_sessionSetQueueStalledMinutes(tr_session* session, int minutes)
     TR_ASSERT(minutes > 0);
 
     session->queueStalledMinutes = minutes;
+    ++session->statGeneration;
 }
 
 void tr_sessionSetQueueStalledEnabled(tr_session* session, bool is_enabled)
@@ -2921,6 +3115,7 @@ void tr_sessionSetQueueStalledEnabled(tr_session* session, bool is_enabled)
     TR_ASSERT(tr_isSession(session));
 
     session->stalledEnabled = is_enabled;
+    ++session->statGeneration;
 }
 
 bool tr_sessionGetQueueStalledEnabled(tr_session const* session)
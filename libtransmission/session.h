@@ -123,6 +123,9 @@ struct tr_session
     int queueSize[2];
     int queueStalledMinutes;
 
+    /* bumped when a setting that the torrents' tr_stat depend on changes */
+    unsigned int statGeneration;
+
     int umask;
 
     unsigned int speedLimit_Bps[2];
@@ -189,6 +192,9 @@ struct tr_session
     struct tr_device_info* downloadDir;
 
     struct tr_list* blocklists;
+    struct tr_blocklistIndex* blocklistIndex; /* all of `blocklists', merged */
+    int blocklistCompileCount; /* protected by the session lock */
+    bool isBlocklistCompileStopped; /* set once tr_sessionClose() starts */
     struct tr_peerMgr* peerMgr;
     struct tr_shared* shared;
 
@@ -239,6 +245,18 @@ void tr_sessionSetTorrentFile(tr_session* session, char const* hashString, char
 
 bool tr_sessionIsAddressBlocked(tr_session const* session, struct tr_address const* addr);
 
+typedef void (* tr_blocklist_done_func)(tr_session* session, char const* contentFilename, int ruleCount,
+    void* user_data);
+
+/**
+ * Like tr_blocklistSetContent(), but the list is compiled in a worker thread.
+ * `callback' is invoked in the libtransmission thread once the new list is in use.
+ * If the session is closing, nothing is compiled and `callback' is invoked right away
+ * with a ruleCount of zero.
+ */
+void tr_sessionSetBlocklistContentAsync(tr_session* session, char const* contentFilename, tr_blocklist_done_func callback,
+    void* callback_user_data);
+
 void tr_sessionLock(tr_session*);
 
 void tr_sessionUnlock(tr_session*);
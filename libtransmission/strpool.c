@@ -0,0 +1,214 @@
+/*
+ * This file Copyright (C) 2017 Mnemosyne LLC
+ *
+ * It may be used under the GNU GPL versions 2 or 3
+ * or any future license endorsed by Mnemosyne LLC.
+ *
+ */
+
+#include <stddef.h> /* offsetof() */
+#include <string.h> /* memcmp(), memcpy(), strlen() */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "transmission.h"
+#include "platform.h" /* tr_lock */
+#include "strpool.h"
+#include "tr-assert.h"
+#include "utils.h"
+
+/***
+****  Each string is stored once, after a small header, in a chained
+****  hash table. Callers get a pointer to the string itself; the header
+****  is found again from that pointer when the string is released.
+***/
+
+struct pool_entry
+{
+    struct pool_entry* next;
+    size_t len;
+    uint32_t hash;
+    uint32_t refcount;
+    char str[];
+};
+
+static struct pool_entry** pool_buckets = NULL;
+static size_t pool_bucket_count = 0; /* a power of two */
+static size_t pool_size = 0;
+
+/* torrents are parsed in clients' threads too, even before a session
+ * exists, so the lock is created with a once-primitive */
+static tr_lock* pool_lock = NULL;
+
+#ifdef _WIN32
+
+static INIT_ONCE pool_lock_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK initPoolLock(PINIT_ONCE once UNUSED, PVOID param UNUSED, PVOID* context UNUSED)
+{
+    pool_lock = tr_lockNew();
+    return TRUE;
+}
+
+#else
+
+static pthread_once_t pool_lock_once = PTHREAD_ONCE_INIT;
+
+static void initPoolLock(void)
+{
+    pool_lock = tr_lockNew();
+}
+
+#endif
+
+static tr_lock* getPoolLock(void)
+{
+#ifdef _WIN32
+    InitOnceExecuteOnce(&pool_lock_once, initPoolLock, NULL, NULL);
+#else
+    pthread_once(&pool_lock_once, initPoolLock);
+#endif
+
+    return pool_lock;
+}
+
+/* FNV-1a */
+static uint32_t pool_hash(char const* str, size_t len)
+{
+    uint32_t h = 2166136261U;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= (uint8_t)str[i];
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+static void pool_grow(void)
+{
+    size_t const n = pool_bucket_count != 0 ? pool_bucket_count * 2 : 256;
+    struct pool_entry** buckets = tr_new0(struct pool_entry*, n);
+
+    for (size_t i = 0; i < pool_bucket_count; ++i)
+    {
+        struct pool_entry* e = pool_buckets[i];
+
+        while (e != NULL)
+        {
+            struct pool_entry* next = e->next;
+            size_t const slot = e->hash & (n - 1);
+            e->next = buckets[slot];
+            buckets[slot] = e;
+            e = next;
+        }
+    }
+
+    tr_free(pool_buckets);
+    pool_buckets = buckets;
+    pool_bucket_count = n;
+}
+
+char const* tr_strpoolAcquire(char const* str, size_t len)
+{
+    TR_ASSERT(str != NULL);
+
+    if (len == TR_BAD_SIZE)
+    {
+        len = strlen(str);
+    }
+
+    uint32_t const hash = pool_hash(str, len);
+    struct pool_entry* e = NULL;
+    tr_lock* lock = getPoolLock();
+
+    tr_lockLock(lock);
+
+    if (pool_bucket_count != 0)
+    {
+        for (e = pool_buckets[hash & (pool_bucket_count - 1)]; e != NULL; e = e->next)
+        {
+            if (e->hash == hash && e->len == len && memcmp(e->str, str, len) == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    if (e != NULL)
+    {
+        ++e->refcount;
+    }
+    else
+    {
+        if (pool_size >= pool_bucket_count)
+        {
+            pool_grow();
+        }
+
+        size_t const slot = hash & (pool_bucket_count - 1);
+
+        e = tr_malloc(sizeof(struct pool_entry) + len + 1);
+        e->len = len;
+        e->hash = hash;
+        e->refcount = 1;
+        memcpy(e->str, str, len);
+        e->str[len] = '\0';
+        e->next = pool_buckets[slot];
+        pool_buckets[slot] = e;
+        ++pool_size;
+    }
+
+    tr_lockUnlock(lock);
+
+    return e->str;
+}
+
+void tr_strpoolRelease(char const* str)
+{
+    if (str == NULL)
+    {
+        return;
+    }
+
+    struct pool_entry* e = (struct pool_entry*)(str - offsetof(struct pool_entry, str));
+    tr_lock* lock = getPoolLock();
+
+    tr_lockLock(lock);
+
+    TR_ASSERT(e->refcount > 0);
+
+    if (--e->refcount == 0)
+    {
+        struct pool_entry** walk = &pool_buckets[e->hash & (pool_bucket_count - 1)];
+
+        while (*walk != e)
+        {
+            TR_ASSERT(*walk != NULL);
+            walk = &(*walk)->next;
+        }
+
+        *walk = e->next;
+        --pool_size;
+        tr_free(e);
+    }
+
+    tr_lockUnlock(lock);
+}
+
+size_t tr_strpoolSize(void)
+{
+    size_t n;
+    tr_lock* lock = getPoolLock();
+
+    tr_lockLock(lock);
+    n = pool_size;
+    tr_lockUnlock(lock);
+
+    return n;
+}
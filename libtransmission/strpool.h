@@ -0,0 +1,40 @@
+/*
+ * This file Copyright (C) 2017 Mnemosyne LLC
+ *
+ * It may be used under the GNU GPL versions 2 or 3
+ * or any future license endorsed by Mnemosyne LLC.
+ *
+ */
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+/**
+ * @addtogroup utils Utilities
+ * @{
+ */
+
+#include <stddef.h> /* size_t */
+
+/**
+ * @brief return a shared, read-only copy of a string
+ *
+ * Equal strings share one copy, which lives until every caller that
+ * acquired it has released it. The pool is shared by all the sessions
+ * in the process and is safe to use from any thread.
+ *
+ * @param str the string to copy. It doesn't need to be zero-terminated.
+ * @param len the length of str, or TR_BAD_SIZE to use strlen()
+ */
+char const* tr_strpoolAcquire(char const* str, size_t len);
+
+/** @brief release a string returned by tr_strpoolAcquire(). NULL is ignored. */
+void tr_strpoolRelease(char const* str);
+
+/** @brief the number of distinct strings in the pool. Used by the tests. */
+size_t tr_strpoolSize(void);
+
+/* @} */
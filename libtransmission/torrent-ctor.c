@@ -230,20 +230,9 @@ void tr_ctorSetFilePriorities(tr_ctor* ctor, tr_file_index_t const* files, tr_fi
 
 void tr_ctorInitTorrentPriorities(tr_ctor const* ctor, tr_torrent* tor)
 {
-    for (tr_file_index_t i = 0; i < ctor->lowSize; ++i)
-    {
-        tr_torrentInitFilePriority(tor, ctor->low[i], TR_PRI_LOW);
-    }
-
-    for (tr_file_index_t i = 0; i < ctor->normalSize; ++i)
-    {
-        tr_torrentInitFilePriority(tor, ctor->normal[i], TR_PRI_NORMAL);
-    }
-
-    for (tr_file_index_t i = 0; i < ctor->highSize; ++i)
-    {
-        tr_torrentInitFilePriority(tor, ctor->high[i], TR_PRI_HIGH);
-    }
+    tr_torrentInitFilePriorities(tor, ctor->low, ctor->lowSize, TR_PRI_LOW);
+    tr_torrentInitFilePriorities(tor, ctor->normal, ctor->normalSize, TR_PRI_NORMAL);
+    tr_torrentInitFilePriorities(tor, ctor->high, ctor->highSize, TR_PRI_HIGH);
 }
 
 void tr_ctorSetFilesWanted(tr_ctor* ctor, tr_file_index_t const* files, tr_file_index_t fileCount, bool wanted)
@@ -0,0 +1,411 @@
+/*
+ * This file Copyright (C) 2017 Mnemosyne LLC
+ *
+ * It may be used under the GNU GPL versions 2 or 3
+ * or any future license endorsed by Mnemosyne LLC.
+ *
+ */
+
+#include "transmission.h"
+#include "completion.h"
+#include "inout.h"
+#include "metainfo.h"
+#include "strpool.h"
+#include "torrent.h"
+#include "tr-assert.h"
+#include "utils.h"
+#include "variant.h"
+
+#include "libtransmission-test.h"
+
+/***
+****
+***/
+
+#define PIECE_SIZE 32768
+
+/* a mix of empty files, files smaller than a piece, and files spanning several.
+   the sixth file ends on a piece boundary, so the seventh and eighth start on one */
+static uint64_t const fileLengths[] =
+{
+    0, 100000, 0, 5, 7, 4 * PIECE_SIZE - 100012, 0, 40000, 1, 1, 1, 0, 2 * PIECE_SIZE, 3, 0
+};
+
+static tr_ctor* create_ctor(tr_session* session)
+{
+    size_t len;
+    char* benc;
+    tr_ctor* ctor;
+    tr_variant top;
+    tr_variant* info;
+    tr_variant* files;
+    uint64_t totalSize = 0;
+    size_t const fileCount = TR_N_ELEMENTS(fileLengths);
+
+    for (size_t i = 0; i < fileCount; ++i)
+    {
+        totalSize += fileLengths[i];
+    }
+
+    size_t const pieceCount = (totalSize + PIECE_SIZE - 1) / PIECE_SIZE;
+    uint8_t* pieces = tr_new(uint8_t, pieceCount * SHA_DIGEST_LENGTH);
+
+    for (size_t i = 0; i < pieceCount * SHA_DIGEST_LENGTH; ++i)
+    {
+        pieces[i] = i / SHA_DIGEST_LENGTH + i % SHA_DIGEST_LENGTH;
+    }
+
+    tr_variantInitDict(&top, 1);
+    info = tr_variantDictAddDict(&top, TR_KEY_info, 4);
+    tr_variantDictAddStr(info, TR_KEY_name, "pieces-and-files");
+    tr_variantDictAddInt(info, TR_KEY_piece_length, PIECE_SIZE);
+    tr_variantDictAddRaw(info, TR_KEY_pieces, pieces, pieceCount * SHA_DIGEST_LENGTH);
+    files = tr_variantDictAddList(info, TR_KEY_files, fileCount);
+
+    for (size_t i = 0; i < fileCount; ++i)
+    {
+        char name[32];
+        tr_variant* file = tr_variantListAddDict(files, 2);
+        tr_snprintf(name, sizeof(name), "%u", (unsigned int)i);
+        tr_variantDictAddInt(file, TR_KEY_length, fileLengths[i]);
+        tr_variantListAddStr(tr_variantDictAddList(file, TR_KEY_path, 1), name);
+    }
+
+    benc = tr_variantToStr(&top, TR_VARIANT_FMT_BENC, &len);
+    ctor = tr_ctorNew(session);
+    tr_ctorSetMetainfo(ctor, (uint8_t*)benc, len);
+    tr_ctorSetPaused(ctor, TR_FORCE, true);
+
+    tr_free(benc);
+    tr_variantFree(&top);
+    tr_free(pieces);
+    return ctor;
+}
+
+static tr_torrent* create_torrent(tr_session* session)
+{
+    int err = 0;
+    tr_ctor* ctor = create_ctor(session);
+    tr_torrent* tor = tr_torrentNew(ctor, &err, NULL);
+
+    TR_ASSERT(err == 0);
+
+    tr_ctorFree(ctor);
+    return tor;
+}
+
+static bool pieceHasFile(tr_torrent const* tor, tr_piece_index_t piece, tr_file_index_t file)
+{
+    tr_file const* f = &tor->info.files[file];
+
+    return f->firstPiece <= piece && piece <= f->lastPiece;
+}
+
+/* compare the piece/file index and the values derived from it to a brute-force scan of every file */
+static int check_pieces(tr_torrent const* tor)
+{
+    tr_info const* inf = &tor->info;
+    uint64_t sizeWhenDone = 0;
+
+    for (tr_piece_index_t p = 0; p < inf->pieceCount; ++p)
+    {
+        tr_file_index_t first;
+        tr_file_index_t last;
+        bool dnd = true;
+        tr_priority_t priority = TR_PRI_LOW;
+
+        tr_torGetPieceFileRange(tor, p, &first, &last);
+
+        for (tr_file_index_t f = 0; f < inf->fileCount; ++f)
+        {
+            tr_file const* file = &inf->files[f];
+
+            check_bool(pieceHasFile(tor, p, f), ==, first <= f && f <= last);
+
+            if (pieceHasFile(tor, p, f))
+            {
+                dnd = dnd && file->dnd;
+                priority = MAX(priority, file->priority);
+
+                if (file->priority >= TR_PRI_NORMAL && (file->firstPiece == p || file->lastPiece == p))
+                {
+                    priority = TR_PRI_HIGH;
+                }
+            }
+        }
+
+        check_bool(inf->pieceDND[p], ==, dnd);
+        check_int(inf->piecePriority[p], ==, priority);
+
+        if (!dnd)
+        {
+            sizeWhenDone += tr_torPieceCountBytes(tor, p);
+        }
+    }
+
+    /* we have nothing, so that's just the wanted pieces */
+    check_uint(tr_cpSizeWhenDone(&tor->completion), ==, sizeWhenDone);
+    return 0;
+}
+
+static int test_piece_file_range(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_info const* inf;
+
+    session = libttest_session_init(NULL);
+    tor = create_torrent(session);
+    inf = &tor->info;
+    check_uint(inf->fileCount, ==, TR_N_ELEMENTS(fileLengths));
+    check_int(check_pieces(tor), ==, 0);
+
+    /* each piece gets its own slice of the metainfo's hashes */
+    for (tr_piece_index_t p = 0; p < inf->pieceCount; ++p)
+    {
+        for (size_t i = 0; i < SHA_DIGEST_LENGTH; ++i)
+        {
+            check_uint(inf->pieceHashes[p][i], ==, (uint8_t)(p + i));
+        }
+    }
+
+    /* every byte maps to the nonempty file that holds it */
+    for (uint64_t offset = 0; offset < inf->totalSize; offset += 997)
+    {
+        tr_file_index_t file;
+        uint64_t fileOffset;
+        tr_piece_index_t const piece = offset / inf->pieceSize;
+        tr_file_index_t expected = 0;
+
+        while (offset >= inf->files[expected].offset + inf->files[expected].length)
+        {
+            ++expected;
+        }
+
+        tr_ioFindFileLocation(tor, piece, offset - (uint64_t)piece * inf->pieceSize, &file, &fileOffset);
+        check_uint(file, ==, expected);
+        check_uint(fileOffset, ==, offset - inf->files[expected].offset);
+    }
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+static int test_file_priorities_and_wanted(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_file_index_t files[TR_N_ELEMENTS(fileLengths)];
+    tr_file_index_t const fileCount = TR_N_ELEMENTS(fileLengths);
+
+    session = libttest_session_init(NULL);
+    tor = create_torrent(session);
+
+    /* sorted lists, which share their boundary pieces */
+    for (tr_file_index_t i = 0; i < fileCount; ++i)
+    {
+        files[i] = i;
+    }
+
+    tr_torrentSetFilePriorities(tor, files, fileCount, TR_PRI_LOW);
+    check_int(check_pieces(tor), ==, 0);
+    tr_torrentSetFileDLs(tor, files, fileCount, false);
+    check_int(check_pieces(tor), ==, 0);
+    check_uint(tr_cpSizeWhenDone(&tor->completion), ==, 0);
+
+    /* one file at a time, in both directions */
+    for (tr_file_index_t i = 0; i < fileCount; ++i)
+    {
+        tr_torrentSetFilePriorities(tor, &i, 1, (tr_priority_t)(i % 3) - 1);
+        check_int(check_pieces(tor), ==, 0);
+        tr_torrentSetFileDLs(tor, &i, 1, i % 2 == 0);
+        check_int(check_pieces(tor), ==, 0);
+    }
+
+    for (tr_file_index_t i = fileCount; i-- > 0;)
+    {
+        tr_torrentSetFilePriorities(tor, &i, 1, TR_PRI_NORMAL);
+        check_int(check_pieces(tor), ==, 0);
+        tr_torrentSetFileDLs(tor, &i, 1, i % 2 != 0);
+        check_int(check_pieces(tor), ==, 0);
+    }
+
+    /* an unsorted list, with a bad index to be skipped */
+    files[0] = 12;
+    files[1] = 3;
+    files[2] = fileCount;
+    files[3] = 4;
+    files[4] = 1;
+    files[5] = 11;
+    tr_torrentSetFilePriorities(tor, files, 6, TR_PRI_HIGH);
+    check_int(check_pieces(tor), ==, 0);
+    tr_torrentSetFileDLs(tor, files, 6, true);
+    check_int(check_pieces(tor), ==, 0);
+    tr_torrentSetFileDLs(tor, files, 6, false);
+    check_int(check_pieces(tor), ==, 0);
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+static int test_shared_strings(void)
+{
+    tr_info info;
+    tr_ctor* ctor;
+    tr_session* session;
+    tr_torrent* tor;
+    size_t const poolSize = tr_strpoolSize();
+    size_t const fileCount = TR_N_ELEMENTS(fileLengths);
+
+    session = libttest_session_init(NULL);
+    ctor = create_ctor(session);
+    tor = tr_torrentNew(ctor, NULL, NULL);
+    check(tor != NULL);
+
+    /* one string for each file's path, and one for the piece hashes */
+    check_uint(tr_strpoolSize(), ==, poolSize + fileCount + 1);
+
+    /* parsing the same metainfo again shares the first copy's storage */
+    check_int(tr_torrentParse(ctor, &info), ==, TR_PARSE_DUPLICATE);
+    check_uint(tr_strpoolSize(), ==, poolSize + fileCount + 1);
+    check(info.pieceHashes == tor->info.pieceHashes);
+
+    for (tr_file_index_t i = 0; i < fileCount; ++i)
+    {
+        check(info.files[i].name == tor->info.files[i].name);
+    }
+
+    /* a renamed file gets a string of its own */
+    tr_strpoolRelease(info.files[0].name);
+    info.files[0].name = tr_strpoolAcquire("pieces-and-files/renamed", TR_BAD_SIZE);
+    check_uint(tr_strpoolSize(), ==, poolSize + fileCount + 2);
+    check_str(tor->info.files[0].name, ==, "pieces-and-files/0");
+
+    tr_metainfoFree(&info);
+    check_uint(tr_strpoolSize(), ==, poolSize + fileCount + 1);
+
+    tr_torrentRemove(tor, false, NULL);
+    tr_ctorFree(ctor);
+    libttest_session_close(session);
+    check_uint(tr_strpoolSize(), ==, poolSize);
+    return 0;
+}
+
+static int test_stat_snapshot(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_stat const* st;
+
+    session = libttest_session_init(NULL);
+    tor = create_torrent(session);
+
+    st = tr_torrentStat(tor);
+    check_int(st->activity, ==, TR_STATUS_STOPPED);
+    check_uint(st->haveValid, ==, 0);
+    check_int(tor->statDirty, ==, 0);
+
+    /* a paused torrent's snapshot isn't recomputed until something marks it dirty */
+    tor->secondsSeeding = 100;
+    st = tr_torrentStat(tor);
+    check_int(st->secondsSeeding, ==, 0);
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
+    st = tr_torrentStat(tor);
+    check_int(st->secondsSeeding, ==, 100);
+
+    /* getting a piece marks the progress fields dirty */
+    tr_torrentSetHasPiece(tor, 0, true);
+    check_int(tor->statDirty & TR_STAT_DIRTY_PROGRESS, !=, 0);
+    st = tr_torrentStat(tor);
+    check_uint(st->haveValid, ==, PIECE_SIZE);
+    check_uint(st->leftUntilDone, ==, tor->info.totalSize - PIECE_SIZE);
+
+    /* so do session settings that the stats depend on */
+    for (tr_piece_index_t p = 0; p < tor->info.pieceCount; ++p)
+    {
+        tr_torrentSetHasPiece(tor, p, true);
+    }
+
+    tr_torrentRecheckCompleteness(tor);
+    st = tr_torrentStat(tor);
+    check_uint(st->haveValid, ==, tor->info.totalSize);
+    check(st->seedRatioPercentDone > 0.99);
+    tr_sessionSetRatioLimit(session, 2.0);
+    tr_sessionSetRatioLimited(session, true);
+    st = tr_torrentStat(tor);
+    check(st->seedRatioPercentDone < 0.01);
+    tr_sessionSetRatioLimited(session, false);
+    st = tr_torrentStat(tor);
+    check(st->seedRatioPercentDone > 0.99);
+
+    tr_torrentRemove(tor, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+static int test_bulk_stat(void)
+{
+    tr_session* session;
+    tr_torrent* tor;
+    tr_torrent* zero;
+    tr_brief_stat stats[4];
+    int ids[4];
+
+    session = libttest_session_init(NULL);
+    tor = create_torrent(session);
+    zero = libttest_zero_torrent_init(session);
+    tr_torrentSetHasPiece(tor, 1, true);
+
+    /* all of them, in the session's order */
+    check_int(tr_torrentsStat(session, NULL, 4, stats), ==, 2);
+    check_int(stats[0].id, ==, tr_torrentId(tor));
+    check_int(stats[1].id, ==, tr_torrentId(zero));
+    check(stats[0].percentDone > 0 && stats[0].percentDone < 1);
+    check_int(stats[0].queuePosition, ==, tr_torrentStat(tor)->queuePosition);
+    check_uint(stats[0].sizeWhenDone, ==, tr_torrentStat(tor)->sizeWhenDone);
+    check_uint(stats[1].sizeWhenDone, ==, tr_torrentStat(zero)->sizeWhenDone);
+
+    /* no more than will fit */
+    check_int(tr_torrentsStat(session, NULL, 1, stats), ==, 1);
+    check_int(stats[0].id, ==, tr_torrentId(tor));
+
+    /* the ids that were asked for, in the order they were asked for */
+    ids[0] = tr_torrentId(zero);
+    ids[1] = 9999;
+    ids[2] = tr_torrentId(tor);
+    ids[3] = tr_torrentId(zero);
+    check_int(tr_torrentsStat(session, ids, 4, stats), ==, 3);
+    check_int(stats[0].id, ==, tr_torrentId(zero));
+    check_int(stats[1].id, ==, 0);
+    check_int(stats[2].id, ==, tr_torrentId(tor));
+    check_int(stats[3].id, ==, tr_torrentId(zero));
+    check_uint(stats[2].sizeWhenDone, ==, tr_torrentStat(tor)->sizeWhenDone);
+    check_int(stats[3].queuePosition, ==, tr_torrentStat(zero)->queuePosition);
+
+    check_int(tr_torrentsStat(session, ids, 0, stats), ==, 0);
+
+    tr_torrentRemove(tor, false, NULL);
+    tr_torrentRemove(zero, false, NULL);
+    libttest_session_close(session);
+    return 0;
+}
+
+/***
+****
+***/
+
+int main(void)
+{
+    testFunc const tests[] =
+    {
+        test_piece_file_range,
+        test_file_priorities_and_wanted,
+        test_shared_strings,
+        test_stat_snapshot,
+        test_bulk_stat
+    };
+
+    return runTests(tests, NUM_TESTS(tests));
+}
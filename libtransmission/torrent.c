@@ -43,6 +43,7 @@
 #include "ptrarray.h"
 #include "resume.h"
 #include "session.h"
+#include "strpool.h"
 #include "subprocess.h"
 #include "torrent.h"
 #include "torrent-magnet.h"
@@ -572,6 +573,7 @@ void tr_torrentSetLocalError(tr_torrent* tor, char const* fmt, ...)
     va_end(ap);
 
     tr_logAddTorErr(tor, "%s", tor->errorString);
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
 
     if (tor->isRunning)
     {
@@ -584,6 +586,7 @@ static void tr_torrentClearError(tr_torrent* tor)
     tor->error = TR_STAT_OK;
     tor->errorString[0] = '\0';
     tor->errorTracker[0] = '\0';
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
 }
 
 static void onTrackerResponse(tr_torrent* tor, tr_tracker_event const* event, void* unused UNUSED)
@@ -617,6 +620,7 @@ static void onTrackerResponse(tr_torrent* tor, tr_tracker_event const* event, vo
         tor->error = TR_STAT_TRACKER_WARNING;
         tr_strlcpy(tor->errorTracker, event->tracker, sizeof(tor->errorTracker));
         tr_strlcpy(tor->errorString, event->text, sizeof(tor->errorString));
+        tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
         break;
 
     case TR_TRACKER_ERROR:
@@ -624,6 +628,7 @@ static void onTrackerResponse(tr_torrent* tor, tr_tracker_event const* event, vo
         tor->error = TR_STAT_TRACKER_ERROR;
         tr_strlcpy(tor->errorTracker, event->tracker, sizeof(tor->errorTracker));
         tr_strlcpy(tor->errorString, event->text, sizeof(tor->errorString));
+        tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
         break;
 
     case TR_TRACKER_ERROR_CLEAR:
@@ -671,50 +676,20 @@ static void initFilePieces(tr_info* info, tr_file_index_t fileIndex)
     file->lastPiece = getBytePiece(info, lastByte);
 }
 
-static bool pieceHasFile(tr_piece_index_t piece, tr_file const* file)
+static tr_priority_t calculatePiecePriority(tr_torrent const* tor, tr_piece_index_t piece)
 {
-    return file->firstPiece <= piece && piece <= file->lastPiece;
-}
-
-static tr_priority_t calculatePiecePriority(tr_torrent const* tor, tr_piece_index_t piece, int fileHint)
-{
-    tr_file_index_t firstFileIndex;
+    tr_file_index_t first;
+    tr_file_index_t last;
     tr_priority_t priority = TR_PRI_LOW;
 
-    /* find the first file that has data in this piece */
-    if (fileHint >= 0)
-    {
-        firstFileIndex = fileHint;
-
-        while (firstFileIndex > 0 && pieceHasFile(piece, &tor->info.files[firstFileIndex - 1]))
-        {
-            --firstFileIndex;
-        }
-    }
-    else
-    {
-        firstFileIndex = 0;
-
-        for (tr_file_index_t i = 0; i < tor->info.fileCount; ++i, ++firstFileIndex)
-        {
-            if (pieceHasFile(piece, &tor->info.files[i]))
-            {
-                break;
-            }
-        }
-    }
+    tr_torGetPieceFileRange(tor, piece, &first, &last);
 
     /* the piece's priority is the max of the priorities
      * of all the files in that piece */
-    for (tr_file_index_t i = firstFileIndex; i < tor->info.fileCount; ++i)
+    for (tr_file_index_t i = first; i <= last; ++i)
     {
         tr_file const* file = &tor->info.files[i];
 
-        if (!pieceHasFile(piece, file))
-        {
-            break;
-        }
-
         priority = MAX(priority, file->priority);
 
         /* when dealing with multimedia files, getting the first and
@@ -745,8 +720,10 @@ static void tr_torrentInitFilePieces(tr_torrent* tor)
         initFilePieces(inf, f);
     }
 
-    /* build the array of first-file hints to give calculatePiecePriority */
-    int* firstFiles = tr_new(int, inf->pieceCount);
+    /* build the piece-to-file index. files are laid out in order,
+       so each piece's files are a contiguous run starting here */
+    tr_free(tor->pieceFirstFile);
+    tor->pieceFirstFile = tr_new(tr_file_index_t, inf->pieceCount + 1);
     tr_file_index_t f = 0;
 
     for (tr_piece_index_t p = 0; p < inf->pieceCount; ++p)
@@ -756,45 +733,15 @@ static void tr_torrentInitFilePieces(tr_torrent* tor)
             ++f;
         }
 
-        firstFiles[p] = f;
-    }
-
-#if 0
-
-    /* test to confirm the first-file hints are correct */
-    for (tr_piece_index_t p = 0; p < inf->pieceCount; ++p)
-    {
-        tr_file_index_t f = firstFiles[p];
-
-        TR_ASSERT(inf->files[f].firstPiece <= p);
-        TR_ASSERT(inf->files[f].lastPiece >= p);
-
-        if (f > 0)
-        {
-            TR_ASSERT(inf->files[f - 1].lastPiece < p);
-        }
-
-        f = 0;
-
-        for (tr_file_index_t i = 0; i < inf->fileCount; ++i, ++f)
-        {
-            if (pieceHasFile(p, &inf->files[i]))
-            {
-                break;
-            }
-        }
-
-        TR_ASSERT((int)f == firstFiles[p]);
+        tor->pieceFirstFile[p] = f;
     }
 
-#endif
+    tor->pieceFirstFile[inf->pieceCount] = inf->fileCount;
 
     for (tr_piece_index_t p = 0; p < inf->pieceCount; ++p)
     {
-        inf->pieces[p].priority = calculatePiecePriority(tor, p, firstFiles[p]);
+        inf->piecePriority[p] = calculatePiecePriority(tor, p);
     }
-
-    tr_free(firstFiles);
 }
 
 static void torrentStart(tr_torrent* tor, bool bypass_queue);
@@ -938,6 +885,7 @@ static void torrentInit(tr_torrent* tor, tr_ctor const* ctor)
     tor->uniqueId = nextUniqueId++;
     tor->magicNumber = TORRENT_MAGIC_NUMBER;
     tor->queuePosition = session->torrentCount;
+    tor->statDirty = TR_STAT_DIRTY_ALL;
     tr_torrentSetLabels(tor, tr_ctorGetLabels(ctor));
 
     tr_sha1(tor->obfuscatedHash, "req2", 4, tor->info.hash, SHA_DIGEST_LENGTH, NULL);
@@ -1264,6 +1212,7 @@ void tr_torrentSetVerifyState(tr_torrent* tor, tr_verify_state state)
 
     tor->verifyState = state;
     tor->anyDate = tr_time();
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_ALL);
 }
 
 tr_torrent_activity tr_torrentGetActivity(tr_torrent const* tor)
@@ -1332,7 +1281,7 @@ static double getVerifyProgress(tr_torrent const* tor)
 
         for (tr_piece_index_t i = 0; i < tor->info.pieceCount; ++i)
         {
-            if (tor->info.pieces[i].timeChecked != 0)
+            if (tor->info.pieceTimeChecked[i] != 0)
             {
                 ++checked;
             }
@@ -1344,84 +1293,156 @@ static double getVerifyProgress(tr_torrent const* tor)
     return d;
 }
 
-tr_stat const* tr_torrentStat(tr_torrent* tor)
+/* which parts of the snapshot in tor->stats are out of date.
+ * besides the events that mark the snapshot dirty, some fields change
+ * with the clock: those of running torrents, and the speeds and peer
+ * counts that are still draining away after a torrent stops */
+static int getStatDirtyFields(tr_torrent const* tor)
+{
+    tr_stat const* s = &tor->stats;
+    int fields = tor->statDirty;
+
+    if (tor->statGeneration != tor->session->statGeneration)
+    {
+        fields |= TR_STAT_DIRTY_STATE;
+    }
+
+    if (tor->isRunning)
+    {
+        fields |= TR_STAT_DIRTY_STATE | TR_STAT_DIRTY_PEERS | TR_STAT_DIRTY_TRANSFER;
+
+        if (!tr_torrentHasMetadata(tor))
+        {
+            fields |= TR_STAT_DIRTY_PROGRESS;
+        }
+    }
+
+    if (tor->verifyState != TR_VERIFY_NONE)
+    {
+        fields |= TR_STAT_DIRTY_STATE | TR_STAT_DIRTY_PROGRESS;
+    }
+
+    if (s->peersConnected != 0 || s->webseedsSendingToUs != 0)
+    {
+        fields |= TR_STAT_DIRTY_PEERS;
+    }
+
+    if (s->rawUploadSpeed_KBps > 0 || s->rawDownloadSpeed_KBps > 0 || s->pieceUploadSpeed_KBps > 0 ||
+        s->pieceDownloadSpeed_KBps > 0)
+    {
+        fields |= TR_STAT_DIRTY_TRANSFER;
+    }
+
+    return fields;
+}
+
+/* the caller must hold the session lock. Otherwise a field marked dirty by
+ * the libtransmission thread between reading and clearing tor->statDirty
+ * would be lost, and an idle torrent's snapshot would never catch up */
+static tr_stat const* torrentStat(tr_torrent* tor)
 {
     TR_ASSERT(tr_isTorrent(tor));
+    TR_ASSERT(tr_sessionIsLocked(tor->session));
 
     uint64_t const now = tr_time_msec();
 
-    tr_stat* s;
+    tr_stat* s = &tor->stats;
+    int const dirty = getStatDirtyFields(tor);
     uint64_t seedRatioBytesLeft;
     uint64_t seedRatioBytesGoal;
     bool seedRatioApplies;
     uint16_t seedIdleMinutes;
-    unsigned int pieceUploadSpeed_Bps;
-    unsigned int pieceDownloadSpeed_Bps;
-    struct tr_swarm_stats swarm_stats;
+    unsigned int pieceUploadSpeed_Bps = 0;
+    unsigned int pieceDownloadSpeed_Bps = 0;
 
     tor->lastStatTime = tr_time();
 
-    if (tor->swarm != NULL)
+    /* an idle torrent's snapshot is still good */
+    if (dirty == 0)
     {
-        tr_swarmGetStats(tor->swarm, &swarm_stats);
+        return s;
     }
-    else
+
+    tor->statDirty = 0;
+    tor->statGeneration = tor->session->statGeneration;
+
+    if ((dirty & TR_STAT_DIRTY_STATE) != 0)
+    {
+        s->id = tor->uniqueId;
+        s->activity = tr_torrentGetActivity(tor);
+        s->error = tor->error;
+        s->queuePosition = tor->queuePosition;
+        s->isStalled = tr_torrentIsStalled(tor);
+        tr_strlcpy(s->errorString, tor->errorString, sizeof(s->errorString));
+        s->manualAnnounceTime = tr_announcerNextManualAnnounce(tor);
+        s->activityDate = tor->activityDate;
+        s->addedDate = tor->addedDate;
+        s->doneDate = tor->doneDate;
+        s->startDate = tor->startDate;
+        s->secondsSeeding = tor->secondsSeeding;
+        s->secondsDownloading = tor->secondsDownloading;
+        s->idleSecs = torrentGetIdleSecs(tor);
+    }
+
+    if ((dirty & TR_STAT_DIRTY_PEERS) != 0)
+    {
+        struct tr_swarm_stats swarm_stats;
+
+        if (tor->swarm != NULL)
+        {
+            tr_swarmGetStats(tor->swarm, &swarm_stats);
+        }
+        else
+        {
+            swarm_stats = TR_SWARM_STATS_INIT;
+        }
+
+        s->peersConnected = swarm_stats.peerCount;
+        s->peersSendingToUs = swarm_stats.activePeerCount[TR_DOWN];
+        s->peersGettingFromUs = swarm_stats.activePeerCount[TR_UP];
+        s->webseedsSendingToUs = swarm_stats.activeWebseedCount;
+
+        for (int i = 0; i < TR_PEER_FROM__MAX; i++)
+        {
+            s->peersFrom[i] = swarm_stats.peerFromCount[i];
+        }
+
+        s->desiredAvailable = tr_peerMgrGetDesiredAvailable(tor);
+    }
+
+    if ((dirty & TR_STAT_DIRTY_TRANSFER) != 0)
+    {
+        s->rawUploadSpeed_KBps = toSpeedKBps(tr_bandwidthGetRawSpeed_Bps(&tor->bandwidth, now, TR_UP));
+        s->rawDownloadSpeed_KBps = toSpeedKBps(tr_bandwidthGetRawSpeed_Bps(&tor->bandwidth, now, TR_DOWN));
+        pieceUploadSpeed_Bps = tr_bandwidthGetPieceSpeed_Bps(&tor->bandwidth, now, TR_UP);
+        pieceDownloadSpeed_Bps = tr_bandwidthGetPieceSpeed_Bps(&tor->bandwidth, now, TR_DOWN);
+        s->pieceUploadSpeed_KBps = toSpeedKBps(pieceUploadSpeed_Bps);
+        s->pieceDownloadSpeed_KBps = toSpeedKBps(pieceDownloadSpeed_Bps);
+
+        s->corruptEver = tor->corruptCur + tor->corruptPrev;
+        s->downloadedEver = tor->downloadedCur + tor->downloadedPrev;
+        s->uploadedEver = tor->uploadedCur + tor->uploadedPrev;
+    }
+
+    if ((dirty & TR_STAT_DIRTY_PROGRESS) != 0)
     {
-        swarm_stats = TR_SWARM_STATS_INIT;
-    }
-
-    s = &tor->stats;
-    s->id = tor->uniqueId;
-    s->activity = tr_torrentGetActivity(tor);
-    s->error = tor->error;
-    s->queuePosition = tor->queuePosition;
-    s->isStalled = tr_torrentIsStalled(tor);
-    tr_strlcpy(s->errorString, tor->errorString, sizeof(s->errorString));
-
-    s->manualAnnounceTime = tr_announcerNextManualAnnounce(tor);
-    s->peersConnected = swarm_stats.peerCount;
-    s->peersSendingToUs = swarm_stats.activePeerCount[TR_DOWN];
-    s->peersGettingFromUs = swarm_stats.activePeerCount[TR_UP];
-    s->webseedsSendingToUs = swarm_stats.activeWebseedCount;
-
-    for (int i = 0; i < TR_PEER_FROM__MAX; i++)
-    {
-        s->peersFrom[i] = swarm_stats.peerFromCount[i];
-    }
-
-    s->rawUploadSpeed_KBps = toSpeedKBps(tr_bandwidthGetRawSpeed_Bps(&tor->bandwidth, now, TR_UP));
-    s->rawDownloadSpeed_KBps = toSpeedKBps(tr_bandwidthGetRawSpeed_Bps(&tor->bandwidth, now, TR_DOWN));
-    pieceUploadSpeed_Bps = tr_bandwidthGetPieceSpeed_Bps(&tor->bandwidth, now, TR_UP);
-    pieceDownloadSpeed_Bps = tr_bandwidthGetPieceSpeed_Bps(&tor->bandwidth, now, TR_DOWN);
-    s->pieceUploadSpeed_KBps = toSpeedKBps(pieceUploadSpeed_Bps);
-    s->pieceDownloadSpeed_KBps = toSpeedKBps(pieceDownloadSpeed_Bps);
-
-    s->percentComplete = tr_cpPercentComplete(&tor->completion);
-    s->metadataPercentComplete = tr_torrentGetMetadataPercent(tor);
-
-    s->percentDone = tr_cpPercentDone(&tor->completion);
-    s->leftUntilDone = tr_torrentGetLeftUntilDone(tor);
-    s->sizeWhenDone = tr_cpSizeWhenDone(&tor->completion);
-    s->recheckProgress = s->activity == TR_STATUS_CHECK ? getVerifyProgress(tor) : 0;
-    s->activityDate = tor->activityDate;
-    s->addedDate = tor->addedDate;
-    s->doneDate = tor->doneDate;
-    s->startDate = tor->startDate;
-    s->secondsSeeding = tor->secondsSeeding;
-    s->secondsDownloading = tor->secondsDownloading;
-    s->idleSecs = torrentGetIdleSecs(tor);
-
-    s->corruptEver = tor->corruptCur + tor->corruptPrev;
-    s->downloadedEver = tor->downloadedCur + tor->downloadedPrev;
-    s->uploadedEver = tor->uploadedCur + tor->uploadedPrev;
-    s->haveValid = tr_cpHaveValid(&tor->completion);
-    s->haveUnchecked = tr_torrentHaveTotal(tor) - s->haveValid;
-    s->desiredAvailable = tr_peerMgrGetDesiredAvailable(tor);
+        s->percentComplete = tr_cpPercentComplete(&tor->completion);
+        s->metadataPercentComplete = tr_torrentGetMetadataPercent(tor);
+        s->percentDone = tr_cpPercentDone(&tor->completion);
+        s->leftUntilDone = tr_torrentGetLeftUntilDone(tor);
+        s->sizeWhenDone = tr_cpSizeWhenDone(&tor->completion);
+        s->recheckProgress = s->activity == TR_STATUS_CHECK ? getVerifyProgress(tor) : 0;
+        s->haveValid = tr_cpHaveValid(&tor->completion);
+        s->haveUnchecked = tr_torrentHaveTotal(tor) - s->haveValid;
+    }
+
+    /* the rest is cheap and depends on all of the above */
 
     s->ratio = tr_getRatio(s->uploadedEver, s->downloadedEver != 0 ? s->downloadedEver : s->haveValid);
 
     seedRatioApplies = tr_torrentGetSeedRatioBytes(tor, &seedRatioBytesLeft, &seedRatioBytesGoal);
 
+    /* the speeds are always fresh here, since only running torrents download or seed */
     switch (s->activity)
     {
     /* etaXLSpeed exists because if we use the piece speed directly,
@@ -1520,55 +1541,120 @@ tr_stat const* tr_torrentStat(tr_torrent* tor)
     return s;
 }
 
-/***
-****
-***/
+tr_stat const* tr_torrentStat(tr_torrent* tor)
+{
+    TR_ASSERT(tr_isTorrent(tor));
+
+    tr_stat const* s;
+
+    tr_torrentLock(tor);
+    s = torrentStat(tor);
+    tr_torrentUnlock(tor);
+
+    return s;
+}
+
+static void copyBriefStat(tr_brief_stat* brief, tr_stat const* st)
+{
+    brief->id = st->id;
+    brief->activity = st->activity;
+    brief->error = st->error;
+    brief->recheckProgress = st->recheckProgress;
+    brief->percentDone = st->percentDone;
+    brief->pieceUploadSpeed_KBps = st->pieceUploadSpeed_KBps;
+    brief->pieceDownloadSpeed_KBps = st->pieceDownloadSpeed_KBps;
+    brief->ratio = st->ratio;
+    brief->eta = st->eta;
+    brief->peersConnected = st->peersConnected;
+    brief->peersSendingToUs = st->peersSendingToUs;
+    brief->peersGettingFromUs = st->peersGettingFromUs;
+    brief->webseedsSendingToUs = st->webseedsSendingToUs;
+    brief->sizeWhenDone = st->sizeWhenDone;
+    brief->addedDate = st->addedDate;
+    brief->finished = st->finished;
+    brief->queuePosition = st->queuePosition;
+}
+
+struct stat_request
+{
+    int id;
+    int index;
+};
 
-static uint64_t countFileBytesCompleted(tr_torrent const* tor, tr_file_index_t index)
+static int compareStatRequests(void const* va, void const* vb)
 {
-    uint64_t total = 0;
-    tr_file const* f = &tor->info.files[index];
+    struct stat_request const* a = va;
+    struct stat_request const* b = vb;
+
+    return a->id < b->id ? -1 : (a->id > b->id ? 1 : 0);
+}
+
+int tr_torrentsStat(tr_session* session, int const* ids, int n, tr_brief_stat* setme)
+{
+    TR_ASSERT(tr_isSession(session));
+    TR_ASSERT(n >= 0);
+    TR_ASSERT(n == 0 || setme != NULL);
+
+    int found = 0;
+    tr_torrent* tor = NULL;
+
+    tr_sessionLock(session);
 
-    if (f->length != 0)
+    if (ids == NULL)
+    {
+        while (found < n && (tor = tr_torrentNext(session, tor)) != NULL)
+        {
+            copyBriefStat(&setme[found++], torrentStat(tor));
+        }
+    }
+    else if (n > 0)
     {
-        tr_block_index_t first;
-        tr_block_index_t last;
-        tr_torGetFileBlockRange(tor, index, &first, &last);
+        struct stat_request* requests = tr_new(struct stat_request, n);
+        struct stat_request const* const end = requests + n;
 
-        if (first == last)
+        for (int i = 0; i < n; ++i)
         {
-            if (tr_torrentBlockIsComplete(tor, first))
-            {
-                total = f->length;
-            }
+            requests[i].id = ids[i];
+            requests[i].index = i;
+            setme[i].id = 0;
         }
-        else
+
+        qsort(requests, n, sizeof(struct stat_request), compareStatRequests);
+
+        while ((tor = tr_torrentNext(session, tor)) != NULL)
         {
-            /* the first block */
-            if (tr_torrentBlockIsComplete(tor, first))
-            {
-                total += tor->blockSize - f->offset % tor->blockSize;
-            }
+            struct stat_request const key = { tor->uniqueId, 0 };
+            struct stat_request const* r = bsearch(&key, requests, n, sizeof(struct stat_request), compareStatRequests);
 
-            /* the middle blocks */
-            if (first + 1 < last)
+            if (r != NULL)
             {
-                uint64_t u = tr_bitfieldCountRange(&tor->completion.blockBitfield, first + 1, last);
-                u *= tor->blockSize;
-                total += u;
-            }
+                tr_stat const* st = torrentStat(tor);
 
-            /* the last block */
-            if (tr_torrentBlockIsComplete(tor, last))
-            {
-                total += f->offset + f->length - (uint64_t)tor->blockSize * last;
+                /* the same id may be in the list more than once */
+                while (r > requests && r[-1].id == key.id)
+                {
+                    --r;
+                }
+
+                for (; r != end && r->id == key.id; ++r)
+                {
+                    copyBriefStat(&setme[r->index], st);
+                    ++found;
+                }
             }
         }
+
+        tr_free(requests);
     }
 
-    return total;
+    tr_sessionUnlock(session);
+    return found;
 }
 
+/***
+****
+***/
+
 tr_file_stat* tr_torrentFiles(tr_torrent const* tor, tr_file_index_t* fileCount)
 {
     TR_ASSERT(tr_isTorrent(tor));
@@ -1576,11 +1662,10 @@ tr_file_stat* tr_torrentFiles(tr_torrent const* tor, tr_file_index_t* fileCount)
     tr_file_index_t const n = tor->info.fileCount;
     tr_file_stat* files = tr_new0(tr_file_stat, n);
     tr_file_stat* walk = files;
-    bool const isSeed = tor->completeness == TR_SEED;
 
     for (tr_file_index_t i = 0; i < n; ++i, ++walk)
     {
-        uint64_t const b = isSeed ? tor->info.files[i].length : countFileBytesCompleted(tor, i);
+        uint64_t const b = tr_cpFileBytesCompleted(&tor->completion, i);
         walk->bytesCompleted = b;
         walk->progress = tor->info.files[i].length > 0 ? (float)b / tor->info.files[i].length : 1.0F;
     }
@@ -1702,6 +1787,7 @@ static void freeTorrent(tr_torrent* tor)
     tr_announcerRemoveTorrent(session->announcer, tor);
 
     tr_cpDestruct(&tor->completion);
+    tr_free(tor->pieceFirstFile);
 
     tr_free(tor->downloadDir);
     tr_free(tor->incompleteDir);
@@ -1735,6 +1821,7 @@ static void freeTorrent(tr_torrent* tor)
         {
             t->queuePosition--;
             t->anyDate = now;
+            tr_torrentSetStatDirty(t, TR_STAT_DIRTY_STATE);
         }
     }
 
@@ -1773,6 +1860,7 @@ static void torrentStartImpl(void* vtor)
     tor->completeness = tr_cpGetStatus(&tor->completion);
     tor->startDate = now;
     tor->anyDate = now;
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_ALL);
     tr_torrentClearError(tor);
     tor->finishedSeedingByIdle = false;
 
@@ -2033,6 +2121,7 @@ static void stopTorrent(void* vtor)
     }
 
     torrentSetQueued(tor, false);
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_ALL);
 
     tr_torrentUnlock(tor);
 
@@ -2367,37 +2456,75 @@ void tr_torrentSetMetadataCallback(tr_torrent* tor, tr_torrent_metadata_func fun
 ***  File priorities
 **/
 
-void tr_torrentInitFilePriority(tr_torrent* tor, tr_file_index_t fileIndex, tr_priority_t priority)
+/* recalculate the pieces that hold these files. neighbouring files share
+   their boundary pieces, so when the list is sorted each piece is visited once */
+static void updateFilePieces(tr_torrent* tor, tr_file_index_t const* files, tr_file_index_t fileCount,
+    void (* updatePiece)(tr_torrent*, tr_piece_index_t))
 {
-    TR_ASSERT(tr_isTorrent(tor));
-    TR_ASSERT(fileIndex < tor->info.fileCount);
-    TR_ASSERT(tr_isPriority(priority));
+    bool any = false;
+    tr_piece_index_t doneFirst = 0;
+    tr_piece_index_t doneLast = 0;
 
-    tr_file* file = &tor->info.files[fileIndex];
+    for (tr_file_index_t i = 0; i < fileCount; ++i)
+    {
+        if (files[i] >= tor->info.fileCount)
+        {
+            continue;
+        }
 
-    file->priority = priority;
+        tr_file const* file = &tor->info.files[files[i]];
+        tr_piece_index_t p = file->firstPiece;
 
-    for (tr_piece_index_t i = file->firstPiece; i <= file->lastPiece; ++i)
-    {
-        tor->info.pieces[i].priority = calculatePiecePriority(tor, i, fileIndex);
+        if (any && doneFirst <= p && p <= doneLast)
+        {
+            p = doneLast + 1;
+            doneLast = MAX(doneLast, file->lastPiece);
+        }
+        else
+        {
+            doneFirst = file->firstPiece;
+            doneLast = file->lastPiece;
+            any = true;
+        }
+
+        for (; p <= file->lastPiece; ++p)
+        {
+            updatePiece(tor, p);
+        }
     }
 }
 
-void tr_torrentSetFilePriorities(tr_torrent* tor, tr_file_index_t const* files, tr_file_index_t fileCount,
+static void updatePiecePriority(tr_torrent* tor, tr_piece_index_t piece)
+{
+    tor->info.piecePriority[piece] = calculatePiecePriority(tor, piece);
+}
+
+void tr_torrentInitFilePriorities(tr_torrent* tor, tr_file_index_t const* files, tr_file_index_t fileCount,
     tr_priority_t priority)
 {
     TR_ASSERT(tr_isTorrent(tor));
-
-    tr_torrentLock(tor);
+    TR_ASSERT(tr_isPriority(priority));
 
     for (tr_file_index_t i = 0; i < fileCount; ++i)
     {
         if (files[i] < tor->info.fileCount)
         {
-            tr_torrentInitFilePriority(tor, files[i], priority);
+            tor->info.files[files[i]].priority = priority;
         }
     }
 
+    updateFilePieces(tor, files, fileCount, updatePiecePriority);
+}
+
+void tr_torrentSetFilePriorities(tr_torrent* tor, tr_file_index_t const* files, tr_file_index_t fileCount,
+    tr_priority_t priority)
+{
+    TR_ASSERT(tr_isTorrent(tor));
+
+    tr_torrentLock(tor);
+
+    tr_torrentInitFilePriorities(tor, files, fileCount, priority);
+
     tr_torrentSetDirty(tor);
     tr_peerMgrRebuildRequests(tor);
 
@@ -2422,69 +2549,21 @@ tr_priority_t* tr_torrentGetFilePriorities(tr_torrent const* tor)
 ***  File DND
 **/
 
-static void setFileDND(tr_torrent* tor, tr_file_index_t fileIndex, bool doDownload)
+/* a piece is DND only if every file using that piece is DND */
+static void updatePieceDND(tr_torrent* tor, tr_piece_index_t piece)
 {
-    bool const dnd = !doDownload;
-    tr_piece_index_t firstPiece;
-    bool firstPieceDND;
-    tr_piece_index_t lastPiece;
-    bool lastPieceDND;
-    tr_file* file = &tor->info.files[fileIndex];
-
-    file->dnd = dnd;
-    firstPiece = file->firstPiece;
-    lastPiece = file->lastPiece;
-
-    /* can't set the first piece to DND unless
-       every file using that piece is DND */
-    firstPieceDND = dnd;
-
-    if (fileIndex > 0)
-    {
-        for (tr_file_index_t i = fileIndex - 1; firstPieceDND; --i)
-        {
-            if (tor->info.files[i].lastPiece != firstPiece)
-            {
-                break;
-            }
-
-            firstPieceDND = tor->info.files[i].dnd;
-
-            if (i == 0)
-            {
-                break;
-            }
-        }
-    }
-
-    /* can't set the last piece to DND unless
-       every file using that piece is DND */
-    lastPieceDND = dnd;
-
-    for (tr_file_index_t i = fileIndex + 1; lastPieceDND && i < tor->info.fileCount; ++i)
-    {
-        if (tor->info.files[i].firstPiece != lastPiece)
-        {
-            break;
-        }
+    tr_file_index_t first;
+    tr_file_index_t last;
+    bool dnd = true;
 
-        lastPieceDND = tor->info.files[i].dnd;
-    }
+    tr_torGetPieceFileRange(tor, piece, &first, &last);
 
-    if (firstPiece == lastPiece)
+    for (tr_file_index_t i = first; dnd && i <= last; ++i)
     {
-        tor->info.pieces[firstPiece].dnd = firstPieceDND && lastPieceDND;
+        dnd = tor->info.files[i].dnd;
     }
-    else
-    {
-        tor->info.pieces[firstPiece].dnd = firstPieceDND;
-        tor->info.pieces[lastPiece].dnd = lastPieceDND;
 
-        for (tr_piece_index_t pp = firstPiece + 1; pp < lastPiece; ++pp)
-        {
-            tor->info.pieces[pp].dnd = dnd;
-        }
-    }
+    tr_cpSetPieceDND(&tor->completion, piece, dnd);
 }
 
 void tr_torrentInitFileDLs(tr_torrent* tor, tr_file_index_t const* files, tr_file_index_t fileCount, bool doDownload)
@@ -2497,11 +2576,11 @@ void tr_torrentInitFileDLs(tr_torrent* tor, tr_file_index_t const* files, tr_fil
     {
         if (files[i] < tor->info.fileCount)
         {
-            setFileDND(tor, files[i], doDownload);
+            tor->info.files[files[i]].dnd = !doDownload;
         }
     }
 
-    tr_cpInvalidateDND(&tor->completion);
+    updateFilePieces(tor, files, fileCount, updatePieceDND);
 
     tr_torrentUnlock(tor);
 }
@@ -2694,6 +2773,23 @@ void tr_torGetPieceBlockRange(tr_torrent const* tor, tr_piece_index_t const piec
     *last = offset / tor->blockSize;
 }
 
+void tr_torGetPieceFileRange(tr_torrent const* tor, tr_piece_index_t const piece, tr_file_index_t* first,
+    tr_file_index_t* last)
+{
+    TR_ASSERT(piece < tor->info.pieceCount);
+
+    *first = tor->pieceFirstFile[piece];
+    *last = tor->pieceFirstFile[piece + 1];
+
+    /* the next piece's first file is in this piece too if it began here */
+    if (*last == tor->info.fileCount || tor->info.files[*last].firstPiece > piece)
+    {
+        --*last;
+    }
+
+    TR_ASSERT(*first <= *last);
+}
+
 /***
 ****
 ***/
@@ -2703,7 +2799,7 @@ void tr_torrentSetPieceChecked(tr_torrent* tor, tr_piece_index_t pieceIndex)
     TR_ASSERT(tr_isTorrent(tor));
     TR_ASSERT(pieceIndex < tor->info.pieceCount);
 
-    tor->info.pieces[pieceIndex].timeChecked = tr_time();
+    tor->info.pieceTimeChecked[pieceIndex] = tr_time();
 }
 
 void tr_torrentSetChecked(tr_torrent* tor, time_t when)
@@ -2712,7 +2808,7 @@ void tr_torrentSetChecked(tr_torrent* tor, time_t when)
 
     for (tr_piece_index_t i = 0; i < tor->info.pieceCount; ++i)
     {
-        tor->info.pieces[i].timeChecked = when;
+        tor->info.pieceTimeChecked[i] = when;
     }
 }
 
@@ -2743,12 +2839,12 @@ time_t tr_torrentGetFileMTime(tr_torrent const* tor, tr_file_index_t i)
 
 bool tr_torrentPieceNeedsCheck(tr_torrent const* tor, tr_piece_index_t p)
 {
-    uint64_t unused;
-    tr_file_index_t f;
+    tr_file_index_t first;
+    tr_file_index_t last;
     tr_info const* inf = tr_torrentInfo(tor);
 
     /* if we've never checked this piece, then it needs to be checked */
-    if (inf->pieces[p].timeChecked == 0)
+    if (inf->pieceTimeChecked[p] == 0)
     {
         return true;
     }
@@ -2756,13 +2852,13 @@ bool tr_torrentPieceNeedsCheck(tr_torrent const* tor, tr_piece_index_t p)
     /* If we think we've completed one of the files in this piece,
      * but it's been modified since we last checked it,
      * then it needs to be rechecked */
-    tr_ioFindFileLocation(tor, p, 0, &f, &unused);
+    tr_torGetPieceFileRange(tor, p, &first, &last);
 
-    for (tr_file_index_t i = f; i < inf->fileCount && pieceHasFile(p, &inf->files[i]); ++i)
+    for (tr_file_index_t i = first; i <= last; ++i)
     {
         if (tr_cpFileIsComplete(&tor->completion, i))
         {
-            if (tr_torrentGetFileMTime(tor, i) > inf->pieces[p].timeChecked)
+            if (tr_torrentGetFileMTime(tor, i) > inf->pieceTimeChecked[p])
             {
                 return true;
             }
@@ -2911,6 +3007,7 @@ void tr_torrentSetAddedDate(tr_torrent* tor, time_t t)
 
     tor->addedDate = t;
     tor->anyDate = MAX(tor->anyDate, tor->addedDate);
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
 }
 
 void tr_torrentSetActivityDate(tr_torrent* tor, time_t t)
@@ -2919,6 +3016,7 @@ void tr_torrentSetActivityDate(tr_torrent* tor, time_t t)
 
     tor->activityDate = t;
     tor->anyDate = MAX(tor->anyDate, tor->activityDate);
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
 }
 
 void tr_torrentSetDoneDate(tr_torrent* tor, time_t t)
@@ -2927,6 +3025,7 @@ void tr_torrentSetDoneDate(tr_torrent* tor, time_t t)
 
     tor->doneDate = t;
     tor->anyDate = MAX(tor->anyDate, tor->doneDate);
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
 }
 
 /**
@@ -3374,7 +3473,7 @@ static void tr_torrentFileCompleted(tr_torrent* tor, tr_file_index_t fileIndex)
      * mtime timestamp for changes to know if we need to reverify pieces */
     for (tr_piece_index_t i = f->firstPiece; i <= f->lastPiece; ++i)
     {
-        inf->pieces[i].timeChecked = now;
+        inf->pieceTimeChecked[i] = now;
     }
 
     /* if the torrent's current filename isn't the same as the one in the
@@ -3686,6 +3785,7 @@ void tr_torrentSetQueuePosition(tr_torrent* tor, int pos)
             {
                 walk->queuePosition--;
                 walk->anyDate = now;
+                tr_torrentSetStatDirty(walk, TR_STAT_DIRTY_STATE);
             }
         }
 
@@ -3695,6 +3795,7 @@ void tr_torrentSetQueuePosition(tr_torrent* tor, int pos)
             {
                 walk->queuePosition++;
                 walk->anyDate = now;
+                tr_torrentSetStatDirty(walk, TR_STAT_DIRTY_STATE);
             }
         }
 
@@ -3706,6 +3807,7 @@ void tr_torrentSetQueuePosition(tr_torrent* tor, int pos)
 
     tor->queuePosition = MIN(pos, back + 1);
     tor->anyDate = now;
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_STATE);
 
     TR_ASSERT(queueIsSequenced(tor->session));
 }
@@ -3928,16 +4030,14 @@ static void renameTorrentFileString(tr_torrent* tor, char const* oldpath, char c
         tr_free(tmp);
     }
 
-    if (strcmp(file->name, name) == 0)
-    {
-        tr_free(name);
-    }
-    else
+    if (strcmp(file->name, name) != 0)
     {
-        tr_free(file->name);
-        file->name = name;
+        tr_strpoolRelease(file->name);
+        file->name = tr_strpoolAcquire(name, TR_BAD_SIZE);
         file->is_renamed = true;
     }
+
+    tr_free(name);
 }
 
 struct rename_data
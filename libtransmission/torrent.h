@@ -74,7 +74,11 @@ void tr_torGetFileBlockRange(tr_torrent const* tor, tr_file_index_t const file,
 void tr_torGetPieceBlockRange(tr_torrent const* tor, tr_piece_index_t const piece, tr_block_index_t* first,
     tr_block_index_t* last);
 
-void tr_torrentInitFilePriority(tr_torrent* tor, tr_file_index_t fileIndex, tr_priority_t priority);
+void tr_torGetPieceFileRange(tr_torrent const* tor, tr_piece_index_t const piece, tr_file_index_t* first,
+    tr_file_index_t* last);
+
+void tr_torrentInitFilePriorities(tr_torrent* tor, tr_file_index_t const* files, tr_file_index_t fileCount,
+    tr_priority_t priority);
 
 void tr_torrentSetPieceChecked(tr_torrent* tor, tr_piece_index_t piece);
 
@@ -160,6 +164,10 @@ struct tr_torrent
     uint16_t blockCountInPiece;
     uint16_t blockCountInLastPiece;
 
+    /* the first file with data in each piece, plus info.fileCount at the end.
+       use tr_torGetPieceFileRange() instead of reading this directly */
+    tr_file_index_t* pieceFirstFile;
+
     struct tr_completion completion;
 
     tr_completeness completeness;
@@ -229,6 +237,10 @@ struct tr_torrent
     time_t lastStatTime;
     tr_stat stats;
 
+    /* TR_STAT_DIRTY_* flags for the parts of stats that are out of date */
+    int statDirty;
+    unsigned int statGeneration;
+
     tr_torrent* next;
 
     int uniqueId;
@@ -334,6 +346,23 @@ static inline bool tr_isTorrent(tr_torrent const* tor)
     return tor != NULL && tor->magicNumber == TORRENT_MAGIC_NUMBER && tr_isSession(tor->session);
 }
 
+/* the parts of tr_stat that tr_torrentStat() recomputes separately.
+ * the ratio, ETA, and seed limit fields are recomputed along with any of them */
+enum
+{
+    TR_STAT_DIRTY_STATE = (1 << 0), /* activity, errors, dates, queue position */
+    TR_STAT_DIRTY_PROGRESS = (1 << 1), /* completion, verify, and metadata progress */
+    TR_STAT_DIRTY_PEERS = (1 << 2), /* peer counts and availability */
+    TR_STAT_DIRTY_TRANSFER = (1 << 3), /* speeds and byte counts */
+    TR_STAT_DIRTY_ALL = TR_STAT_DIRTY_STATE | TR_STAT_DIRTY_PROGRESS | TR_STAT_DIRTY_PEERS | TR_STAT_DIRTY_TRANSFER
+};
+
+/* mark parts of the torrent's tr_stat snapshot to be recomputed by the next tr_torrentStat() */
+static inline void tr_torrentSetStatDirty(tr_torrent* tor, int fields)
+{
+    tor->statDirty |= fields;
+}
+
 /* set a flag indicating that the torrent's .resume file
  * needs to be saved when the torrent is closed */
 static inline void tr_torrentSetDirty(tr_torrent* tor)
@@ -341,6 +370,7 @@ static inline void tr_torrentSetDirty(tr_torrent* tor)
     TR_ASSERT(tr_isTorrent(tor));
 
     tor->isDirty = true;
+    tr_torrentSetStatDirty(tor, TR_STAT_DIRTY_ALL);
 }
 
 uint32_t tr_getBlockSize(uint32_t pieceSize);
@@ -54,6 +54,9 @@ typedef int (* tr_voidptr_compare_func)(void const* lhs, void const* rhs);
 
 #define TR_RPC_SESSION_ID_HEADER "X-Transmission-Session-Id"
 
+/* RPC clients can send and accept this instead of JSON */
+#define TR_RPC_BENC_CONTENT_TYPE "application/x-bencode"
+
 typedef enum
 {
     TR_PREALLOCATE_NONE = 0,
@@ -1582,26 +1585,21 @@ void tr_torrentVerify(tr_torrent* torrent, tr_verify_done_func callback_func_or_
 /** @brief a part of tr_info that represents a single file of the torrent's content */
 typedef struct tr_file
 {
+    /* the fields read when mapping pieces and bytes to files come first,
+       so they share a cache line; the rarely-used ones follow */
     uint64_t length; /* Length of the file, in bytes */
-    char* name; /* Path to the file */
+    uint64_t offset; /* file begins at the torrent's nth byte */
+    tr_piece_index_t firstPiece; /* We need pieces [firstPiece... */
+    tr_piece_index_t lastPiece; /* ...lastPiece] to dl this file */
     int8_t priority; /* TR_PRI_HIGH, _NORMAL, or _LOW */
     bool dnd; /* "do not download" flag */
     bool is_renamed; /* true if we're using a different path from the one in the metainfo; ie, if the user has renamed it */
-    tr_piece_index_t firstPiece; /* We need pieces [firstPiece... */
-    tr_piece_index_t lastPiece; /* ...lastPiece] to dl this file */
-    uint64_t offset; /* file begins at the torrent's nth byte */
+    char const* name; /* Path to the file. Shared with other torrents that have the same path */
 }
 tr_file;
 
-/** @brief a part of tr_info that represents a single piece of the torrent's content */
-typedef struct tr_piece
-{
-    time_t timeChecked; /* the last time we tested this piece */
-    uint8_t hash[SHA_DIGEST_LENGTH]; /* pieces hash */
-    int8_t priority; /* TR_PRI_HIGH, _NORMAL, or _LOW */
-    bool dnd; /* "do not download" flag */
-}
-tr_piece;
+/** @brief a piece's SHA1 checksum, as listed in the metainfo */
+typedef uint8_t tr_piece_hash[SHA_DIGEST_LENGTH];
 
 /** @brief information about a torrent that comes from its metainfo file */
 struct tr_info
@@ -1624,7 +1622,13 @@ struct tr_info
     char* comment;
     char* creator;
     tr_file* files;
-    tr_piece* pieces;
+
+    /* Per-piece fields. Each is an array of pieceCount, rather than
+     * one array of structs, so that a pass over one field stays dense. */
+    tr_piece_hash const* pieceHashes; /* pieces' hashes. Shared with other torrents that have the same pieces */
+    time_t* pieceTimeChecked; /* the last time we tested each piece */
+    int8_t* piecePriority; /* TR_PRI_HIGH, _NORMAL, or _LOW */
+    bool* pieceDND; /* "do not download" flags */
 
     /* these trackers are sorted by tier */
     tr_tracker_info* trackers;
@@ -1873,6 +1877,80 @@ tr_stat const* tr_torrentStat(tr_torrent* torrent);
     reduce the CPU load if you're calling tr_torrentStat() frequently. */
 tr_stat const* tr_torrentStatCached(tr_torrent* torrent);
 
+/** @brief The subset of tr_stat that's needed to list, filter, and sort torrents.
+    @see tr_torrentsStat() */
+typedef struct tr_brief_stat
+{
+    /** The torrent's unique Id. @see tr_torrentId() */
+    int id;
+
+    /** What is this torrent doing right now? */
+    tr_torrent_activity activity;
+
+    /** Defines what kind of text is in errorString. @see tr_stat.errorString */
+    tr_stat_errtype error;
+
+    /** @see tr_stat.recheckProgress */
+    float recheckProgress;
+
+    /** @see tr_stat.percentDone */
+    float percentDone;
+
+    /** @see tr_stat.pieceUploadSpeed_KBps */
+    float pieceUploadSpeed_KBps;
+
+    /** @see tr_stat.pieceDownloadSpeed_KBps */
+    float pieceDownloadSpeed_KBps;
+
+    /** @see tr_stat.ratio */
+    float ratio;
+
+    /** @see tr_stat.eta */
+    int eta;
+
+    /** @see tr_stat.peersConnected */
+    int peersConnected;
+
+    /** @see tr_stat.peersSendingToUs */
+    int peersSendingToUs;
+
+    /** @see tr_stat.peersGettingFromUs */
+    int peersGettingFromUs;
+
+    /** @see tr_stat.webseedsSendingToUs */
+    int webseedsSendingToUs;
+
+    /** @see tr_stat.sizeWhenDone */
+    uint64_t sizeWhenDone;
+
+    /** When the torrent was first added. */
+    time_t addedDate;
+
+    /** A torrent is considered finished if it has met its seed ratio. @see tr_stat.finished */
+    bool finished;
+
+    /** This torrent's queue position. */
+    int queuePosition;
+}
+tr_brief_stat;
+
+/**
+ * @brief Get brief stats for a batch of torrents in one pass.
+ *
+ * The session lock is taken once for the whole batch, rather than once
+ * per torrent as with tr_torrentStat(), and only the brief fields are
+ * copied out. This is meant for refreshing a list of torrents; call
+ * tr_torrentStat() for the torrents whose full details are shown.
+ *
+ * @param ids the ids of the torrents to stat, or NULL for all of them
+ * @param n the number of ids, or the size of setme if ids is NULL
+ * @param setme an array of n records. If ids is given, setme[i] gets
+ *              ids[i]'s stats, or an id of 0 if there's no such torrent.
+ *              Otherwise the records are filled in the session's order.
+ * @return the number of records that were filled in
+ */
+int tr_torrentsStat(tr_session* session, int const* ids, int n, tr_brief_stat* setme);
+
 /** @deprecated */
 TR_DEPRECATED void tr_torrentSetAddedDate(tr_torrent* torrent, time_t addedDate);
 
@@ -18,7 +18,7 @@
 #define __LIBTRANSMISSION_VARIANT_MODULE__
 
 #include "transmission.h"
-#include "ptrarray.h"
+#include "tr-assert.h"
 #include "utils.h" /* tr_snprintf() */
 #include "variant.h"
 #include "variant-common.h"
@@ -142,34 +142,10 @@ err:
     return EILSEQ;
 }
 
-static tr_variant* get_node(tr_ptrArray* stack, tr_quark* key, tr_variant* top, int* err)
+/* a value can go at the top level, in a list, or in a dict after its key */
+static bool canAddValue(char const* stack, size_t stack_size, uint8_t const* key)
 {
-    tr_variant* node = NULL;
-
-    if (tr_ptrArrayEmpty(stack))
-    {
-        node = top;
-    }
-    else
-    {
-        tr_variant* parent = tr_ptrArrayBack(stack);
-
-        if (tr_variantIsList(parent))
-        {
-            node = tr_variantListAdd(parent);
-        }
-        else if (*key != 0 && tr_variantIsDict(parent))
-        {
-            node = tr_variantDictAdd(parent, *key);
-            *key = 0;
-        }
-        else
-        {
-            *err = EILSEQ;
-        }
-    }
-
-    return node;
+    return stack_size == 0 || stack[stack_size - 1] == 'l' || key != NULL;
 }
 
 /**
@@ -177,15 +153,18 @@ static tr_variant* get_node(tr_ptrArray* stack, tr_quark* key, tr_variant* top,
  * easier to read, but was vulnerable to a smash-stacking
  * attack via maliciously-crafted bencoded data. (#667)
  */
-int tr_variantParseBenc(void const* buf_in, void const* bufend_in, tr_variant* top, char const** setme_end)
+int tr_variantWalkBenc(void const* buf_in, size_t buflen, tr_variant_benc_funcs const* funcs, void* user_data,
+    char const** setme_end)
 {
     int err = 0;
     uint8_t const* buf = buf_in;
-    uint8_t const* bufend = bufend_in;
-    tr_ptrArray stack = TR_PTR_ARRAY_INIT;
-    tr_quark key = 0;
-
-    tr_variantInit(top, 0);
+    uint8_t const* bufend = buf + buflen;
+    char* stack = NULL; /* 'l' or 'd' for each open container */
+    size_t stack_size = 0;
+    size_t stack_alloc = 0;
+    uint8_t const* key = NULL;
+    size_t key_len = 0;
+    bool have_top = false;
 
     while (buf != bufend)
     {
@@ -203,7 +182,6 @@ int tr_variantParseBenc(void const* buf_in, void const* bufend_in, tr_variant* t
         {
             int64_t val;
             uint8_t const* end;
-            tr_variant* v;
 
             if ((err = tr_bencParseInt(buf, bufend, &end, &val)) != 0)
             {
@@ -212,57 +190,77 @@ int tr_variantParseBenc(void const* buf_in, void const* bufend_in, tr_variant* t
 
             buf = end;
 
-            if ((v = get_node(&stack, &key, top, &err)) != NULL)
+            if (!canAddValue(stack, stack_size, key))
             {
-                tr_variantInitInt(v, val);
+                err = EILSEQ;
+                break;
             }
+
+            if (funcs->intFunc != NULL)
+            {
+                err = funcs->intFunc((char const*)key, key_len, val, user_data);
+            }
+
+            key = NULL;
+            key_len = 0;
+            have_top = true;
         }
-        else if (*buf == 'l') /* list */
+        else if (*buf == 'l' || *buf == 'd') /* list or dict */
         {
-            tr_variant* v;
+            char const type = (char)*buf;
 
             ++buf;
 
-            if ((v = get_node(&stack, &key, top, &err)) != NULL)
+            if (!canAddValue(stack, stack_size, key))
             {
-                tr_variantInitList(v, 0);
-                tr_ptrArrayAppend(&stack, v);
+                err = EILSEQ;
+                break;
             }
-        }
-        else if (*buf == 'd') /* dict */
-        {
-            tr_variant* v;
 
-            ++buf;
+            if (type == 'l' && funcs->listBeginFunc != NULL)
+            {
+                err = funcs->listBeginFunc((char const*)key, key_len, user_data);
+            }
+            else if (type == 'd' && funcs->dictBeginFunc != NULL)
+            {
+                err = funcs->dictBeginFunc((char const*)key, key_len, user_data);
+            }
 
-            if ((v = get_node(&stack, &key, top, &err)) != NULL)
+            if (stack_size == stack_alloc)
             {
-                tr_variantInitDict(v, 0);
-                tr_ptrArrayAppend(&stack, v);
+                stack_alloc = stack_alloc != 0 ? stack_alloc * 2 : 32;
+                stack = tr_renew(char, stack, stack_alloc);
             }
+
+            stack[stack_size++] = type;
+            key = NULL;
+            key_len = 0;
+            have_top = true;
         }
         else if (*buf == 'e') /* end of list or dict */
         {
             ++buf;
 
-            if (tr_ptrArrayEmpty(&stack) || key != 0)
+            if (stack_size == 0 || key != NULL)
             {
                 err = EILSEQ;
                 break;
             }
-            else
+
+            --stack_size;
+
+            if (funcs->containerEndFunc != NULL)
             {
-                tr_ptrArrayPop(&stack);
+                err = funcs->containerEndFunc(user_data);
+            }
 
-                if (tr_ptrArrayEmpty(&stack))
-                {
-                    break;
-                }
+            if (stack_size == 0)
+            {
+                break;
             }
         }
         else if (isdigit(*buf)) /* string? */
         {
-            tr_variant* v;
             uint8_t const* end;
             uint8_t const* str;
             size_t str_len;
@@ -274,13 +272,25 @@ int tr_variantParseBenc(void const* buf_in, void const* bufend_in, tr_variant* t
 
             buf = end;
 
-            if (key == 0 && !tr_ptrArrayEmpty(&stack) && tr_variantIsDict(tr_ptrArrayBack(&stack)))
+            if (key == NULL && stack_size != 0 && stack[stack_size - 1] == 'd')
             {
-                key = tr_quark_new(str, str_len);
+                key = str;
+                key_len = str_len;
             }
-            else if ((v = get_node(&stack, &key, top, &err)) != NULL)
+            else if (canAddValue(stack, stack_size, key))
             {
-                tr_variantInitStr(v, str, str_len);
+                if (funcs->stringFunc != NULL)
+                {
+                    err = funcs->stringFunc((char const*)key, key_len, (char const*)str, str_len, user_data);
+                }
+
+                key = NULL;
+                key_len = 0;
+                have_top = true;
+            }
+            else
+            {
+                err = EILSEQ;
             }
         }
         else /* invalid bencoded text... march past it */
@@ -288,41 +298,213 @@ int tr_variantParseBenc(void const* buf_in, void const* bufend_in, tr_variant* t
             ++buf;
         }
 
-        if (tr_ptrArrayEmpty(&stack))
+        if (stack_size == 0)
         {
             break;
         }
     }
 
-    if (err == 0 && (top->type == 0 || !tr_ptrArrayEmpty(&stack)))
+    if (err == 0 && (!have_top || stack_size != 0))
     {
         err = EILSEQ;
     }
 
-    if (err == 0)
+    if (err == 0 && setme_end != NULL)
+    {
+        *setme_end = (char const*)buf;
+    }
+
+    tr_free(stack);
+    return err;
+}
+
+/***
+****  Building a tr_variant from tr_variantWalkBenc()'s callbacks.
+****
+****  Children are gathered on a scratch stack while their container is
+****  open and are copied out in one exact-sized allocation when it closes,
+****  either from the heap or from an arena.
+***/
+
+struct benc_builder
+{
+    tr_variant* vals; /* the nodes whose containers are still open */
+    size_t vals_count;
+    size_t vals_alloc;
+
+    size_t* frames; /* for each open container, the index of its first child */
+    size_t frames_count;
+    size_t frames_alloc;
+
+    tr_variant_arena* arena; /* NULL to build on the heap */
+    bool inplace;
+};
+
+static tr_variant* builderAdd(struct benc_builder* b, char const* key, size_t key_len)
+{
+    if (b->vals_count == b->vals_alloc)
+    {
+        b->vals_alloc = b->vals_alloc != 0 ? b->vals_alloc * 2 : 64;
+        b->vals = tr_renew(tr_variant, b->vals, b->vals_alloc);
+    }
+
+    tr_variant* v = &b->vals[b->vals_count++];
+    v->key = key != NULL ? tr_quark_new(key, key_len) : 0;
+    return v;
+}
+
+static int builderInt(char const* key, size_t key_len, int64_t val, void* vb)
+{
+    tr_variantInitInt(builderAdd(vb, key, key_len), val);
+    return 0;
+}
+
+static int builderString(char const* key, size_t key_len, char const* str, size_t str_len, void* vb)
+{
+    struct benc_builder* b = vb;
+    tr_variant* v = builderAdd(b, key, key_len);
+
+    if (b->arena == NULL || str_len < sizeof(v->val.s.str.buf))
+    {
+        tr_variantInitStr(v, str, str_len);
+    }
+    else if (b->inplace)
+    {
+        tr_variantInitStrView(v, str, str_len);
+    }
+    else
     {
-        if (setme_end != NULL)
+        char* copy = tr_variantArenaAlloc(b->arena, str_len + 1);
+        memcpy(copy, str, str_len);
+        copy[str_len] = '\0';
+        tr_variantInitStrView(v, copy, str_len);
+    }
+
+    return 0;
+}
+
+static void builderContainerBegin(struct benc_builder* b, char const* key, size_t key_len, char type)
+{
+    tr_variantInit(builderAdd(b, key, key_len), type);
+
+    if (b->frames_count == b->frames_alloc)
+    {
+        b->frames_alloc = b->frames_alloc != 0 ? b->frames_alloc * 2 : 32;
+        b->frames = tr_renew(size_t, b->frames, b->frames_alloc);
+    }
+
+    b->frames[b->frames_count++] = b->vals_count;
+}
+
+static int builderDictBegin(char const* key, size_t key_len, void* vb)
+{
+    builderContainerBegin(vb, key, key_len, TR_VARIANT_TYPE_DICT);
+    return 0;
+}
+
+static int builderListBegin(char const* key, size_t key_len, void* vb)
+{
+    builderContainerBegin(vb, key, key_len, TR_VARIANT_TYPE_LIST);
+    return 0;
+}
+
+static int builderContainerEnd(void* vb)
+{
+    struct benc_builder* b = vb;
+    size_t const first = b->frames[--b->frames_count];
+    size_t const n = b->vals_count - first;
+    tr_variant* container = &b->vals[first - 1];
+
+    if (n != 0)
+    {
+        if (b->arena != NULL)
         {
-            *setme_end = (char const*)buf;
+            container->val.l.vals = tr_variantArenaAlloc(b->arena, sizeof(tr_variant) * n);
+            container->val.l.alloc = 0;
         }
+        else
+        {
+            container->val.l.vals = tr_new(tr_variant, n);
+            container->val.l.alloc = n;
+        }
+
+        memcpy(container->val.l.vals, &b->vals[first], sizeof(tr_variant) * n);
+        container->val.l.count = n;
+        b->vals_count = first;
+    }
+
+    return 0;
+}
+
+static tr_variant_benc_funcs const builder_funcs =
+{
+    builderInt,
+    builderString,
+    builderDictBegin,
+    builderListBegin,
+    builderContainerEnd
+};
+
+static int buildVariant(void const* buf, size_t buflen, tr_variant* top, tr_variant_arena* arena, bool inplace,
+    char const** setme_end)
+{
+    struct benc_builder b;
+    int err;
+
+    memset(&b, 0, sizeof(b));
+    b.arena = arena;
+    b.inplace = inplace;
+
+    tr_variantInit(top, 0);
+
+    err = tr_variantWalkBenc(buf, buflen, &builder_funcs, &b, setme_end);
+
+    if (err == 0)
+    {
+        TR_ASSERT(b.vals_count == 1);
+
+        *top = b.vals[0];
     }
-    else if (top->type != 0)
+    else
     {
-        tr_variantFree(top);
-        tr_variantInit(top, 0);
+        /* nodes still on the stack haven't been attached to a parent yet */
+        for (size_t i = 0; i < b.vals_count; ++i)
+        {
+            tr_variantFree(&b.vals[i]);
+        }
     }
 
-    tr_ptrArrayDestruct(&stack, NULL);
+    tr_free(b.frames);
+    tr_free(b.vals);
     return err;
 }
 
+int tr_variantParseBenc(void const* buf, void const* bufend, tr_variant* top, char const** setme_end)
+{
+    return buildVariant(buf, (char const*)bufend - (char const*)buf, top, NULL, false, setme_end);
+}
+
+int tr_variantFromBencArena(tr_variant* setme, tr_variant_arena* arena, void const* buf, size_t buflen, bool inplace,
+    char const** setme_end)
+{
+    TR_ASSERT(arena != NULL);
+
+    return buildVariant(buf, buflen, setme, arena, inplace, setme_end);
+}
+
 /****
 *****
 ****/
 
 static void saveIntFunc(tr_variant const* val, void* evbuf)
 {
-    evbuffer_add_printf(evbuf, "i%" PRId64 "e", val->val.i);
+    char buf[32];
+    size_t len;
+
+    buf[0] = 'i';
+    len = 1 + tr_variantFormatInt(val->val.i, buf + 1);
+    buf[len++] = 'e';
+    evbuffer_add(evbuf, buf, len);
 }
 
 static void saveBoolFunc(tr_variant const* val, void* evbuf)
@@ -339,11 +521,13 @@ static void saveBoolFunc(tr_variant const* val, void* evbuf)
 
 static void saveRealFunc(tr_variant const* val, void* evbuf)
 {
-    int len;
-    char buf[128];
+    char buf[TR_VARIANT_NUMBER_BUFLEN];
+    char prefix[32];
+    size_t const len = tr_variantFormatReal(val->val.d, 6, false, buf);
+    size_t prefix_len = tr_variantFormatInt(len, prefix);
 
-    len = tr_snprintf(buf, sizeof(buf), "%f", val->val.d);
-    evbuffer_add_printf(evbuf, "%d:", len);
+    prefix[prefix_len++] = ':';
+    evbuffer_add(evbuf, prefix, prefix_len);
     evbuffer_add(evbuf, buf, len);
 }
 
@@ -357,7 +541,11 @@ static void saveStringFunc(tr_variant const* v, void* evbuf)
         str = NULL;
     }
 
-    evbuffer_add_printf(evbuf, "%zu:", len);
+    char prefix[32];
+    size_t prefix_len = tr_variantFormatInt(len, prefix);
+
+    prefix[prefix_len++] = ':';
+    evbuffer_add(evbuf, prefix, prefix_len);
     evbuffer_add(evbuf, str, len);
 }
 
@@ -33,6 +33,19 @@ void tr_variantToBufBenc(tr_variant const* top, struct evbuffer* buf);
 
 void tr_variantInit(tr_variant* v, char type);
 
+/* big enough for anything tr_variantFormatReal() writes, even DBL_MAX */
+#define TR_VARIANT_NUMBER_BUFLEN 512
+
+/* writes `val' into `buf', which must hold at least 21 chars, in decimal; returns the length */
+size_t tr_variantFormatInt(int64_t val, char* buf);
+
+/* like "%.<precision>f", but always with a '.' decimal point. If `truncate'
+   is true, extra digits are dropped as in tr_truncd() instead of rounded */
+size_t tr_variantFormatReal(double val, int precision, bool truncate, char* buf);
+
+/* like strtod(), but always expects a '.' decimal point and won't read past `len' */
+bool tr_variantParseReal(char const* str, size_t len, double* setme, char const** setme_end);
+
 /* source - such as a filename. Only when logging an error */
 int tr_jsonParse(char const* source, void const* vbuf, size_t len, tr_variant* setme_benc, char const** setme_end);
 
@@ -44,3 +57,5 @@ int tr_bencParseStr(uint8_t const* buf, uint8_t const* bufend, uint8_t const** s
     size_t* setme_strlen);
 
 int tr_variantParseBenc(void const* buf, void const* end, tr_variant* top, char const** setme_end);
+
+void* tr_variantArenaAlloc(tr_variant_arena* arena, size_t size);
@@ -23,7 +23,6 @@
 
 #include "transmission.h"
 #include "ConvertUTF.h"
-#include "list.h"
 #include "log.h"
 #include "ptrarray.h"
 #include "tr-assert.h"
@@ -325,8 +324,10 @@ static void action_callback_POP(jsonsl_t jsn, jsonsl_action_t action UNUSED, str
         if ((state->special_flags & JSONSL_SPECIALf_NUMNOINT) != 0)
         {
             char const* begin = jsn->base + state->pos_begin;
+            double d = 0;
             data->has_content = true;
-            tr_variantInitReal(get_node(jsn), strtod(begin, NULL));
+            (void)tr_variantParseReal(begin, state->pos_cur - state->pos_begin, &d, NULL);
+            tr_variantInitReal(get_node(jsn), d);
         }
         else if ((state->special_flags & JSONSL_SPECIALf_NUMERIC) != 0)
         {
@@ -408,7 +409,9 @@ struct ParentState
 struct jsonWalk
 {
     bool doIndent;
-    tr_list* parents;
+    struct ParentState* parents; /* innermost container last */
+    size_t parentCount;
+    size_t parentAlloc;
     struct evbuffer* out;
 };
 
@@ -424,15 +427,15 @@ static void jsonIndent(struct jsonWalk* data)
 
     if (data->doIndent)
     {
-        evbuffer_add(data->out, buf, tr_list_size(data->parents) * 4 + 1);
+        evbuffer_add(data->out, buf, MIN(data->parentCount * 4 + 1, sizeof(buf)));
     }
 }
 
 static void jsonChildFunc(struct jsonWalk* data)
 {
-    if (data->parents != NULL && data->parents->data != NULL)
+    if (data->parentCount != 0)
     {
-        struct ParentState* pstate = data->parents->data;
+        struct ParentState* pstate = &data->parents[data->parentCount - 1];
 
         switch (pstate->variantType)
         {
@@ -481,7 +484,13 @@ static void jsonChildFunc(struct jsonWalk* data)
 
 static void jsonPushParent(struct jsonWalk* data, tr_variant const* v)
 {
-    struct ParentState* pstate = tr_new(struct ParentState, 1);
+    if (data->parentCount == data->parentAlloc)
+    {
+        data->parentAlloc = data->parentAlloc != 0 ? data->parentAlloc * 2 : 16;
+        data->parents = tr_renew(struct ParentState, data->parents, data->parentAlloc);
+    }
+
+    struct ParentState* pstate = &data->parents[data->parentCount++];
 
     pstate->variantType = v->type;
     pstate->childIndex = 0;
@@ -491,19 +500,19 @@ static void jsonPushParent(struct jsonWalk* data, tr_variant const* v)
     {
         pstate->childCount *= 2;
     }
-
-    tr_list_prepend(&data->parents, pstate);
 }
 
 static void jsonPopParent(struct jsonWalk* data)
 {
-    tr_free(tr_list_pop_front(&data->parents));
+    --data->parentCount;
 }
 
 static void jsonIntFunc(tr_variant const* val, void* vdata)
 {
     struct jsonWalk* data = vdata;
-    evbuffer_add_printf(data->out, "%" PRId64, val->val.i);
+    char buf[32];
+
+    evbuffer_add(data->out, buf, tr_variantFormatInt(val->val.i, buf));
     jsonChildFunc(data);
 }
 
@@ -526,24 +535,67 @@ static void jsonBoolFunc(tr_variant const* val, void* vdata)
 static void jsonRealFunc(tr_variant const* val, void* vdata)
 {
     struct jsonWalk* data = vdata;
+    char buf[TR_VARIANT_NUMBER_BUFLEN];
+    size_t len;
 
     if (fabs(val->val.d - (int)val->val.d) < 0.00001)
     {
-        evbuffer_add_printf(data->out, "%d", (int)val->val.d);
+        len = tr_variantFormatInt((int)val->val.d, buf);
     }
     else
     {
-        evbuffer_add_printf(data->out, "%.4f", tr_truncd(val->val.d, 4));
+        len = tr_variantFormatReal(val->val.d, 4, true, buf);
     }
 
+    evbuffer_add(data->out, buf, len);
     jsonChildFunc(data);
 }
 
+/* true if any of the eight bytes in `w' can't be copied verbatim into a
+   JSON string: control chars, DEL, non-ASCII, '"', or '\\'. These are the
+   usual "has a zero byte" and "has a byte less than n" bit tricks. */
+static inline bool jsonWordNeedsEscape(uint64_t w)
+{
+    uint64_t const ones = UINT64_C(0x0101010101010101);
+    uint64_t const quotes = w ^ (ones * '"');
+    uint64_t const backslashes = w ^ (ones * '\\');
+    uint64_t const dels = w ^ (ones * 0x7f);
+    uint64_t const flags = ((w - ones * 0x20) & ~w) | ((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes) |
+        ((dels - ones) & ~dels) | w;
+
+    return (flags & (ones * 0x80)) != 0;
+}
+
+static inline bool jsonCharIsPlain(unsigned char ch)
+{
+    return 0x20 <= ch && ch < 0x7f && ch != '"' && ch != '\\';
+}
+
+static char* jsonWriteUnicodeEscape(char* out, uint32_t ch)
+{
+    static char const hex[] = "0123456789abcdef";
+    int digits = 4;
+
+    while (digits < 8 && (ch >> (digits * 4)) != 0)
+    {
+        ++digits;
+    }
+
+    *out++ = '\\';
+    *out++ = 'u';
+
+    for (int i = digits - 1; i >= 0; --i)
+    {
+        *out++ = hex[(ch >> (i * 4)) & 0xf];
+    }
+
+    return out;
+}
+
 static void jsonStringFunc(tr_variant const* val, void* vdata)
 {
     char* out;
     char* outwalk;
-    char* outend;
     struct evbuffer_iovec vec[1];
     struct jsonWalk* data = vdata;
     char const* str;
@@ -555,58 +607,86 @@ static void jsonStringFunc(tr_variant const* val, void* vdata)
     it = (unsigned char const*)str;
     end = it + len;
 
-    evbuffer_reserve_space(data->out, len * 4, vec, 1);
+    /* worst case is a control char, which takes six bytes to escape */
+    evbuffer_reserve_space(data->out, len * 6 + 2, vec, 1);
     out = vec[0].iov_base;
-    outend = out + vec[0].iov_len;
 
     outwalk = out;
     *outwalk++ = '"';
 
-    for (; it != end; ++it)
+    while (it != end)
     {
+        /* most strings are plain ASCII, so copy them a word at a time */
+        while (end - it >= 8)
+        {
+            uint64_t w;
+            memcpy(&w, it, sizeof(w));
+
+            if (jsonWordNeedsEscape(w))
+            {
+                break;
+            }
+
+            memcpy(outwalk, it, sizeof(w));
+            outwalk += sizeof(w);
+            it += sizeof(w);
+        }
+
+        while (it != end && jsonCharIsPlain(*it))
+        {
+            *outwalk++ = *it++;
+        }
+
+        if (it == end)
+        {
+            break;
+        }
+
         switch (*it)
         {
         case '\b':
             *outwalk++ = '\\';
             *outwalk++ = 'b';
+            ++it;
             break;
 
         case '\f':
             *outwalk++ = '\\';
             *outwalk++ = 'f';
+            ++it;
             break;
 
         case '\n':
             *outwalk++ = '\\';
             *outwalk++ = 'n';
+            ++it;
             break;
 
         case '\r':
             *outwalk++ = '\\';
             *outwalk++ = 'r';
+            ++it;
             break;
 
         case '\t':
             *outwalk++ = '\\';
             *outwalk++ = 't';
+            ++it;
             break;
 
         case '"':
             *outwalk++ = '\\';
             *outwalk++ = '"';
+            ++it;
             break;
 
         case '\\':
             *outwalk++ = '\\';
             *outwalk++ = '\\';
+            ++it;
             break;
 
         default:
-            if (isprint(*it))
-            {
-                *outwalk++ = *it;
-            }
-            else
             {
                 UTF8 const* tmp = it;
                 UTF32 buf[1] = { 0 };
@@ -615,12 +695,16 @@ static void jsonStringFunc(tr_variant const* val, void* vdata)
 
                 if ((result == conversionOK || result == targetExhausted) && tmp != it)
                 {
-                    outwalk += tr_snprintf(outwalk, outend - outwalk, "\\u%04x", (unsigned int)buf[0]);
-                    it = tmp - 1;
+                    outwalk = jsonWriteUnicodeEscape(outwalk, buf[0]);
+                    it = tmp;
+                }
+                else /* not valid UTF-8, so drop it */
+                {
+                    ++it;
                 }
-            }
 
-            break;
+                break;
+            }
         }
     }
 
@@ -700,6 +784,8 @@ void tr_variantToBufJson(tr_variant const* top, struct evbuffer* buf, bool lean)
     data.doIndent = !lean;
     data.out = buf;
     data.parents = NULL;
+    data.parentCount = 0;
+    data.parentAlloc = 0;
 
     tr_variantWalk(top, &walk_funcs, &data, true);
 
@@ -707,4 +793,6 @@ void tr_variantToBufJson(tr_variant const* top, struct evbuffer* buf, bool lean)
     {
         evbuffer_add_printf(buf, "\n");
     }
+
+    tr_free(data.parents);
 }
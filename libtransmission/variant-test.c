@@ -15,6 +15,7 @@
 #define __LIBTRANSMISSION_VARIANT_MODULE__
 
 #include "transmission.h"
+#include "crypto-utils.h" /* tr_rand_int_weak() */
 #include "utils.h" /* tr_free */
 #include "variant.h"
 #include "variant-common.h"
@@ -580,6 +581,287 @@ static int testParse2(void)
     return 0;
 }
 
+static int testDictIndex(void)
+{
+    tr_variant top;
+    tr_variant* child;
+    tr_quark key;
+    tr_quark keys[100];
+    int64_t i;
+    char* str;
+    size_t len;
+
+    for (int k = 0; k < 100; ++k)
+    {
+        char buf[32];
+        tr_snprintf(buf, sizeof(buf), "dict-index-key-%d", k);
+        keys[k] = tr_quark_new(buf, TR_BAD_SIZE);
+    }
+
+    /* large enough to be indexed */
+    tr_variantInitDict(&top, 0);
+
+    for (int k = 0; k < 100; ++k)
+    {
+        tr_variantDictAddInt(&top, keys[k], k);
+    }
+
+    for (int k = 0; k < 100; ++k)
+    {
+        check(tr_variantDictFindInt(&top, keys[k], &i));
+        check_int(i, ==, k);
+    }
+
+    check(!tr_variantDictFindInt(&top, TR_KEY_port, &i));
+
+    /* replacing a value keeps its position */
+    tr_variantDictAddInt(&top, keys[10], 1000);
+    check_uint(top.val.l.count, ==, 100);
+    check(tr_variantDictChild(&top, 10, &key, &child));
+    check(tr_variantGetInt(child, &i));
+    check_int(i, ==, 1000);
+
+    /* remove every third key, then make sure the rest are still found */
+    for (int k = 0; k < 100; k += 3)
+    {
+        check(tr_variantDictRemove(&top, keys[k]));
+        check(!tr_variantDictRemove(&top, keys[k]));
+    }
+
+    for (int k = 0; k < 100; ++k)
+    {
+        check_bool(tr_variantDictFindInt(&top, keys[k], &i), ==, k % 3 != 0);
+
+        if (k % 3 != 0)
+        {
+            check_int(i, ==, k == 10 ? 1000 : k);
+        }
+    }
+
+    /* duplicate keys resolve to the first one, as they did before indexing */
+    child = tr_variantDictAdd(&top, keys[1]);
+    tr_variantInitInt(child, -1);
+    check(tr_variantDictFindInt(&top, keys[1], &i));
+    check_int(i, ==, 1);
+    check(tr_variantDictRemove(&top, keys[1]));
+    check(tr_variantDictFindInt(&top, keys[1], &i));
+    check_int(i, ==, -1);
+
+    tr_variantFree(&top);
+
+    /* parsed dicts are indexed on first lookup and keep the order they were parsed in */
+    tr_variantInitDict(&top, 0);
+
+    for (int k = 99; k >= 0; --k)
+    {
+        tr_variantDictAddInt(&top, keys[k], k);
+    }
+
+    str = tr_variantToStr(&top, TR_VARIANT_FMT_JSON_LEAN, &len);
+    tr_variantFree(&top);
+    check_int(tr_variantFromJson(&top, str, len), ==, 0);
+    check(tr_variantDictFindInt(&top, keys[50], &i));
+    check_int(i, ==, 50);
+    check(tr_variantDictChild(&top, 0, &key, &child));
+    check(tr_variantGetInt(child, &i));
+    check_int(i, ==, 0); /* the serializer sorted the keys */
+
+    tr_free(str);
+    tr_variantFree(&top);
+    return 0;
+}
+
+static int testFormatReal(void)
+{
+    char buf[TR_VARIANT_NUMBER_BUFLEN];
+    char expected[TR_VARIANT_NUMBER_BUFLEN];
+
+    /* these run in the "C" locale, so printf() is the reference */
+    for (int i = 0; i < 1000; ++i)
+    {
+        double const d = (tr_rand_int_weak(2000000) - 1000000) / (double)(1 + tr_rand_int_weak(1000));
+
+        tr_variantFormatReal(d, 6, false, buf);
+        tr_snprintf(expected, sizeof(expected), "%f", d);
+        check_str(buf, ==, expected);
+
+        tr_variantFormatReal(d, 4, true, buf);
+        tr_snprintf(expected, sizeof(expected), "%.4f", tr_truncd(d, 4));
+        check_str(buf, ==, expected);
+    }
+
+    tr_variantFormatReal(1e300, 2, false, buf);
+    tr_snprintf(expected, sizeof(expected), "%.2f", 1e300);
+    check_str(buf, ==, expected);
+
+    /* on both sides of 2^53, where doubles stop having fractional parts */
+    {
+        double const big[] =
+        {
+            1e15 + 0.125,
+            4408007951628183.5,
+            -4408007951628183.5,
+            9007199254740991.0,
+            9007199254740992.0,
+            -9007199254740994.0
+        };
+
+        for (size_t i = 0; i < TR_N_ELEMENTS(big); ++i)
+        {
+            tr_variantFormatReal(big[i], 6, false, buf);
+            tr_snprintf(expected, sizeof(expected), "%f", big[i]);
+            check_str(buf, ==, expected);
+        }
+    }
+
+    tr_variantFormatInt(INT64_MAX, buf);
+    check_str(buf, ==, "9223372036854775807");
+    tr_variantFormatInt(0, buf);
+    check_str(buf, ==, "0");
+
+    return 0;
+}
+
+static int testParseArena(void)
+{
+    char const* benc = "d5:emptyle5:hellod3:fooi1ee4:longl31:this string won't fit in a nodeee";
+    size_t const benc_len = strlen(benc);
+    tr_quark const key_long = tr_quark_new("long", TR_BAD_SIZE);
+    tr_quark const key_hello = tr_quark_new("hello", TR_BAD_SIZE);
+    tr_quark const key_foo = tr_quark_new("foo", TR_BAD_SIZE);
+
+    for (int inplace = 0; inplace < 2; ++inplace)
+    {
+        tr_variant top;
+        tr_variant* child;
+        tr_variant_arena* arena = tr_variantArenaNew();
+        char const* end;
+        char const* str;
+        size_t len;
+        int64_t i;
+        char* saved;
+
+        check_int(tr_variantFromBencArena(&top, arena, benc, benc_len, inplace != 0, &end), ==, 0);
+        check_ptr(end, ==, benc + benc_len);
+
+        /* it round-trips */
+        saved = tr_variantToStr(&top, TR_VARIANT_FMT_BENC, &len);
+        check_uint(len, ==, benc_len);
+        check_mem(saved, ==, benc, len);
+        tr_free(saved);
+
+        /* long strings are copied or referenced in place */
+        check(tr_variantDictFindList(&top, key_long, &child));
+        check(tr_variantGetStr(tr_variantListChild(child, 0), &str, &len));
+        check_uint(len, ==, 31);
+        check_mem(str, ==, "this string won't fit in a node", len);
+        check_bool(str >= benc && str < benc + benc_len, ==, inplace != 0);
+
+        /* containers can still grow and be pruned after parsing */
+        check(tr_variantDictFindDict(&top, key_hello, &child));
+        tr_variantDictAddInt(child, TR_KEY_port, 80);
+        check(tr_variantDictRemove(child, key_foo));
+        check(!tr_variantDictFindInt(child, key_foo, &i));
+        check(tr_variantDictFindInt(child, TR_KEY_port, &i));
+        check_int(i, ==, 80);
+
+        tr_variantFree(&top);
+        tr_variantArenaFree(arena);
+    }
+
+    /* malformed input */
+    {
+        tr_variant top;
+        tr_variant_arena* arena = tr_variantArenaNew();
+        check_int(tr_variantFromBencArena(&top, arena, "d3:fooli1e", 10, false, NULL), ==, EILSEQ);
+        check_int(top.type, ==, 0);
+        tr_variantArenaFree(arena);
+    }
+
+    return 0;
+}
+
+struct walk_state
+{
+    int depth;
+    int64_t piece;
+    char const* name;
+    size_t name_len;
+    int containers;
+};
+
+static int walkInt(char const* key, size_t key_len, int64_t val, void* vstate)
+{
+    struct walk_state* state = vstate;
+
+    if (state->depth == 1 && key_len == 5 && memcmp(key, "piece", 5) == 0)
+    {
+        state->piece = val;
+    }
+
+    return 0;
+}
+
+static int walkString(char const* key, size_t key_len, char const* str, size_t str_len, void* vstate)
+{
+    struct walk_state* state = vstate;
+
+    if (state->depth == 1 && key_len == 4 && memcmp(key, "name", 4) == 0)
+    {
+        state->name = str;
+        state->name_len = str_len;
+        return ECANCELED; /* found everything we need */
+    }
+
+    return 0;
+}
+
+static int walkBegin(char const* key UNUSED, size_t key_len UNUSED, void* vstate)
+{
+    struct walk_state* state = vstate;
+    ++state->depth;
+    ++state->containers;
+    return 0;
+}
+
+static int walkEnd(void* vstate)
+{
+    struct walk_state* state = vstate;
+    --state->depth;
+    return 0;
+}
+
+static int testWalkBenc(void)
+{
+    char const* benc = "d4:infod5:piecei9ee5:piecei3e4:name4:spam5:otherlee";
+    tr_variant_benc_funcs const funcs =
+    {
+        walkInt,
+        walkString,
+        walkBegin,
+        walkBegin,
+        walkEnd
+    };
+    tr_variant_benc_funcs const no_funcs = { NULL, NULL, NULL, NULL, NULL };
+    struct walk_state state;
+    char const* end = NULL;
+
+    memset(&state, 0, sizeof(state));
+    check_int(tr_variantWalkBenc(benc, strlen(benc), &funcs, &state, &end), ==, ECANCELED);
+    check_int(state.piece, ==, 3);
+    check_uint(state.name_len, ==, 4);
+    check_mem(state.name, ==, "spam", 4);
+    check_int(state.containers, ==, 2);
+    check_ptr(end, ==, NULL);
+
+    /* a walk with no callbacks just validates the input */
+    check_int(tr_variantWalkBenc(benc, strlen(benc), &no_funcs, NULL, &end), ==, 0);
+    check_ptr(end, ==, benc + strlen(benc));
+    check_int(tr_variantWalkBenc(benc, strlen(benc) - 1, &no_funcs, NULL, NULL), ==, EILSEQ);
+
+    return 0;
+}
+
 int main(void)
 {
     static testFunc const tests[] =
@@ -591,6 +873,10 @@ int main(void)
         testMerge,
         testBool,
         testParse2,
+        testDictIndex,
+        testFormatReal,
+        testParseArena,
+        testWalkBenc,
         testStackSmash
     };
 
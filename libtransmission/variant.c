@@ -6,16 +6,9 @@
  *
  */
 
-#if defined(HAVE_USELOCALE) && (!defined(_XOPEN_SOURCE) || _XOPEN_SOURCE < 700)
-#undef _XOPEN_SOURCE
-#define _XOPEN_SOURCE 700
-#endif
-
-#if defined(HAVE_USELOCALE) && !defined(_GNU_SOURCE)
-#define _GNU_SOURCE
-#endif
-
 #include <errno.h>
+#include <locale.h> /* localeconv() */
+#include <math.h> /* fabs(), nearbyint() */
 #include <stdlib.h> /* strtod(), realloc(), qsort() */
 #include <string.h>
 
@@ -23,12 +16,6 @@
 #include <share.h>
 #endif
 
-#include <locale.h> /* setlocale() */
-
-#if defined(HAVE_USELOCALE) && defined(HAVE_XLOCALE_H)
-#include <xlocale.h>
-#endif
-
 #include <event2/buffer.h>
 
 #define __LIBTRANSMISSION_VARIANT_MODULE__
@@ -43,66 +30,263 @@
 #include "variant.h"
 #include "variant-common.h"
 
-/* don't use newlocale/uselocale on old versions of uClibc because they're buggy.
- * https://trac.transmissionbt.com/ticket/6006 */
-#if defined(__UCLIBC__) && !TR_UCLIBC_CHECK_VERSION(0, 9, 34)
-#undef HAVE_USELOCALE
-#endif
+/***
+****  Numbers are written and read with a '.' decimal point no matter
+****  what LC_NUMERIC says, as JSON requires, without switching locales.
+***/
 
-/**
-***
-**/
+static uint64_t const powers_of_ten[] =
+{
+    UINT64_C(1),
+    UINT64_C(10),
+    UINT64_C(100),
+    UINT64_C(1000),
+    UINT64_C(10000),
+    UINT64_C(100000),
+    UINT64_C(1000000),
+    UINT64_C(10000000),
+    UINT64_C(100000000),
+    UINT64_C(1000000000),
+    UINT64_C(10000000000),
+    UINT64_C(100000000000),
+    UINT64_C(1000000000000),
+    UINT64_C(10000000000000),
+    UINT64_C(100000000000000)
+};
 
-struct locale_context
+size_t tr_variantFormatInt(int64_t val, char* buf)
 {
-#ifdef HAVE_USELOCALE
-    locale_t new_locale;
-    locale_t old_locale;
-#else
-#if defined(HAVE__CONFIGTHREADLOCALE) && defined(_ENABLE_PER_THREAD_LOCALE)
-    int old_thread_config;
-#endif
-    int category;
-    char old_locale[128];
-#endif
-};
+    char tmp[20];
+    char* walk = tmp + sizeof(tmp);
+    uint64_t u = val < 0 ? -(uint64_t)val : (uint64_t)val;
+    size_t len = 0;
 
-static void use_numeric_locale(struct locale_context* context, char const* locale_name)
+    do
+    {
+        *--walk = '0' + u % 10;
+        u /= 10;
+    }
+    while (u != 0);
+
+    if (val < 0)
+    {
+        buf[len++] = '-';
+    }
+
+    memcpy(buf + len, walk, tmp + sizeof(tmp) - walk);
+    len += tmp + sizeof(tmp) - walk;
+    buf[len] = '\0';
+    return len;
+}
+
+/* frac * scale, rounded the way printf() does it: on the exact product,
+ * ties to even. fma() recovers what the multiplication rounded away */
+static uint64_t scaleAndRound(double frac, double scale)
 {
-#ifdef HAVE_USELOCALE
+    double const p = frac * scale;
+    double const r = nearbyint(p);
+    double const d = (p - r) + fma(frac, scale, -p);
 
-    context->new_locale = newlocale(LC_NUMERIC_MASK, locale_name, NULL);
-    context->old_locale = uselocale(context->new_locale);
+    return (uint64_t)r + (d > 0.5 ? 1 : 0) - (d < -0.5 ? 1 : 0);
+}
 
-#else
+size_t tr_variantFormatReal(double val, int precision, bool truncate, char* buf)
+{
+    TR_ASSERT(precision >= 0);
+    TR_ASSERT(precision < 14);
 
-#if defined(HAVE__CONFIGTHREADLOCALE) && defined(_ENABLE_PER_THREAD_LOCALE)
-    context->old_thread_config = _configthreadlocale(_ENABLE_PER_THREAD_LOCALE);
-#endif
+    double const a = fabs(val);
+    size_t len;
+
+    if (isnan(val) || isinf(val))
+    {
+        return tr_snprintf(buf, TR_VARIANT_NUMBER_BUFLEN, "%f", val);
+    }
 
-    context->category = LC_NUMERIC;
-    tr_strlcpy(context->old_locale, setlocale(context->category, NULL), sizeof(context->old_locale));
-    setlocale(context->category, locale_name);
+    if (a >= 9007199254740992.0) /* 2^53 */
+    {
+        /* every double this big is an integer, so nothing after the decimal
+           point is significant anymore. "%.0f" doesn't print one, so this
+           is still locale-independent */
+        len = tr_snprintf(buf, TR_VARIANT_NUMBER_BUFLEN - 16, "%.0f", val);
 
-#endif
+        if (precision > 0)
+        {
+            buf[len++] = '.';
+            memset(buf + len, '0', precision);
+            len += precision;
+        }
+
+        buf[len] = '\0';
+        return len;
+    }
+
+    uint64_t whole = (uint64_t)a;
+    double const frac = a - (double)whole;
+    uint64_t const scale = powers_of_ten[precision];
+    uint64_t digits;
+
+    if (truncate)
+    {
+        /* like tr_truncd(): round to 14 places before truncating, so that
+           0.1234 (which is really 0.12339999...) isn't cut down to 0.1233 */
+        digits = scaleAndRound(frac, 1e14) / powers_of_ten[14 - precision];
+    }
+    else
+    {
+        digits = scaleAndRound(frac, (double)scale);
+    }
+
+    if (digits >= scale)
+    {
+        ++whole;
+        digits -= scale;
+    }
+
+    len = 0;
+
+    if (signbit(val))
+    {
+        buf[len++] = '-';
+    }
+
+    len += tr_variantFormatInt((int64_t)whole, buf + len);
+
+    if (precision > 0)
+    {
+        buf[len++] = '.';
+
+        for (int i = precision - 1; i >= 0; --i)
+        {
+            buf[len + i] = '0' + digits % 10;
+            digits /= 10;
+        }
+
+        len += precision;
+    }
+
+    buf[len] = '\0';
+    return len;
+}
+
+static bool isDigit(char ch)
+{
+    return '0' <= ch && ch <= '9';
 }
 
-static void restore_locale(struct locale_context* context)
+bool tr_variantParseReal(char const* str, size_t len, double* setme, char const** setme_end)
 {
-#ifdef HAVE_USELOCALE
+    static double const exact_powers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    char const* walk = str;
+    char const* end = str + len;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int mantissa_digits = 0;
+    int exponent = 0;
+    bool have_digits = false;
+
+    if (walk != end && (*walk == '-' || *walk == '+'))
+    {
+        negative = *walk++ == '-';
+    }
+
+    for (; walk != end && isDigit(*walk); ++walk, have_digits = true)
+    {
+        if (mantissa_digits < 19)
+        {
+            mantissa = mantissa * 10 + (*walk - '0');
+            mantissa_digits += mantissa != 0 ? 1 : 0;
+        }
+        else
+        {
+            ++exponent;
+        }
+    }
+
+    if (walk != end && *walk == '.')
+    {
+        for (++walk; walk != end && isDigit(*walk); ++walk, have_digits = true)
+        {
+            if (mantissa_digits < 19)
+            {
+                mantissa = mantissa * 10 + (*walk - '0');
+                mantissa_digits += mantissa != 0 ? 1 : 0;
+                --exponent;
+            }
+        }
+    }
 
-    uselocale(context->old_locale);
-    freelocale(context->new_locale);
+    if (!have_digits)
+    {
+        return false;
+    }
 
-#else
+    if (walk != end && (*walk == 'e' || *walk == 'E'))
+    {
+        char const* e = walk + 1;
+        bool negative_exponent = false;
+        int n = 0;
 
-    setlocale(context->category, context->old_locale);
+        if (e != end && (*e == '-' || *e == '+'))
+        {
+            negative_exponent = *e++ == '-';
+        }
 
-#if defined(HAVE__CONFIGTHREADLOCALE) && defined(_ENABLE_PER_THREAD_LOCALE)
-    _configthreadlocale(context->old_thread_config);
-#endif
+        if (e != end && isDigit(*e))
+        {
+            for (; e != end && isDigit(*e); ++e)
+            {
+                n = n < 100000 ? n * 10 + (*e - '0') : n;
+            }
 
-#endif
+            exponent += negative_exponent ? -n : n;
+            walk = e;
+        }
+    }
+
+    if (mantissa <= (UINT64_C(1) << 53) && -22 <= exponent && exponent <= 22)
+    {
+        /* both operands are exact, so one multiply or divide rounds correctly */
+        double d = (double)mantissa;
+        d = exponent < 0 ? d / exact_powers[-exponent] : d * exact_powers[exponent];
+        *setme = negative ? -d : d;
+    }
+    else
+    {
+        /* rare: hand it to strtod() in the current locale's notation */
+        char buf[512];
+        char const* point = localeconv()->decimal_point;
+        size_t const point_len = strlen(point);
+        size_t n = 0;
+
+        for (char const* it = str; it != walk && n + point_len < sizeof(buf); ++it)
+        {
+            if (*it == '.')
+            {
+                memcpy(buf + n, point, point_len);
+                n += point_len;
+            }
+            else
+            {
+                buf[n++] = *it;
+            }
+        }
+
+        buf[n] = '\0';
+        *setme = strtod(buf, NULL);
+    }
+
+    if (setme_end != NULL)
+    {
+        *setme_end = walk;
+    }
+
+    return true;
 }
 
 /***
@@ -164,6 +348,7 @@ static char const* tr_variant_string_get_string(struct tr_variant_string const*
         break;
 
     case TR_STRING_TYPE_QUARK:
+    case TR_STRING_TYPE_VIEW:
         ret = str->str.str;
         break;
 
@@ -214,6 +399,25 @@ static void tr_variant_string_set_string(struct tr_variant_string* str, char con
     }
 }
 
+static void tr_variant_string_set_view(struct tr_variant_string* str, char const* bytes, size_t len)
+{
+    tr_variant_string_clear(str);
+
+    if (bytes == NULL)
+    {
+        bytes = "";
+        len = 0;
+    }
+    else if (len == TR_BAD_SIZE)
+    {
+        len = strlen(bytes);
+    }
+
+    str->type = TR_STRING_TYPE_VIEW;
+    str->str.str = bytes;
+    str->len = len;
+}
+
 /***
 ****
 ***/
@@ -225,17 +429,174 @@ static inline char const* getStr(tr_variant const* v)
     return tr_variant_string_get_string(&v->val.s);
 }
 
+/***
+****  Dicts with many children get an open-addressing hash table that maps
+****  keys to child positions. The children themselves aren't moved, so
+****  they are still walked and serialized in the order they were added.
+***/
+
+#define DICT_INDEX_MIN_COUNT 16
+
+struct tr_variant_dict_index
+{
+    size_t mask; /* slot count minus one; the slot count is a power of two */
+    bool has_duplicates; /* tr_variantDictAdd() doesn't check for existing keys */
+    uint32_t slots[]; /* child position + 1, or 0 if empty */
+};
+
+static inline size_t dictIndexHash(tr_quark const key, size_t mask)
+{
+    /* quarks are small sequential ints, so multiplying by an odd constant is enough */
+    return ((uint32_t)key * 2654435761U) & mask;
+}
+
+/* arena-backed dicts are left unindexed because nothing would free the index */
+static inline bool dictIsIndexable(tr_variant const* dict)
+{
+    return dict->val.l.alloc != 0;
+}
+
+static void dictIndexInsert(tr_variant* dict, size_t pos)
+{
+    struct tr_variant_dict_index* index = dict->val.l.index;
+    tr_quark const key = dict->val.l.vals[pos].key;
+
+    for (size_t i = dictIndexHash(key, index->mask);; i = (i + 1) & index->mask)
+    {
+        uint32_t const slot = index->slots[i];
+
+        if (slot == 0)
+        {
+            index->slots[i] = pos + 1;
+            break;
+        }
+
+        /* keep pointing at the first child with this key */
+        if (dict->val.l.vals[slot - 1].key == key)
+        {
+            index->has_duplicates = true;
+            break;
+        }
+    }
+}
+
+static void dictIndexRebuild(tr_variant* dict)
+{
+    size_t const count = dict->val.l.count;
+    size_t n = DICT_INDEX_MIN_COUNT * 2;
+
+    /* keep the load factor at or below one half */
+    while (n < count * 2)
+    {
+        n *= 2;
+    }
+
+    tr_free(dict->val.l.index);
+    dict->val.l.index = tr_malloc0(sizeof(struct tr_variant_dict_index) + sizeof(uint32_t) * n);
+    dict->val.l.index->mask = n - 1;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        dictIndexInsert(dict, i);
+    }
+}
+
+static void dictIndexDestroy(tr_variant* dict)
+{
+    tr_free(dict->val.l.index);
+    dict->val.l.index = NULL;
+}
+
+/* returns the slot that refers to the child at `pos' */
+static size_t dictIndexSlotOf(tr_variant const* dict, size_t pos)
+{
+    struct tr_variant_dict_index const* index = dict->val.l.index;
+    size_t i = dictIndexHash(dict->val.l.vals[pos].key, index->mask);
+
+    while (index->slots[i] != pos + 1)
+    {
+        TR_ASSERT(index->slots[i] != 0);
+
+        i = (i + 1) & index->mask;
+    }
+
+    return i;
+}
+
+/* empty a slot, shifting back any later entries in its probe run that would
+   otherwise become unreachable. This avoids the need for tombstones. */
+static void dictIndexErase(tr_variant* dict, size_t i)
+{
+    struct tr_variant_dict_index* index = dict->val.l.index;
+    size_t const mask = index->mask;
+
+    for (;;)
+    {
+        size_t j = i;
+
+        index->slots[i] = 0;
+
+        for (;;)
+        {
+            j = (j + 1) & mask;
+
+            if (index->slots[j] == 0)
+            {
+                return;
+            }
+
+            size_t const home = dictIndexHash(dict->val.l.vals[index->slots[j] - 1].key, mask);
+
+            /* can the entry at j stay where it is? */
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+}
+
 static int dictIndexOf(tr_variant const* dict, tr_quark const key)
 {
-    if (tr_variantIsDict(dict))
+    if (!tr_variantIsDict(dict))
+    {
+        return -1;
+    }
+
+    if (dict->val.l.index == NULL && dict->val.l.count >= DICT_INDEX_MIN_COUNT && dictIsIndexable(dict))
+    {
+        /* the index is a cache, so building it doesn't change the dict's value */
+        dictIndexRebuild((tr_variant*)dict);
+    }
+
+    if (dict->val.l.index != NULL)
     {
-        for (size_t i = 0; i < dict->val.l.count; ++i)
+        struct tr_variant_dict_index const* index = dict->val.l.index;
+
+        for (size_t i = dictIndexHash(key, index->mask); index->slots[i] != 0; i = (i + 1) & index->mask)
         {
-            if (dict->val.l.vals[i].key == key)
+            uint32_t const pos = index->slots[i] - 1;
+
+            if (dict->val.l.vals[pos].key == key)
             {
-                return (int)i;
+                return (int)pos;
             }
         }
+
+        return -1;
+    }
+
+    for (size_t i = 0; i < dict->val.l.count; ++i)
+    {
+        if (dict->val.l.vals[i].key == key)
+        {
+            return (int)i;
+        }
     }
 
     return -1;
@@ -393,16 +754,12 @@ bool tr_variantGetReal(tr_variant const* v, double* setme)
 
     if (!success && tr_variantIsString(v))
     {
-        char* endptr;
-        struct locale_context locale_ctx;
+        char const* end;
+        char const* str = getStr(v);
+        size_t const len = v->val.s.len;
         double d;
 
-        /* the json spec requires a '.' decimal point regardless of locale */
-        use_numeric_locale(&locale_ctx, "C");
-        d = strtod(getStr(v), &endptr);
-        restore_locale(&locale_ctx);
-
-        if (getStr(v) != endptr && *endptr == '\0')
+        if (tr_variantParseReal(str, len, &d, &end) && end == str + len)
         {
             *setme = d;
             success = true;
@@ -474,6 +831,12 @@ void tr_variantInitStr(tr_variant* v, void const* str, size_t len)
     tr_variant_string_set_string(&v->val.s, str, len);
 }
 
+void tr_variantInitStrView(tr_variant* v, void const* str, size_t len)
+{
+    tr_variantInit(v, TR_VARIANT_TYPE_STR);
+    tr_variant_string_set_view(&v->val.s, str, len);
+}
+
 void tr_variantInitBool(tr_variant* v, bool value)
 {
     tr_variantInit(v, TR_VARIANT_TYPE_BOOL);
@@ -514,7 +877,18 @@ static void containerReserve(tr_variant* v, size_t count)
             n *= 2U;
         }
 
-        v->val.l.vals = tr_renew(tr_variant, v->val.l.vals, n);
+        if (v->val.l.alloc == 0 && v->val.l.vals != NULL)
+        {
+            /* the children live in an arena, so move them to the heap */
+            tr_variant* vals = tr_new(tr_variant, n);
+            memcpy(vals, v->val.l.vals, sizeof(tr_variant) * v->val.l.count);
+            v->val.l.vals = vals;
+        }
+        else
+        {
+            v->val.l.vals = tr_renew(tr_variant, v->val.l.vals, n);
+        }
+
         v->val.l.alloc = n;
     }
 }
@@ -618,6 +992,18 @@ tr_variant* tr_variantDictAdd(tr_variant* dict, tr_quark const key)
     tr_variantInit(val, TR_VARIANT_TYPE_INT);
     val->key = key;
 
+    if (dict->val.l.index != NULL)
+    {
+        if (dict->val.l.count * 2 > dict->val.l.index->mask + 1)
+        {
+            dictIndexRebuild(dict);
+        }
+        else
+        {
+            dictIndexInsert(dict, dict->val.l.count - 1);
+        }
+    }
+
     return val;
 }
 
@@ -722,6 +1108,21 @@ bool tr_variantDictRemove(tr_variant* dict, tr_quark const key)
     {
         int const last = dict->val.l.count - 1;
 
+        if (dict->val.l.index != NULL && dict->val.l.index->has_duplicates)
+        {
+            /* another child may have this key too; let dictIndexOf() reindex */
+            dictIndexDestroy(dict);
+        }
+        else if (dict->val.l.index != NULL)
+        {
+            dictIndexErase(dict, dictIndexSlotOf(dict, i));
+
+            if (i != last)
+            {
+                dict->val.l.index->slots[dictIndexSlotOf(dict, last)] = i + 1;
+            }
+        }
+
         tr_variantFree(&dict->val.l.vals[i]);
 
         if (i != last)
@@ -743,16 +1144,39 @@ bool tr_variantDictRemove(tr_variant* dict, tr_quark const key)
 
 struct KeyIndex
 {
-    char const* keystr;
     tr_variant* val;
 };
 
+/* the predefined quarks are numbered in strcmp() order, so they can be compared without looking at their strings */
+static inline int compareKeys(tr_quark a, tr_quark b)
+{
+    if (a < TR_N_KEYS && b < TR_N_KEYS)
+    {
+        return a < b ? -1 : (a > b ? 1 : 0);
+    }
+
+    return strcmp(tr_quark_get_string(a, NULL), tr_quark_get_string(b, NULL));
+}
+
 static int compareKeyIndex(void const* va, void const* vb)
 {
     struct KeyIndex const* a = va;
     struct KeyIndex const* b = vb;
 
-    return strcmp(a->keystr, b->keystr);
+    return compareKeys(a->val->key, b->val->key);
+}
+
+static bool dictIsSorted(tr_variant const* dict)
+{
+    for (size_t i = 1; i < dict->val.l.count; ++i)
+    {
+        if (compareKeys(dict->val.l.vals[i - 1].key, dict->val.l.vals[i].key) > 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 struct SaveNode
@@ -768,7 +1192,7 @@ static void nodeConstruct(struct SaveNode* node, tr_variant const* v, bool sort_
     node->isVisited = false;
     node->childIndex = 0;
 
-    if (sort_dicts && tr_variantIsDict(v))
+    if (sort_dicts && tr_variantIsDict(v) && !dictIsSorted(v))
     {
         /* make node->sorted a sorted version of this dictionary */
 
@@ -778,7 +1202,6 @@ static void nodeConstruct(struct SaveNode* node, tr_variant const* v, bool sort_
         for (size_t i = 0; i < n; i++)
         {
             tmp[i].val = v->val.l.vals + i;
-            tmp[i].keystr = tr_quark_get_string(tmp[i].val->key, NULL);
         }
 
         qsort(tmp, n, sizeof(struct KeyIndex), compareKeyIndex);
@@ -941,7 +1364,13 @@ static void freeStringFunc(tr_variant const* v, void* unused UNUSED)
 
 static void freeContainerEndFunc(tr_variant const* v, void* unused UNUSED)
 {
-    tr_free(v->val.l.vals);
+    /* a zero alloc with children means they're owned by an arena */
+    if (v->val.l.alloc != 0)
+    {
+        tr_free(v->val.l.vals);
+    }
+
+    tr_free(v->val.l.index);
 }
 
 static struct VariantWalkFuncs const freeWalkFuncs =
@@ -967,6 +1396,88 @@ void tr_variantFree(tr_variant* v)
 ****
 ***/
 
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct tr_variant_arena_block
+{
+    struct tr_variant_arena_block* next;
+    size_t used;
+    size_t size;
+    /* the block's memory follows the header */
+};
+
+struct tr_variant_arena
+{
+    struct tr_variant_arena_block* blocks;
+};
+
+/* round up so that every allocation is suitably aligned for a tr_variant */
+static size_t arenaAlign(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+tr_variant_arena* tr_variantArenaNew(void)
+{
+    return tr_new0(tr_variant_arena, 1);
+}
+
+void tr_variantArenaFree(tr_variant_arena* arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+
+    while (arena->blocks != NULL)
+    {
+        struct tr_variant_arena_block* next = arena->blocks->next;
+        tr_free(arena->blocks);
+        arena->blocks = next;
+    }
+
+    tr_free(arena);
+}
+
+void* tr_variantArenaAlloc(tr_variant_arena* arena, size_t size)
+{
+    size_t const header_size = arenaAlign(sizeof(struct tr_variant_arena_block));
+    struct tr_variant_arena_block* block = arena->blocks;
+
+    size = arenaAlign(size);
+
+    if (block == NULL || block->size - block->used < size)
+    {
+        size_t const block_size = MAX(size, ARENA_BLOCK_SIZE);
+
+        block = tr_malloc(header_size + block_size);
+        block->used = 0;
+        block->size = block_size;
+
+        /* an oversized block is full as soon as it's made, so keep
+           filling the current one and tuck this one in behind it */
+        if (size > ARENA_BLOCK_SIZE && arena->blocks != NULL)
+        {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        else
+        {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    void* ret = (uint8_t*)block + header_size + block->used;
+    block->used += size;
+    return ret;
+}
+
+/***
+****
+***/
+
 static void tr_variantListCopy(tr_variant* target, tr_variant const* src)
 {
     int i = 0;
@@ -1050,10 +1561,13 @@ void tr_variantMergeDicts(tr_variant* target, tr_variant const* source)
     {
         tr_quark key;
         tr_variant* val;
-        tr_variant* t;
 
         if (tr_variantDictChild((tr_variant*)source, i, &key, &val))
         {
+            /* one indexed lookup per key for the containers; the scalar
+               setters below do their own through dictFindOrAdd() */
+            tr_variant* t = tr_variantIsList(val) || tr_variantIsDict(val) ? tr_variantDictFind(target, key) : NULL;
+
             if (tr_variantIsBool(val))
             {
                 bool boolVal;
@@ -1079,29 +1593,23 @@ void tr_variantMergeDicts(tr_variant* target, tr_variant const* source)
                 tr_variantGetStr(val, &str, &len);
                 tr_variantDictAddRaw(target, key, str, len);
             }
-            else if (tr_variantIsDict(val) && tr_variantDictFindDict(target, key, &t))
-            {
-                tr_variantMergeDicts(t, val);
-            }
             else if (tr_variantIsList(val))
             {
-                if (tr_variantDictFind(target, key) == NULL)
+                if (t == NULL)
                 {
                     tr_variantListCopy(tr_variantDictAddList(target, key, tr_variantListSize(val)), val);
                 }
             }
             else if (tr_variantIsDict(val))
             {
-                tr_variant* target_dict = tr_variantDictFind(target, key);
-
-                if (target_dict == NULL)
+                if (t == NULL)
                 {
-                    target_dict = tr_variantDictAddDict(target, key, tr_variantDictSize(val));
+                    t = tr_variantDictAddDict(target, key, tr_variantDictSize(val));
                 }
 
-                if (tr_variantIsDict(target_dict))
+                if (tr_variantIsDict(t))
                 {
-                    tr_variantMergeDicts(target_dict, val);
+                    tr_variantMergeDicts(t, val);
                 }
             }
             else
@@ -1118,12 +1626,8 @@ void tr_variantMergeDicts(tr_variant* target, tr_variant const* source)
 
 struct evbuffer* tr_variantToBuf(tr_variant const* v, tr_variant_fmt fmt)
 {
-    struct locale_context locale_ctx;
     struct evbuffer* buf = evbuffer_new();
 
-    /* parse with LC_NUMERIC="C" to ensure a "." decimal separator */
-    use_numeric_locale(&locale_ctx, "C");
-
     evbuffer_expand(buf, 4096); /* alloc a little memory to start off with */
 
     switch (fmt)
@@ -1141,8 +1645,6 @@ struct evbuffer* tr_variantToBuf(tr_variant const* v, tr_variant_fmt fmt)
         break;
     }
 
-    /* restore the previous locale */
-    restore_locale(&locale_ctx);
     return buf;
 }
 
@@ -1268,10 +1770,6 @@ int tr_variantFromBuf(tr_variant* setme, tr_variant_fmt fmt, void const* buf, si
     char const** setme_end)
 {
     int err;
-    struct locale_context locale_ctx;
-
-    /* parse with LC_NUMERIC="C" to ensure a "." decimal separator */
-    use_numeric_locale(&locale_ctx, "C");
 
     switch (fmt)
     {
@@ -1285,7 +1783,5 @@ int tr_variantFromBuf(tr_variant* setme, tr_variant_fmt fmt, void const* buf, si
         break;
     }
 
-    /* restore the previous locale */
-    restore_locale(&locale_ctx);
     return err;
 }
@@ -20,6 +20,8 @@ struct evbuffer;
 
 struct tr_error;
 
+struct tr_variant_dict_index;
+
 /**
  * @addtogroup tr_variant Variant
  *
@@ -36,7 +38,8 @@ typedef enum
 {
     TR_STRING_TYPE_QUARK,
     TR_STRING_TYPE_HEAP,
-    TR_STRING_TYPE_BUF
+    TR_STRING_TYPE_BUF,
+    TR_STRING_TYPE_VIEW /* borrowed; not owned or freed by the variant */
 }
 tr_string_type;
 
@@ -93,6 +96,7 @@ typedef struct tr_variant
             size_t alloc;
             size_t count;
             struct tr_variant* vals;
+            struct tr_variant_dict_index* index; /* dicts only; see dictIndexOf() */
         } l;
     }
     val;
@@ -148,6 +152,61 @@ static inline int tr_variantFromJson(tr_variant* setme, void const* buf, size_t
     return tr_variantFromBuf(setme, TR_VARIANT_FMT_JSON, buf, buflen, NULL, NULL);
 }
 
+/***
+****  Arena parsing
+***/
+
+/**
+ * An arena holds the containers and long strings of variants parsed by
+ * tr_variantFromBencArena() so that they can all be released in one call.
+ * tr_variantFree() leaves arena storage alone and containers that grow
+ * after parsing are moved to the heap, but the arena must outlive every
+ * variant that was parsed into it.
+ */
+typedef struct tr_variant_arena tr_variant_arena;
+
+tr_variant_arena* tr_variantArenaNew(void);
+
+void tr_variantArenaFree(tr_variant_arena* arena);
+
+/**
+ * @brief parse bencoded data into an arena.
+ *
+ * If `inplace' is true, strings too long to be stored inside their node
+ * point into `buf' instead of being copied. `buf' must then outlive the
+ * variant, and those strings are NOT zero-terminated: use their lengths.
+ */
+int tr_variantFromBencArena(tr_variant* setme, tr_variant_arena* arena, void const* buf, size_t buflen, bool inplace,
+    char const** setme_end);
+
+/***
+****  Streaming
+***/
+
+/**
+ * Callbacks for tr_variantWalkBenc(). `key' is the dict key the value
+ * was found under, or NULL for list items and the top-level value.
+ * Keys and strings point into the parsed buffer and are not zero-terminated.
+ * Returning nonzero stops the walk. Any of these may be NULL.
+ */
+typedef struct tr_variant_benc_funcs
+{
+    int (* intFunc)(char const* key, size_t key_len, int64_t val, void* user_data);
+    int (* stringFunc)(char const* key, size_t key_len, char const* str, size_t str_len, void* user_data);
+    int (* dictBeginFunc)(char const* key, size_t key_len, void* user_data);
+    int (* listBeginFunc)(char const* key, size_t key_len, void* user_data);
+    int (* containerEndFunc)(void* user_data);
+}
+tr_variant_benc_funcs;
+
+/**
+ * @brief walk bencoded data without building a tr_variant from it.
+ * @return 0 on success, EILSEQ on malformed input, or the
+ *         nonzero value returned by a callback that stopped the walk
+ */
+int tr_variantWalkBenc(void const* buf, size_t buflen, tr_variant_benc_funcs const* funcs, void* user_data,
+    char const** setme_end);
+
 static inline bool tr_variantIsType(tr_variant const* b, int type)
 {
     return b != NULL && b->type == type;
@@ -168,6 +227,9 @@ void tr_variantInitStr(tr_variant* initme, void const* str, size_t str_len);
 void tr_variantInitQuark(tr_variant* initme, tr_quark const quark);
 void tr_variantInitRaw(tr_variant* initme, void const* raw, size_t raw_len);
 
+/* like tr_variantInitStr(), but `str' is referenced rather than copied and must outlive the variant */
+void tr_variantInitStrView(tr_variant* initme, void const* str, size_t str_len);
+
 bool tr_variantGetRaw(tr_variant const* variant, uint8_t const** raw_setme, size_t* len_setme);
 
 /***
@@ -108,7 +108,7 @@ static bool verifyTorrent(tr_torrent* tor, bool* stopFlag)
             uint8_t hash[SHA_DIGEST_LENGTH];
 
             tr_sha1_final(sha, hash);
-            hasPiece = memcmp(hash, tor->info.pieces[pieceIndex].hash, SHA_DIGEST_LENGTH) == 0;
+            hasPiece = memcmp(hash, tor->info.pieceHashes[pieceIndex], SHA_DIGEST_LENGTH) == 0;
 
             if (hasPiece || hadPiece)
             {
@@ -442,7 +442,7 @@ void OptionsDialog::onTimeout()
     if (leftInPiece == 0)
     {
         QByteArray const result(myVerifyHash.result());
-        bool const matches = memcmp(result.constData(), myInfo.pieces[myVerifyPieceIndex].hash, SHA_DIGEST_LENGTH) == 0;
+        bool const matches = memcmp(result.constData(), myInfo.pieceHashes[myVerifyPieceIndex], SHA_DIGEST_LENGTH) == 0;
         myVerifyFlags[myVerifyPieceIndex] = matches;
         myVerifyPiecePos = 0;
         ++myVerifyPieceIndex;
@@ -49,7 +49,8 @@ RpcClient::RpcClient(QObject* parent) :
     QObject(parent),
     mySession(nullptr),
     myNAM(nullptr),
-    myNextTag(0)
+    myNextTag(0),
+    myServerSpeaksBenc(false)
 {
     qRegisterMetaType<TrVariantPtr>("TrVariantPtr");
 }
@@ -59,6 +60,7 @@ void RpcClient::stop()
     mySession = nullptr;
     mySessionId.clear();
     myUrl.clear();
+    myServerSpeaksBenc = false;
 
     if (myNAM != nullptr)
     {
@@ -75,6 +77,7 @@ void RpcClient::start(tr_session* session)
 void RpcClient::start(QUrl const& url)
 {
     myUrl = url;
+    myServerSpeaksBenc = false;
 }
 
 bool RpcClient::isLocal() const
@@ -127,7 +130,13 @@ void RpcClient::sendNetworkRequest(TrVariantPtr json, QFutureInterface<RpcRespon
     request.setUrl(myUrl);
     request.setRawHeader("User-Agent", (qApp->applicationName() + QLatin1Char('/') +
         QString::fromUtf8(LONG_VERSION_STRING)).toUtf8());
-    request.setRawHeader("Content-Type", "application/json; charset=UTF-8");
+
+    // ask for bencoded responses, which are much cheaper for the server
+    // to build than JSON; older servers ignore this and send JSON anyway.
+    // once we know the server speaks benc, send our requests that way too.
+    request.setRawHeader("Accept", TR_RPC_BENC_CONTENT_TYPE ", application/json");
+    request.setRawHeader("Content-Type", myServerSpeaksBenc ? TR_RPC_BENC_CONTENT_TYPE :
+        "application/json; charset=UTF-8");
 
     if (!mySessionId.isEmpty())
     {
@@ -135,7 +144,8 @@ void RpcClient::sendNetworkRequest(TrVariantPtr json, QFutureInterface<RpcRespon
     }
 
     size_t rawJsonDataLength;
-    char* rawJsonData = tr_variantToStr(json.get(), TR_VARIANT_FMT_JSON_LEAN, &rawJsonDataLength);
+    char* rawJsonData = tr_variantToStr(json.get(), myServerSpeaksBenc ? TR_VARIANT_FMT_BENC : TR_VARIANT_FMT_JSON_LEAN,
+        &rawJsonDataLength);
     QByteArray jsonData(rawJsonData, rawJsonDataLength);
     tr_free(rawJsonData);
 
@@ -260,10 +270,17 @@ void RpcClient::networkRequestFinished(QNetworkReply* reply)
     {
         RpcResponse result;
 
-        QByteArray const jsonData = reply->readAll().trimmed();
+        bool const isBenc = reply->rawHeader("Content-Type").startsWith(TR_RPC_BENC_CONTENT_TYPE);
+        QByteArray const jsonData = isBenc ? reply->readAll() : reply->readAll().trimmed();
         TrVariantPtr json = createVariant();
 
-        if (tr_variantFromJson(json.get(), jsonData.constData(), jsonData.size()) == 0)
+        if (isBenc)
+        {
+            myServerSpeaksBenc = true;
+        }
+
+        if ((isBenc ? tr_variantFromBenc(json.get(), jsonData.constData(), jsonData.size()) :
+            tr_variantFromJson(json.get(), jsonData.constData(), jsonData.size())) == 0)
         {
             result = parseResponseData(*json);
         }
@@ -97,4 +97,5 @@ private:
     QNetworkAccessManager* myNAM;
     QHash<int64_t, QFutureInterface<RpcResponse>> myLocalRequests;
     int64_t myNextTag;
+    bool myServerSpeaksBenc;
 };